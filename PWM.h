@@ -39,24 +39,282 @@
 #endif
 #endif
 
+// Host build : emulated registers and timers (see PWM_host.h)
+#if defined(PWM_HOST)
+#include <PWM_host.h>
+#endif
+
+// body of a busy-wait on a timer register : nothing on the chip, the host emulator is clocked
+#if defined(PWM_HOST)
+#define PWM_SPIN() pwm_host::step(1)
+#else
+#define PWM_SPIN()
+#endif
+
 static void pwm_empty_interrupt() {}
 
+// startSync() : CPU cycles between the start of a timer TSM does not hold (ATmega32u4 Timer4, ATtinyX5
+// Timer1) and the release of the others, one out after its clock select store
+#ifndef PWM_SYNC_LEAD_CYCLES
+#define PWM_SYNC_LEAD_CYCLES 1
+#endif
+
+// Interrupt vectors
+// The back-ends bind every vector of their timers to a callback (pwm_interruptNx : attachInterrupt, subscribe,
+// the ditherer, commit(), PWM_Soft ...). The indirect call makes avr-gcc save all the call-clobbered
+// registers : 85 cycles even for pwm_empty_interrupt, by instruction count (response and jmp 7, prologue
+// 32, callback load and icall 7, ret 4, epilogue 31, reti 4). Define PWM_ISR_STATIC to emit none of them
+// and bind the vectors in use at compile time :
+//   PWM_ISR(TIMER1_COMPA_vect, onMatch)               // onMatch() inlined into the vector (flatten)
+//   PWM_ISR(TIMER2_COMPA_vect, pwm_soft_period)       // a library handler, without the callback
+//   PWM_ISR_NAKED(TIMER1_COMPB_vect, PINB |= _BV(5))  // no prologue : sbi/cbi only, no register nor SREG
+//   PWM_ISR_CALLBACK(TIMER1_OVF_vect, pwm_interrupt1) // the callback, attachInterrupt works on this one
+// The PWM_DITHER_FAST overflow ISRs are bound statically already and still emitted.
+#define PWM_ISR(vector, handler) ISR(vector, __attribute__((flatten))) { handler(); }
+#define PWM_ISR_NAKED(vector, body) ISR(vector, ISR_NAKED) { body; reti(); }
+#define PWM_ISR_CALLBACK(vector, callback) ISR(vector) { callback(); }
+// PWM_ISR with a profiler slot (see PWM_Profile.h), Counter and Event : the timer count of the interrupt,
+// then optionally Top : TOP of a single slope timer, the latency is taken modulo its period
+#if defined(PWM_PROFILE)
+#define PWM_ISR_PROFILED(vector, handler, Slot, Counter, ...) \
+	ISR(vector, __attribute__((flatten))) { const PWM_ProfileScope pwm_profile_scope(Slot, Counter, __VA_ARGS__); handler(); }
+#else
+#define PWM_ISR_PROFILED(vector, handler, Slot, Counter, ...) PWM_ISR(vector, handler)
+#endif
+
+// 16b register store with the interrupts held off : the high byte goes through the TEMP
+// register shared by the 16b timers, an ISR that writes ICRx/OCRx in between would corrupt it
+// in r, cli, sts, sts, out : 7 cycles (instruction count)
+__attribute__((always_inline)) inline void pwm_write16(volatile uint16_t &Register, const uint16_t Value)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	Register = Value;
+	SREG = sreg;
+}
+
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+// Timer4 10b register store and load : bits 9:8 go through TC4H, shared by TCNT4 and OCR4A..D, written
+// before the low byte and read after it. The interrupts are held off, an ISR could change TC4H in between
+// in r, cli, sts, sts, out : 7 cycles (instruction count)
+template <typename Register>
+__attribute__((always_inline)) inline void pwm_write10(Register &Low, const uint16_t Value)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	TC4H = Value >> 8;
+	Low = Value;
+	SREG = sreg;
+}
+template <typename Register>
+__attribute__((always_inline)) inline uint16_t pwm_read10(Register &Low)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint8_t Value = Low;
+	const uint16_t Result = ((uint16_t)TC4H << 8) | Value;
+	SREG = sreg;
+	return Result;
+}
+// a Timer4 10b register for the templates written for 16b ones (PWM_Commit.h, PWM_Dither.h) : only
+// used with the interrupts off, in the ISRs and pwm_commit_now
+template <typename Register>
+struct PWM_Register10
+{
+	Register &Low;
+	operator uint16_t() const volatile
+	{
+		const uint8_t Value = Low;
+		return ((uint16_t)TC4H << 8) | Value;
+	}
+	void operator=(const uint16_t Value) volatile
+	{
+		TC4H = Value >> 8;
+		Low = Value;
+	}
+};
+template <typename Register>
+inline PWM_Register10<Register> pwm_register10(Register &Low) { return PWM_Register10<Register>{ Low }; }
+#endif
+
+// pwm_output_pin of an output that does not exist
+#define PWM_NO_PIN 0xFF
+
+// Waveform mode of set()
+enum PWM_Mode : uint8_t
+{
+	PWM_FAST = 0,                   // single slope, TOP = TimerClock / (PS * FrequencyHz) - 1
+	PWM_PHASE_CORRECT = 1,          // dual slope (center aligned), TOP = TimerClock / (2 * PS * FrequencyHz)
+	PWM_PHASE_FREQUENCY_CORRECT = 2 // dual slope, TOP and compare registers updated at BOTTOM
+};
+
+// Clock source of a timer (PWM::setClock), the timer counts it through its prescalar
+enum PWM_Clock : uint8_t
+{
+	PWM_CLOCK_CPU = 0,      // F_CPU, every timer
+	PWM_CLOCK_PLL = 1,      // 64MHz : ATtinyX5 Timer1 (PCK), ATmega32u4 Timer4 (96MHz PLL / 1.5)
+	PWM_CLOCK_PLL_LOW = 2,  // ATtinyX5 Timer1 : 32MHz (PLL low speed mode), ATmega32u4 Timer4 : 48MHz (48MHz PLL / 1)
+	PWM_CLOCK_PLL_HIGH = 3  // ATmega32u4 Timer4 : 96MHz (96MHz PLL / 1), above the 64MHz of the datasheet
+};
+
+// Duty cycle of set() and setDuty()
+//   pwm_q16(Fraction)              : Q0.16 fraction of the period, e.g. pwm_q16(0x6000) = 37.5%
+//   pwm_ticks(Ticks)               : pulse width in timer ticks, the compare register value
+//   pwm_divisor(DutyCycle_Divisor) : PeriodRegister / DutyCycle_Divisor (the plain uint16_t of set())
+enum { PWM_DUTY_DIVISOR = 0, PWM_DUTY_Q16 = 1, PWM_DUTY_TICKS = 2 };
+struct PWM_Duty
+{
+	uint16_t Value;
+	uint8_t Kind;
+};
+constexpr PWM_Duty pwm_divisor(const uint16_t DutyCycle_Divisor) { return PWM_Duty{ DutyCycle_Divisor, PWM_DUTY_DIVISOR }; }
+constexpr PWM_Duty pwm_q16(const uint16_t Fraction) { return PWM_Duty{ Fraction, PWM_DUTY_Q16 }; }
+constexpr PWM_Duty pwm_ticks(const uint16_t Ticks) { return PWM_Duty{ Ticks, PWM_DUTY_TICKS }; }
+
+// PeriodRegister and slope of each timer, set by set() : the scale of the duty cycles
+uint16_t pwm_period_register[5] = { 0,0,0,0,0 };
+uint8_t pwm_dual_slope = 0; // bit Timer : dual slope (phase correct) mode
+
+inline void pwm_set_period(const uint8_t Timer, const uint16_t PeriodRegister, const bool DualSlope)
+{
+	pwm_period_register[Timer] = PeriodRegister;
+	pwm_dual_slope = (pwm_dual_slope & ~_BV(Timer)) | (DualSlope << Timer);
+}
+
+// compare register value for a duty cycle of a period
+// Q0.16 : single slope, high for OCR + 1 of TOP + 1 counts : OCR = Fraction * (TOP + 1) / 65536 - 1
+//         dual slope, high for 2 * OCR of 2 * TOP counts   : OCR = Fraction * TOP / 65536
+// one 16x16 multiply, the high word is the result (no division)
+// constexpr : also evaluated by the compiler for PWM_Config::compute
+constexpr uint16_t pwm_q16_width(const uint16_t Width, const bool SingleSlope)
+{
+	return Width ? Width - SingleSlope : 0;
+}
+__attribute__((always_inline)) constexpr uint16_t pwm_scale_duty(const uint16_t PeriodRegister, const bool SingleSlope, const PWM_Duty Duty)
+{
+	return (Duty.Kind == PWM_DUTY_Q16) ? pwm_q16_width(((uint32_t)Duty.Value * (uint16_t)(PeriodRegister + SingleSlope)) >> 16, SingleSlope) :
+		((Duty.Kind == PWM_DUTY_TICKS) ? Duty.Value : PeriodRegister / Duty.Value);
+}
+
+// compare register value for a duty cycle of Timer, scaled to the PeriodRegister of the last set()
+__attribute__((always_inline)) inline uint16_t pwm_pulse_width(const uint8_t Timer, const PWM_Duty Duty)
+{
+	return pwm_scale_duty(pwm_period_register[Timer], !(pwm_dual_slope & _BV(Timer)), Duty);
+}
+
+// Result of the frequency solver (returned by PWM::set and PWM::solve)
+struct PWM_Result
+{
+	uint8_t CSx3210;               // clock select bits
+	uint16_t Prescalar;
+	uint16_t PeriodRegister;       // TOP
+	uint32_t FrequencyNumerator;   // achieved frequency = FrequencyNumerator / FrequencyDenominator Hz
+	uint32_t FrequencyDenominator; // = Prescalar * (PeriodRegister + 1), 2 * Prescalar * PeriodRegister for dual slope
+	int32_t Error_ppm;             // (achieved - requested) / requested, in parts per million
+	uint8_t DutyBits;              // duty cycle resolution, floor(log2(PeriodRegister + 1))
+	uint16_t PeriodFraction;       // dither : average TOP = PeriodRegister + PeriodFraction / 65536
+	                               // (the frequency ratio is then rounded to 1/2^(31 - log2(F_CPU)) count)
+};
+
+// Register image of a timer : what set() leaves in its registers, the prescalar included. Computed without
+// touching the timer (PWM_Config::compute, on the host or by the compiler), written by PWM::apply. Control
+// holds the mode registers of the back-end (pwm_config_mode_bits) :
+//   ATmega328p, ATmega32u4 Timer0/1/3, ATtinyX5 Timer0 : TCCRxA, TCCRxB
+//   ATtinyX5 Timer1                                   : TCCR1, GTCCR
+//   ATmega32u4 Timer4                                 : TCCR4A, TCCR4B, TCCR4C, TCCR4D
+// e.g. constexpr PWM_Config Drive = PWM_Config::compute(1, 'a', 20000, pwm_q16(0x4000)).output('b', pwm_q16(0xC000));
+struct PWM_Config
+{
+	uint8_t Timer;
+	uint8_t CSx3210;     // clock select bits (also in Control)
+	bool DualSlope;
+	uint8_t Outputs;     // bit n : output 'a' + n connected (and made an OUTPUT by apply)
+	uint16_t Top;        // PeriodRegister
+	uint16_t Compare[4]; // OCRxA .. OCRxD
+	uint8_t Control[4];
+
+	// the image of set(Timer, ABCD_out, FrequencyHz, Duty, invertOut, false, Mode), TimerClock : the clock of setClock
+	static constexpr PWM_Config compute(const uint8_t Timer, const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const bool invertOut = false, const PWM_Mode Mode = PWM_FAST, const uint32_t TimerClock = F_CPU);
+	// a copy with one more output of the timer, Duty scaled to Top
+	constexpr PWM_Config output(const char ABCD_out, const PWM_Duty Duty, const bool invertOut = false) const;
+	constexpr bool operator==(const PWM_Config &Other) const;
+	constexpr bool operator!=(const PWM_Config &Other) const { return !(*this == Other); }
+};
+
 class PWM {
 protected:
 	uint32_t base_clock;
+	uint32_t timer_clock[5] = { F_CPU,F_CPU,F_CPU,F_CPU,F_CPU }; // input of each prescalar (see setClock)
 	uint8_t PS_IDX[5] = { 0,0,0,0,0 };
 	uint16_t PS[5] = { 0,0,0,0,0 };
 
+	// write the period, compare and mode registers of a timer output
+	inline void set_output(const uint8_t Timer, const char ABCD_out, const uint16_t PeriodRegister, const uint16_t PulseWidthRegister, const bool invertOut, const PWM_Mode Mode) __attribute__((always_inline));
+	// load the period ditherer of a timer, PeriodFraction = 0 turns it off (see PWM_Dither.h)
+	void set_dither(const uint8_t Timer, const uint16_t PeriodRegister, const uint16_t PeriodFraction);
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	// COM4x = 01 and the dead time, (DTPS4[10] << 8) | DT4 (see pwm_dead_time)
+	void set_complementary(const char ABCD_out, const uint16_t DeadTime);
+#endif
+
 public:
 	PWM() : base_clock(F_CPU){}
 	
-	void set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const uint16_t DutyCycle_Divisor = 2, const bool invertOut = false);
+	// dither = true : sub-count frequency resolution, the overflow ISR alternates TOP and TOP + 1 (see PWM_Dither.h)
+	// Mode : PWM_FAST, PWM_PHASE_CORRECT or PWM_PHASE_FREQUENCY_CORRECT (timers without it use the nearest mode they have)
+	PWM_Result set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const uint16_t DutyCycle_Divisor = 2, const bool invertOut = false, const bool dither = false, const PWM_Mode Mode = PWM_FAST)
+	{
+		return set(Timer, ABCD_out, FrequencyHz, pwm_divisor(DutyCycle_Divisor), invertOut, dither, Mode);
+	}
+	// Duty : pwm_q16(Fraction), pwm_ticks(Ticks) or pwm_divisor(DutyCycle_Divisor)
+	// e.g. pwm.set(1, 'a', 20000, pwm_q16(0x6000)); // 37.5% duty cycle
+	PWM_Result set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const PWM_Duty Duty, const bool invertOut = false, const bool dither = false, const PWM_Mode Mode = PWM_FAST);
+	// Compile time version of set() : the prescalar, TOP and compare values are resolved by the compiler
+	// e.g. pwm.set<1,'a',20000,4>();
+	// TimerClock : the clock given to setClock, e.g. pwm.set<4,'a',250000,2,false,PWM_FAST,64000000>();
+	template <uint8_t Timer, char ABCD_out, uint32_t FrequencyHz, uint16_t DutyCycle_Divisor = 2, bool invertOut = false, PWM_Mode Mode = PWM_FAST, uint32_t TimerClock = F_CPU>
+	PWM_Result set();
+	// Clock source of a timer, before set() : the PLL is started and locked if needed. Returns the clock in Hz the
+	// solver now uses for Timer, 0 if Timer cannot take Source (its clock is left as it was)
+	// e.g. pwm.setClock(4, PWM_CLOCK_PLL); // Timer4 at 64MHz : 250kHz with 8 bits of duty cycle
+	uint32_t setClock(const uint8_t Timer, const PWM_Clock Source);
+	uint32_t getClock(const uint8_t Timer) const { return timer_clock[Timer]; }
+	// clock select bits (CSx[3210]) of the last set() of Timer, see pwm_prescaler
+	uint8_t getClockSelect(const uint8_t Timer) const { return PS_IDX[Timer]; }
+	// Closest prescalar and PeriodRegister to FrequencyHz, without touching the timer
+	PWM_Result solve(const uint8_t Timer, const uint32_t FrequencyHz, const PWM_Mode Mode = PWM_FAST);
+	// Largest PeriodRegister for FrequencyHz, and the PeriodFraction the ditherer adds on average
+	PWM_Result solve_dither(const uint8_t Timer, const uint32_t FrequencyHz, const PWM_Mode Mode = PWM_FAST);
 	void start(const int8_t Timer = -1);
+	// Write a PWM_Config : each register of the image once (TOP, compare, then mode and clock select, which
+	// starts the timer), Atomic : with the interrupts held off. Outputs not in the image are disconnected,
+	// the ditherer is turned off, TCNTx and the interrupt enables are left as they are. The dead time of
+	// setComplementary is not part of the image
+	void apply(const PWM_Config &Config, const bool Atomic = true);
+	// Start every timer on the same clock edge : the prescalers are halted (GTCCR TSM) and reset while the
+	// counters are preloaded, then released together. Phase[Timer] (optional) is the TCNTx preload in timer
+	// ticks, the lead of that timer (a position on the up slope in the dual slope modes)
+	void startSync(const uint16_t *Phase = 0);
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	// Half bridge on Timer4 : OC4x and its complement !OC4x (x = a, b, d, see OCR4x_n_pin) with hardware dead
+	// time. OC4x goes high RisingNs after the compare match, !OC4x FallingNs after OC4x goes low. The DT4
+	// register is shared : the last call sets the dead time of every pair
+	PWM_Result setComplementary(const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const uint16_t RisingNs, const uint16_t FallingNs, const PWM_Mode Mode = PWM_FAST);
+	// the dead time converted to DT4 and DTPS4 by the compiler, TimerClock : the clock given to setClock
+	// e.g. pwm.setComplementary<250, 500>('a', 62500, pwm_q16(0x8000));
+	template <uint16_t RisingNs, uint16_t FallingNs, uint32_t TimerClock = F_CPU>
+	PWM_Result setComplementary(const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const PWM_Mode Mode = PWM_FAST);
+#endif
 	void stop(const int8_t Timer = -1);
 	void print();
 	
 	void attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)());
 	void detachInterrupt(const uint8_t &Timer, const char &ABCD_out);
+	// isr(Context) from the vector of ABCD_out ('o' : the overflow) with the other subscribers (see PWM_Subscribe.h)
+	// false : the table of the vector is full, or no such vector
+	bool subscribe(const uint8_t Timer, const char ABCD_out, void(*isr)(void *), void *Context);
+	// the last one disables the interrupt, false : not subscribed
+	bool unsubscribe(const uint8_t Timer, const char ABCD_out, void(*isr)(void *), void *Context);
 
 	void set_register(const int8_t Timer = -1, const char ABCD_out = 'o', uint16_t register_value = 0)
 	{
@@ -75,6 +333,7 @@ public:
 					OCR0A = register_value;
 					break;
 			}
+			break;
 		 case 1:
 			switch (ABCD_out)
 			{
@@ -100,6 +359,7 @@ public:
 					#endif
 					break;
 			}
+			break;
 		 #if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
 		 case 2:
 			switch (ABCD_out)
@@ -114,6 +374,7 @@ public:
 					OCR2A = register_value;
 					break;
 			}
+			break;
 		 #elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
 		 case 3:
 			switch (ABCD_out)
@@ -134,25 +395,27 @@ public:
 					ICR3 = register_value;
 					break;
 			}
+			break;
 		 case 4:
 			switch (ABCD_out)
 			{
 				case 'a':
 				case 'A':
-					OCR4A = register_value;
+					pwm_write10(OCR4A, register_value);
 					break;
 				case 'b':
 				case 'B':
-					OCR4B = register_value;
+					pwm_write10(OCR4B, register_value);
 					break;
 				case 'd':
 				case 'D':
-					OCR4D = register_value;
+					pwm_write10(OCR4D, register_value);
 					break;
 				default:
-					OCR4C = register_value;
+					pwm_write10(OCR4C, register_value);
 					break;
 			}
+			break;
 		 #endif
 	  }
 	}
@@ -228,15 +491,15 @@ public:
 			{
 				case 'a':
 				case 'A':
-					return OCR4A;
+					return pwm_read10(OCR4A);
 				case 'b':
 				case 'B':
-					return OCR4B;
+					return pwm_read10(OCR4B);
 				case 'd':
 				case 'D':
-					return OCR4D;
+					return pwm_read10(OCR4D);
 				default:
-					return OCR4C;
+					return pwm_read10(OCR4C);
 			}
 		 #endif
 		 default:
@@ -244,6 +507,124 @@ public:
 	  }
 	}
 
+	// Duty cycle only update : writes the compare register of an output set() has configured,
+	// no solver, pinMode or TCCRx access. With constant Timer and ABCD_out the switch is resolved
+	// by the compiler, leaving a single store (instruction counts) :
+	//   8b OCRx : ldi, sts (3 cycles)
+	//  16b OCRx : ldi, ldi, in, cli, sts, sts, out (9 cycles, see pwm_write16)
+	// The toggled outputs (OCR0A, OCR2A) have no duty cycle, their OCR is the period : no store.
+	__attribute__((always_inline)) static inline void setDuty(const uint8_t Timer, const char ABCD_out, const uint16_t PulseWidthRegister)
+	{
+		switch (Timer)
+		{
+		case 0:
+			switch (ABCD_out)
+			{
+			case 'b':
+			case 'B':
+				OCR0B = PulseWidthRegister;
+				break;
+			}
+			break;
+		case 1:
+			switch (ABCD_out)
+			{
+			#if defined(__AVR_ATtinyX5__)
+			case 'a':
+			case 'A':
+				OCR1A = PulseWidthRegister;
+				break;
+			case 'b':
+			case 'B':
+				OCR1B = PulseWidthRegister;
+				break;
+			#else
+			case 'a':
+			case 'A':
+				pwm_write16(OCR1A, PulseWidthRegister);
+				break;
+			case 'b':
+			case 'B':
+				pwm_write16(OCR1B, PulseWidthRegister);
+				break;
+			#endif
+			#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+			case 'c':
+			case 'C':
+				pwm_write16(OCR1C, PulseWidthRegister);
+				break;
+			#endif
+			}
+			break;
+		#if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+		case 2:
+			switch (ABCD_out)
+			{
+			case 'b':
+			case 'B':
+				OCR2B = PulseWidthRegister;
+				break;
+			}
+			break;
+		#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+		case 3:
+			switch (ABCD_out)
+			{
+			case 'a':
+			case 'A':
+				pwm_write16(OCR3A, PulseWidthRegister);
+				break;
+			case 'b':
+			case 'B':
+				pwm_write16(OCR3B, PulseWidthRegister);
+				break;
+			case 'c':
+			case 'C':
+				pwm_write16(OCR3C, PulseWidthRegister);
+				break;
+			}
+			break;
+		case 4:
+			switch (ABCD_out)
+			{
+			case 'a':
+			case 'A':
+				pwm_write10(OCR4A, PulseWidthRegister);
+				break;
+			case 'b':
+			case 'B':
+				pwm_write10(OCR4B, PulseWidthRegister);
+				break;
+			case 'd':
+			case 'D':
+				pwm_write10(OCR4D, PulseWidthRegister);
+				break;
+			}
+			break;
+		#endif
+		}
+	}
+
+	// Duty cycle only update from a Q0.16 fraction (or a divisor) : scaled to the PeriodRegister
+	// of the last set(), one multiply and the store above. By instruction count ~45 cycles on an ATmega
+	// (loads 8, the libgcc 16x16 multiply 24, clamp 5, store 9), ~170 on the ATtinyX5 (no MUL)
+	__attribute__((always_inline)) static inline void setDuty(const uint8_t Timer, const char ABCD_out, const PWM_Duty Duty)
+	{
+		setDuty(Timer, ABCD_out, pwm_pulse_width(Timer, Duty));
+	}
+
+	// Staged update : the period and duty cycles of a timer are applied together at the next overflow
+	// by commit(), without runt or missing pulses (see PWM_Commit.h)
+	void stagePeriod(const uint8_t Timer, const uint16_t PeriodRegister);
+	// PeriodRegister closest to FrequencyHz with the prescalar of the last set() (a prescalar change is not glitch free)
+	PWM_Result stageFrequency(const uint8_t Timer, const uint32_t FrequencyHz);
+	void stageDuty(const uint8_t Timer, const char ABCD_out, const uint16_t PulseWidthRegister);
+	// Q0.16 fractions are scaled to the staged period
+	void stageDuty(const uint8_t Timer, const char ABCD_out, const PWM_Duty Duty);
+	// false : the previous commit of this timer is not applied yet, nothing is done (the stage is kept)
+	bool commit(const uint8_t Timer);
+	bool committed(const uint8_t Timer);
+
 	void enableInterrupt(const int8_t Timer = -1, const char ABCD_out = 'o');
 	void disableInterrupt(const int8_t Timer = -1, const char ABCD_out = 'o');
 	
@@ -270,6 +651,27 @@ public:
 	}
 };
 
+// Output bound at compile time, the duty cycle update is a single register store (see PWM::setDuty)
+// e.g. PWM_Channel<1, 'a'> PhaseU; ... PhaseU = 512;
+template <uint8_t Timer, char ABCD_out>
+struct PWM_Channel
+{
+	__attribute__((always_inline)) inline void set(const uint16_t PulseWidthRegister) const { PWM::setDuty(Timer, ABCD_out, PulseWidthRegister); }
+	__attribute__((always_inline)) inline void set(const PWM_Duty Duty) const { PWM::setDuty(Timer, ABCD_out, Duty); }
+	__attribute__((always_inline)) inline PWM_Channel &operator=(const uint16_t PulseWidthRegister) { set(PulseWidthRegister); return *this; }
+	__attribute__((always_inline)) inline PWM_Channel &operator=(const PWM_Duty Duty) { set(Duty); return *this; }
+};
+
+#include <PWM_Dither.h>
+#include <PWM_Commit.h>
+#include <PWM_Subscribe.h>
+#if defined(PWM_PROFILE)
+#include <PWM_Profile.h>
+#endif
+#if defined(PWM_DECIMATE)
+#include <PWM_Decimate.h>
+#endif
+
 #if defined(__AVR_ATtinyX5__)
 #include <PWM_ATtinyX5.h>
 #elif defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__) 
@@ -278,6 +680,330 @@ public:
 #include <PWM_ATmega32u4.h>
 #endif
 
+// Frequency solver
+// The back-end describes its timers with :
+//   pwm_timer_max(Timer)               : largest TOP, 0 if the timer does not exist
+//   pwm_cs_max(Timer)                  : largest CSx[3210] that selects an internal prescalar
+//   pwm_prescaler_log2(Timer, CSx3210) : log2 of the prescalar selected by CSx[3210]
+//   pwm_mode(Timer, Mode)              : the waveform mode the timer uses for Mode
+// Every prescalar is scored on the period error of its nearest TOP, ties go to the smaller
+// prescalar (more duty cycle resolution). The same functions are used at compile time by
+// PWM::set<...>() and at run time by PWM::solve(), so both pick the same registers.
+// TimerClock / FrequencyHz is passed in as FrequencyCount + Remainder / FrequencyHz (the prescalar input, see PWM::setClock)
+// Dual slope (phase correct) : the timer counts up and down, period = 2 * PS * TOP.
+// The functions are then called with 2 * FrequencyHz and the count is TOP instead of TOP + 1.
+
+constexpr uint16_t pwm_prescaler(const uint8_t Timer, const uint8_t CSx3210)
+{
+	return CSx3210 ? (1 << pwm_prescaler_log2(Timer, CSx3210)) : 0;
+}
+
+// largest count per slope : TOP + 1 (single slope), TOP (dual slope)
+constexpr uint32_t pwm_count_max(const uint8_t Timer, const bool DualSlope)
+{
+	return (uint32_t)pwm_timer_max(Timer) + !DualSlope;
+}
+
+// TimerClock / FrequencyHz / 2^log2PS rounded to nearest
+constexpr uint32_t pwm_round_count(const uint32_t FrequencyCount, const uint32_t Remainder, const uint32_t FrequencyHz, const uint8_t log2PS)
+{
+	// (FrequencyCount + Remainder/FrequencyHz) / 2^log2PS rounds up when bit (log2PS - 1) of FrequencyCount is set
+	return (FrequencyCount >> log2PS) + ((log2PS == 0) ? (2 * Remainder >= FrequencyHz) : ((FrequencyCount >> (log2PS - 1)) & 1));
+}
+constexpr uint32_t pwm_clamp_count(const uint32_t Count, const uint32_t CountMax)
+{
+	return (Count < 2) ? 2 : ((Count > CountMax) ? CountMax : Count);
+}
+
+// timer clocks per period (or per slope), rounded to nearest, limited to what the timer can count
+constexpr uint32_t pwm_period_count(const uint8_t Timer, const uint8_t CSx3210, const uint32_t FrequencyCount, const uint32_t Remainder, const uint32_t FrequencyHz, const bool DualSlope)
+{
+	return pwm_clamp_count(pwm_round_count(FrequencyCount, Remainder, FrequencyHz, pwm_prescaler_log2(Timer, CSx3210)), pwm_count_max(Timer, DualSlope));
+}
+
+constexpr uint32_t pwm_abs_diff(const uint32_t a, const uint32_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+// |PS * count * FrequencyHz - TimerClock|, proportional to the period error
+// candidates over twice the requested period are rejected before the product can overflow
+constexpr uint32_t pwm_period_error(const uint8_t Timer, const uint8_t CSx3210, const uint32_t FrequencyCount, const uint32_t Remainder, const uint32_t FrequencyHz, const uint32_t BaseClock, const bool DualSlope)
+{
+	return ((pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) << pwm_prescaler_log2(Timer, CSx3210)) > 2 * FrequencyCount + 2) ? 0xFFFFFFFF :
+		pwm_abs_diff((pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) << pwm_prescaler_log2(Timer, CSx3210)) * FrequencyHz, BaseClock);
+}
+
+// compile time search, PWM::solve() is the run time loop
+constexpr uint8_t pwm_best_cs(const uint8_t Timer, const uint32_t FrequencyCount, const uint32_t Remainder, const uint32_t FrequencyHz, const uint32_t BaseClock, const bool DualSlope, const uint8_t CSx3210 = 2, const uint8_t Best = 1)
+{
+	return (CSx3210 > pwm_cs_max(Timer)) ? Best :
+		pwm_best_cs(Timer, FrequencyCount, Remainder, FrequencyHz, BaseClock, DualSlope, CSx3210 + 1,
+			(pwm_period_error(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, BaseClock, DualSlope) < pwm_period_error(Timer, Best, FrequencyCount, Remainder, FrequencyHz, BaseClock, DualSlope)) ? CSx3210 : Best);
+}
+
+constexpr uint8_t pwm_log2(const uint32_t n)
+{
+	return (n < 2) ? 0 : 1 + pwm_log2(n >> 1);
+}
+// Diff * 1e6 / Den in 32 bits : both are halved until Diff * 1e6 fits
+constexpr int32_t pwm_ppm(const int32_t Diff, const uint32_t Den)
+{
+	return ((Diff > 2147) | (Diff < -2147)) ? pwm_ppm(Diff / 2, Den / 2) : (Den ? (Diff * (int32_t)1000000) / (int32_t)Den : 0);
+}
+
+constexpr PWM_Result pwm_result(const uint8_t Timer, const uint8_t CSx3210, const uint32_t FrequencyCount, const uint32_t Remainder, const uint32_t FrequencyHz, const uint32_t BaseClock, const bool DualSlope)
+{
+	return PWM_Result{ CSx3210, pwm_prescaler(Timer, CSx3210),
+		(uint16_t)(pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) - !DualSlope),
+		BaseClock, (pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) << pwm_prescaler_log2(Timer, CSx3210)) << DualSlope,
+		pwm_ppm((int32_t)(BaseClock - (pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) << pwm_prescaler_log2(Timer, CSx3210)) * FrequencyHz),
+			(pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope) << pwm_prescaler_log2(Timer, CSx3210)) * FrequencyHz),
+		pwm_log2(pwm_period_count(Timer, CSx3210, FrequencyCount, Remainder, FrequencyHz, DualSlope)), 0 };
+}
+
+// Register image (PWM_Config), from the back-end's description of its mode registers :
+//   pwm_output_pin(Timer, Out)                        : Arduino pin of output 'a' + Out, PWM_NO_PIN if none
+//   pwm_config_out_mask(Timer, Out, Reg)              : bits of Control[Reg] that belong to the output
+//   pwm_config_out_bits(Timer, Out, Reg, invertOut)   : the ones it sets
+//   pwm_config_mode_bits(Timer, Mode, CSx3210, Reg)   : waveform mode and clock select bits
+constexpr uint8_t pwm_out_index(const char ABCD_out)
+{
+	return (uint8_t)((ABCD_out | 0x20) - 'a');
+}
+
+constexpr uint8_t pwm_config_control(const PWM_Config Config, const uint8_t Out, const uint8_t Reg, const bool invertOut)
+{
+	return (Config.Control[Reg] & ~pwm_config_out_mask(Config.Timer, Out, Reg)) | pwm_config_out_bits(Config.Timer, Out, Reg, invertOut);
+}
+
+constexpr PWM_Config pwm_config_output(const PWM_Config Config, const uint8_t Out, const uint16_t PulseWidthRegister, const bool invertOut)
+{
+	return PWM_Config{ Config.Timer, Config.CSx3210, Config.DualSlope,
+		(uint8_t)(Config.Outputs | (((Out < 4) && (pwm_output_pin(Config.Timer, Out) != PWM_NO_PIN)) ? _BV(Out) : 0)), Config.Top,
+		{ (Out == 0) ? PulseWidthRegister : Config.Compare[0], (Out == 1) ? PulseWidthRegister : Config.Compare[1],
+		  (Out == 2) ? PulseWidthRegister : Config.Compare[2], (Out == 3) ? PulseWidthRegister : Config.Compare[3] },
+		{ pwm_config_control(Config, Out, 0, invertOut), pwm_config_control(Config, Out, 1, invertOut),
+		  pwm_config_control(Config, Out, 2, invertOut), pwm_config_control(Config, Out, 3, invertOut) } };
+}
+
+// no output connected yet
+constexpr PWM_Config pwm_config_timer(const uint8_t Timer, const PWM_Mode WaveformMode, const uint8_t CSx3210, const uint16_t Top)
+{
+	return PWM_Config{ Timer, CSx3210, WaveformMode != PWM_FAST, 0, Top, { 0,0,0,0 },
+		{ pwm_config_mode_bits(Timer, WaveformMode, CSx3210, 0), pwm_config_mode_bits(Timer, WaveformMode, CSx3210, 1),
+		  pwm_config_mode_bits(Timer, WaveformMode, CSx3210, 2), pwm_config_mode_bits(Timer, WaveformMode, CSx3210, 3) } };
+}
+
+// the prescalar of pwm_best_cs (the choice of set<>), SlopeHz = FrequencyHz << DualSlope
+constexpr PWM_Config pwm_config_solved(const uint8_t Timer, const PWM_Mode WaveformMode, const uint32_t SlopeHz, const uint32_t TimerClock, const uint8_t CSx3210)
+{
+	return pwm_config_timer(Timer, WaveformMode, CSx3210,
+		pwm_period_count(Timer, CSx3210, TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, WaveformMode != PWM_FAST) - (WaveformMode == PWM_FAST));
+}
+constexpr PWM_Config pwm_config_solve(const uint8_t Timer, const PWM_Mode WaveformMode, const uint32_t SlopeHz, const uint32_t TimerClock)
+{
+	return pwm_config_solved(Timer, WaveformMode, SlopeHz, TimerClock,
+		pwm_best_cs(Timer, TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, TimerClock, WaveformMode != PWM_FAST));
+}
+
+constexpr PWM_Config PWM_Config::compute(const uint8_t Timer, const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const bool invertOut, const PWM_Mode Mode, const uint32_t TimerClock)
+{
+	return pwm_config_solve(Timer, pwm_mode(Timer, Mode), FrequencyHz << (pwm_mode(Timer, Mode) != PWM_FAST), TimerClock).output(ABCD_out, Duty, invertOut);
+}
+
+constexpr PWM_Config PWM_Config::output(const char ABCD_out, const PWM_Duty Duty, const bool invertOut) const
+{
+	return pwm_config_output(*this, pwm_out_index(ABCD_out), pwm_scale_duty(Top, !DualSlope, Duty), invertOut);
+}
+
+constexpr bool PWM_Config::operator==(const PWM_Config &Other) const
+{
+	return (Timer == Other.Timer) & (CSx3210 == Other.CSx3210) & (DualSlope == Other.DualSlope) & (Outputs == Other.Outputs) & (Top == Other.Top) &
+		(Compare[0] == Other.Compare[0]) & (Compare[1] == Other.Compare[1]) & (Compare[2] == Other.Compare[2]) & (Compare[3] == Other.Compare[3]) &
+		(Control[0] == Other.Control[0]) & (Control[1] == Other.Control[1]) & (Control[2] == Other.Control[2]) & (Control[3] == Other.Control[3]);
+}
+
+bool PWM::subscribe(const uint8_t Timer, const char ABCD_out, void(*isr)(void *), void *Context)
+{
+	const uint8_t Vector = pwm_vector(Timer, ABCD_out);
+	if (Vector == PWM_VECTORS)
+	{
+		return false;
+	}
+	PWM_Subscribers &s = pwm_subscribers[Vector];
+	const uint8_t sreg = SREG;
+	cli();
+	const uint8_t Count = s.Count;
+	if (Count == PWM_SUBSCRIBERS)
+	{
+		SREG = sreg;
+		return false;
+	}
+	s.Entry[Count].Isr = isr;
+	s.Entry[Count].Context = Context;
+	s.Count = Count + 1;
+	SREG = sreg;
+	attachInterrupt(Timer, ABCD_out, pwm_subscribers_isr[Vector]);
+	return true;
+}
+
+bool PWM::unsubscribe(const uint8_t Timer, const char ABCD_out, void(*isr)(void *), void *Context)
+{
+	const uint8_t Vector = pwm_vector(Timer, ABCD_out);
+	if (Vector == PWM_VECTORS)
+	{
+		return false;
+	}
+	PWM_Subscribers &s = pwm_subscribers[Vector];
+	const uint8_t sreg = SREG;
+	cli();
+	uint8_t Count = s.Count;
+	uint8_t i = 0;
+	while ((i < Count) && ((s.Entry[i].Isr != isr) | (s.Entry[i].Context != Context))) { ++i; }
+	if (i == Count)
+	{
+		SREG = sreg;
+		return false;
+	}
+	// the later ones move up, in order
+	for (--Count; i < Count; ++i)
+	{
+		s.Entry[i] = s.Entry[i + 1];
+	}
+	s.Count = Count;
+	SREG = sreg;
+	if (Count == 0)
+	{
+		// no subscriber : no interrupt
+		detachInterrupt(Timer, ABCD_out);
+	}
+	return true;
+}
+
+PWM_Result PWM::solve(const uint8_t Timer, const uint32_t FrequencyHz, const PWM_Mode Mode)
+{
+	const bool DualSlope = (pwm_mode(Timer, Mode) != PWM_FAST);
+	const uint32_t SlopeHz = FrequencyHz << DualSlope;
+	const uint32_t TimerClock = timer_clock[Timer];
+	const uint32_t FrequencyCount = TimerClock / SlopeHz;
+	const uint32_t Remainder = TimerClock % SlopeHz;
+
+	uint8_t Best = 1;
+	uint32_t BestError = pwm_period_error(Timer, 1, FrequencyCount, Remainder, SlopeHz, TimerClock, DualSlope);
+	for (uint8_t CSx3210 = 2; CSx3210 <= pwm_cs_max(Timer); ++CSx3210)
+	{
+		const uint32_t Error = pwm_period_error(Timer, CSx3210, FrequencyCount, Remainder, SlopeHz, TimerClock, DualSlope);
+		if (Error < BestError)
+		{
+			Best = CSx3210;
+			BestError = Error;
+		}
+	}
+	return pwm_result(Timer, Best, FrequencyCount, Remainder, SlopeHz, TimerClock, DualSlope);
+}
+
+PWM_Result PWM::solve_dither(const uint8_t Timer, const uint32_t FrequencyHz, const PWM_Mode Mode)
+{
+	const bool DualSlope = (pwm_mode(Timer, Mode) != PWM_FAST);
+	const uint32_t SlopeHz = FrequencyHz << DualSlope;
+	const uint32_t TimerClock = timer_clock[Timer];
+	const uint32_t FrequencyCount = TimerClock / SlopeHz;
+	uint32_t Remainder = TimerClock % SlopeHz;
+
+	// smallest prescalar that fits the whole count, and the count + 1 of a dithered period
+	uint8_t CSx3210 = 1;
+	while (((FrequencyCount >> pwm_prescaler_log2(Timer, CSx3210)) >= pwm_count_max(Timer, DualSlope)) & (CSx3210 < pwm_cs_max(Timer))) { ++CSx3210; }
+	const uint8_t log2PS = pwm_prescaler_log2(Timer, CSx3210);
+	const uint32_t Count = FrequencyCount >> log2PS;
+
+	// out of range : nothing to dither
+	if ((Count < 2) | (Count >= pwm_count_max(Timer, DualSlope)))
+	{
+		return solve(Timer, FrequencyHz, Mode);
+	}
+	// fast PWM with an unbuffered TOP (ICRx, ATtinyX5 OCR1C) : TOVx is set at TOP and the ISR writes TOP
+	// while the counter may still read it, a TOP lowered below TCNTx loses the pulse (the counter runs on
+	// to MAX). The first TOP store is 40 cycles or more past the flag (instruction count) : no dithering
+	// with a timer count longer than 32 CPU cycles (above PS 8 on the ATmega, 32 at the CPU clock)
+	if (!DualSlope & !pwm_top_buffered(Timer) & ((TimerClock >> log2PS) < F_CPU / 32))
+	{
+		return solve(Timer, FrequencyHz, Mode);
+	}
+
+	// 16 fractional bits of Remainder / SlopeHz
+	uint16_t Fraction = 0;
+	for (uint8_t i = 0; i < 16; ++i)
+	{
+		Remainder <<= 1;
+		Fraction <<= 1;
+		if (Remainder >= SlopeHz)
+		{
+			Remainder -= SlopeHz;
+			Fraction |= 1;
+		}
+	}
+	// fraction of a count = ((FrequencyCount mod PS) + Remainder / SlopeHz) / PS
+	const uint32_t Mask = (1UL << log2PS) - 1;
+	const uint32_t Scaled = ((FrequencyCount & Mask) << 16) | Fraction;
+	Fraction = Scaled >> log2PS;
+	// what the 16 bit fraction leaves out, in 1/256 of its last bit
+	const uint32_t Dropped = (((Scaled & Mask) << 8) + ((Remainder << 8) / SlopeHz)) >> log2PS;
+
+	// achieved frequency = TimerClock / (PS * (Count + Fraction / 65536)) (/ 2 for dual slope)
+	// both terms are scaled by 2^Shift (8 at 16MHz) to keep part of the fraction in 32 bits
+	uint8_t Shift = 0;
+	while ((Shift < 16) && ((TimerClock << Shift) < 0x80000000UL)) { ++Shift; }
+	const uint32_t Numerator = TimerClock << Shift;
+	const uint32_t Denominator = (Count << (log2PS + Shift)) + (((uint32_t)Fraction << log2PS) >> (16 - Shift));
+
+	PWM_Result Result;
+	Result.CSx3210 = CSx3210;
+	Result.Prescalar = pwm_prescaler(Timer, CSx3210);
+	Result.PeriodRegister = Count - !DualSlope;
+	Result.FrequencyNumerator = Numerator;
+	Result.FrequencyDenominator = Denominator << DualSlope;
+	// the period is short by Dropped / 2^24 counts, Dropped * 1e6 / 2^24 / (Count + Fraction / 65536) ppm
+	Result.Error_ppm = ((Dropped * 15625UL) >> 2) / ((Count << 16) + Fraction);
+	Result.DutyBits = pwm_log2(Count);
+	Result.PeriodFraction = Fraction;
+	return Result;
+}
+
+PWM_Result PWM::stageFrequency(const uint8_t Timer, const uint32_t FrequencyHz)
+{
+	const bool DualSlope = pwm_dual_slope & _BV(Timer);
+	const uint32_t SlopeHz = FrequencyHz << DualSlope;
+	const uint32_t TimerClock = timer_clock[Timer];
+	const PWM_Result Result = pwm_result(Timer, PS_IDX[Timer], TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, TimerClock, DualSlope);
+	stagePeriod(Timer, Result.PeriodRegister);
+	return Result;
+}
+
+template <uint8_t Timer, char ABCD_out, uint32_t FrequencyHz, uint16_t DutyCycle_Divisor, bool invertOut, PWM_Mode Mode, uint32_t TimerClock>
+PWM_Result PWM::set()
+{
+	constexpr PWM_Mode WaveformMode = pwm_mode(Timer, Mode);
+	constexpr bool DualSlope = (WaveformMode != PWM_FAST);
+	constexpr uint32_t SlopeHz = FrequencyHz << DualSlope;
+
+	static_assert(pwm_timer_max(Timer) != 0, "PWM::set<> : this timer does not exist on this chip");
+	static_assert((FrequencyHz > 0) & (SlopeHz <= TimerClock / 2), "PWM::set<> : FrequencyHz is too high, the period must be at least 2 clock cycles");
+	static_assert(pwm_round_count(TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, pwm_prescaler_log2(Timer, pwm_cs_max(Timer))) <= pwm_count_max(Timer, DualSlope),
+		"PWM::set<> : FrequencyHz is too low for this timer");
+	static_assert(DutyCycle_Divisor > 0, "PWM::set<> : DutyCycle_Divisor must be > 0");
+
+	constexpr uint8_t CSx3210 = pwm_best_cs(Timer, TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, TimerClock, DualSlope);
+	constexpr PWM_Result Result = pwm_result(Timer, CSx3210, TimerClock / SlopeHz, TimerClock % SlopeHz, SlopeHz, TimerClock, DualSlope);
+	constexpr uint16_t PulseWidthRegister = Result.PeriodRegister / DutyCycle_Divisor;
+
+	PS_IDX[Timer] = Result.CSx3210;
+	PS[Timer] = Result.Prescalar;
+	pwm_set_period(Timer, Result.PeriodRegister, DualSlope);
+	set_output(Timer, ABCD_out, Result.PeriodRegister, PulseWidthRegister, invertOut, WaveformMode);
+	return Result;
+}
+
 PWM pwm;
 
 #endif
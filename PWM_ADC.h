@@ -0,0 +1,195 @@
+#ifndef PWM_ADC_H
+#define PWM_ADC_H
+
+// ADC conversions triggered by a PWM timer
+// The ADC auto trigger (ADCSRB ADTS) starts a conversion at the overflow or at a compare match of a
+// timer set() has configured : the hardware picks the sampling instant, without ISR latency or jitter.
+// begin() places the compare at a fraction of the period, ADC_vect puts the results in a ring buffer :
+//
+//   #include <PWM.h>
+//   #include <PWM_ADC.h>
+//   pwm.set(1, 'a', 4000, pwm_q16(0x4000));     // OC1A high for the first 25% of the period
+//   pwm.start();
+//   pwm_adc.begin(1, 'b', 0, pwm_q16(0x2000));  // ADC0 in the middle of the pulse, through OCR1B
+//   uint16_t Sample;
+//   while (pwm_adc.read(Sample)) { ... }        // oldest first
+//
+// Triggers : Timer0 and Timer1 overflow, Timer1 compare B (ATmega328p, ATmega32u4), Timer4 overflow and
+// compare A, B, D (ATmega32u4), Timer0 overflow and compare B (ATtinyX5). The compare registers used as
+// TOP (OCR0A, OCR4C) are not. The compare of the trigger is taken : its output must not be set().
+// The sample and hold comes 2 ADC clocks after the trigger : in the single slope modes place() sets the
+// compare that much earlier (in the period before if need be), so the sample is taken at the fraction
+// asked. An overflow trigger samples 2 ADC clocks after TOV : at TOP in fast PWM, one count before the
+// period starts. In the dual slope modes the compare matches counting up and down, two conversions per
+// period, without the lead : the overflow (BOTTOM) is the middle of a non inverted pulse there.
+// A conversion takes 13.5 ADC clocks, 108us at the default ADC clock (the fastest up to 200kHz, for 10
+// bits : F_CPU / 128 at 16MHz). The triggers during a conversion are lost : at a higher PWM frequency
+// one period in two or three is sampled, or begin() with a smaller ADPS (less accurate).
+// ADC_vect stores the results (ADC, right adjusted) in PWM_ADC_SAMPLES entries (default 16, a power of
+// two up to 128) as a circular DMA would : when the buffer is full the oldest sample is overwritten,
+// overruns() counts them. It also clears the flag of the trigger when no ISR does : a flag left set is
+// no rising edge, no trigger. By instruction count (not measured, see PWM_Profile.h to time a build),
+// ADC_vect takes ~100 cycles a conversion : response and jmp 7, prologue 20, ring store 19, count or
+// overrun 12, flag of the trigger 16, epilogue 20, reti 4. At one conversion per 108us that is ~6% of
+// the CPU at 16MHz, ~12% on an ATtinyX5 at 8MHz. analogRead() cannot be used from begin() to end(). With PWM_NOISR, bind
+// the vector yourself : ISR(ADC_vect) { pwm_adc_sample(); }
+
+#include <PWM.h>
+
+#ifndef PWM_ADC_SAMPLES
+#define PWM_ADC_SAMPLES 16
+#endif
+static_assert(((PWM_ADC_SAMPLES & (PWM_ADC_SAMPLES - 1)) == 0) & (PWM_ADC_SAMPLES <= 128), "PWM_ADC_SAMPLES : a power of two up to 128");
+
+// ADC prescaler bits of the fastest ADC clock up to 200kHz
+constexpr uint8_t pwm_adc_adps(const uint32_t Clock, const uint8_t ADPS = 1)
+{
+	return (((Clock >> ADPS) <= 200000UL) | (ADPS == 7)) ? ADPS : pwm_adc_adps(Clock, ADPS + 1);
+}
+
+volatile uint16_t pwm_adc_buffer[PWM_ADC_SAMPLES];
+volatile uint8_t pwm_adc_head = 0;  // next entry written
+volatile uint8_t pwm_adc_count = 0; // samples not read
+volatile uint16_t pwm_adc_overruns = 0;
+uint8_t pwm_adc_source = 0xFF;      // ADTS of the trigger, 0xFF : stopped
+
+// a conversion is done (ADC_vect)
+inline void pwm_adc_sample()
+{
+	const uint8_t Head = pwm_adc_head;
+	pwm_adc_buffer[Head] = ADC;
+	pwm_adc_head = (Head + 1) & (PWM_ADC_SAMPLES - 1);
+	const uint8_t Count = pwm_adc_count;
+	if (Count == PWM_ADC_SAMPLES) { pwm_adc_overruns = pwm_adc_overruns + 1; }
+	else { pwm_adc_count = Count + 1; }
+	pwm_adc_rearm(pwm_adc_source);
+}
+
+#ifndef PWM_NOISR
+ISR(ADC_vect)
+{
+	pwm_adc_sample();
+}
+#endif
+
+class PWM_ADC {
+protected:
+	uint8_t Timer = 0;
+	char Out = 0; // 0 : overflow trigger
+	uint8_t ADPS = 7;
+
+public:
+	// conversions of Channel (the MUX bits) at the overflow ('o') or the compare ABCD_out of Timer (set()
+	// before), At : the sampling instant of a compare trigger, a fraction of the period. Reference : the
+	// REFS bits. false : that event cannot trigger the ADC
+	bool begin(const uint8_t Timer, const char ABCD_out, const uint8_t Channel, const PWM_Duty At = pwm_q16(0x8000),
+		const uint8_t Reference = PWM_ADC_VCC, const uint8_t ADPS = pwm_adc_adps(F_CPU));
+	// move the sampling instant of a compare trigger (e.g. after a duty cycle change)
+	void place(const PWM_Duty At);
+	// stop triggering, the ADC stays enabled for analogRead()
+	void end();
+
+	// samples not read
+	uint8_t available() const { return pwm_adc_count; }
+	// the oldest sample not read, false if none
+	bool read(uint16_t &Sample);
+	// the last conversion
+	uint16_t latest() const;
+	// samples overwritten before they were read, since the last call
+	uint16_t overruns();
+};
+
+bool PWM_ADC::begin(const uint8_t Timer, const char ABCD_out, const uint8_t Channel, const PWM_Duty At, const uint8_t Reference, const uint8_t ADPS)
+{
+	const uint8_t Source = pwm_adc_trigger(Timer, ABCD_out);
+	if (Source == 0xFF)
+	{
+		return false;
+	}
+	this->Timer = Timer;
+	this->Out = pwm_vector_slot(ABCD_out) ? ABCD_out : 0;
+	this->ADPS = ADPS;
+	if (Out)
+	{
+		place(At);
+	}
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_adc_head = 0;
+	pwm_adc_count = 0;
+	pwm_adc_overruns = 0;
+	pwm_adc_source = Source;
+	pwm_adc_rearm(Source);
+	pwm_adc_setup(Source, Channel, Reference, ADPS);
+	SREG = sreg;
+	return true;
+}
+
+void PWM_ADC::place(const PWM_Duty At)
+{
+	if (Out == 0)
+	{
+		return;
+	}
+	const uint16_t Top = pwm_period_register[Timer];
+	const bool SingleSlope = !(pwm_dual_slope & _BV(Timer));
+	uint16_t Compare = pwm_scale_duty(Top, SingleSlope, At);
+	if (SingleSlope)
+	{
+		// 2 ADC clocks in timer ticks, the timer clock in kHz so that the product fits in 32 bits
+		const uint32_t Period = (uint32_t)Top + 1;
+		const uint32_t Lead = ((((uint32_t)2 << ADPS) * (pwm.getClock(Timer) / 1000) / (F_CPU / 1000)) >>
+			pwm_prescaler_log2(Timer, pwm.getClockSelect(Timer))) % Period;
+		Compare = (Compare >= Lead) ? Compare - Lead : (uint16_t)(Compare + Period - Lead);
+	}
+	PWM::setDuty(Timer, Out, Compare);
+}
+
+void PWM_ADC::end()
+{
+	const uint8_t sreg = SREG;
+	cli();
+	ADCSRA &= ~_BV(ADATE) & ~_BV(ADIE);
+	pwm_adc_source = 0xFF;
+	SREG = sreg;
+}
+
+bool PWM_ADC::read(uint16_t &Sample)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint8_t Count = pwm_adc_count;
+	if (Count == 0)
+	{
+		SREG = sreg;
+		return false;
+	}
+	Sample = pwm_adc_buffer[(pwm_adc_head - Count) & (PWM_ADC_SAMPLES - 1)];
+	pwm_adc_count = Count - 1;
+	SREG = sreg;
+	return true;
+}
+
+uint16_t PWM_ADC::latest() const
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t Sample = pwm_adc_buffer[(pwm_adc_head - 1) & (PWM_ADC_SAMPLES - 1)];
+	SREG = sreg;
+	return Sample;
+}
+
+uint16_t PWM_ADC::overruns()
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t Overruns = pwm_adc_overruns;
+	pwm_adc_overruns = 0;
+	SREG = sreg;
+	return Overruns;
+}
+
+PWM_ADC pwm_adc;
+
+#endif
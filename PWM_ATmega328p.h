@@ -18,8 +18,8 @@
 // 
 
 //void(*pwm_interrupt0)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
 
 void(*pwm_interrupt1)() = &pwm_empty_interrupt;
 void(*pwm_interrupt1a)() = &pwm_empty_interrupt;
@@ -29,19 +29,122 @@ void(*pwm_interrupt2)() = &pwm_empty_interrupt;
 void(*pwm_interrupt2a)() = &pwm_empty_interrupt;
 void(*pwm_interrupt2b)() = &pwm_empty_interrupt;
 
+// period dither, installed as the overflow callback by set_dither (see PWM_Dither.h)
+void pwm_dither1() { pwm_dither_step(pwm_dither[1], ICR1); }
+
+// staged update, installed as the overflow callback by commit (see PWM_Commit.h)
+void pwm_commit1() { pwm_commit_step(1, TCNT1, ICR1, &OCR1A, &OCR1B, (volatile uint16_t *)0, false, &TCCR1B, _BV(CS12) | _BV(CS11) | _BV(CS10), pwm_interrupt1, TIMSK1, TOIE1); }
+void pwm_commit2() { pwm_commit_step(2, TCNT2, OCR2A, (volatile uint8_t *)0, &OCR2B, (volatile uint8_t *)0, true, (volatile uint8_t *)0, 0, pwm_interrupt2, TIMSK2, TOIE2); }
+
+#if defined(PWM_DECIMATE)
+// down counter in front of the attached overflow callback (see PWM_Decimate.h)
+void pwm_decimated1() { pwm_decimate_step(1); }
+void pwm_decimated2() { pwm_decimate_step(2); }
+#endif
+
+// subscriber tables, installed as the callback of a vector by subscribe() (see PWM_Subscribe.h)
+enum { PWM_VECTOR_T0A = 0, PWM_VECTOR_T0B, PWM_VECTOR_T1, PWM_VECTOR_T1A, PWM_VECTOR_T1B, PWM_VECTOR_T2, PWM_VECTOR_T2A, PWM_VECTOR_T2B, PWM_VECTORS };
+PWM_Subscribers pwm_subscribers[PWM_VECTORS];
+void pwm_subscribers_t0a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0A]); }
+void pwm_subscribers_t0b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0B]); }
+void pwm_subscribers_t1() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1]); }
+void pwm_subscribers_t1a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1A]); }
+void pwm_subscribers_t1b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1B]); }
+void pwm_subscribers_t2() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T2]); }
+void pwm_subscribers_t2a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T2A]); }
+void pwm_subscribers_t2b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T2B]); }
+void(*const pwm_subscribers_isr[PWM_VECTORS])() = {
+	pwm_subscribers_t0a, pwm_subscribers_t0b, pwm_subscribers_t1, pwm_subscribers_t1a, pwm_subscribers_t1b, pwm_subscribers_t2, pwm_subscribers_t2a, pwm_subscribers_t2b };
+
+// table of the overflow (any ABCD_out but an output) or of an output of Timer, PWM_VECTORS if none
+constexpr uint8_t pwm_vector(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & ((uint8_t)(pwm_vector_slot(ABCD_out) - 1) < 2)) ? PWM_VECTOR_T0A + pwm_vector_slot(ABCD_out) - 1 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) <= 2)) ? PWM_VECTOR_T1 + pwm_vector_slot(ABCD_out) :
+		((Timer == 2) & (pwm_vector_slot(ABCD_out) <= 2)) ? PWM_VECTOR_T2 + pwm_vector_slot(ABCD_out) : PWM_VECTORS;
+}
+
+// the overflow flag of Timer is set : a period started since its overflow ISR was entered
+inline bool pwm_overflow_pending(const uint8_t Timer)
+{
+	switch (Timer)
+	{
+	case 0: return TIFR0 & _BV(TOV0);
+	case 1: return TIFR1 & _BV(TOV1);
+	case 2: return TIFR2 & _BV(TOV2);
+	}
+	return false;
+}
+
+// ADC auto trigger (see PWM_ADC.h)
+#define PWM_ADC_VCC 1 // REFS[10] : AVcc
+
+// ADTS of the overflow (any ABCD_out but an output) or compare ABCD_out of Timer, 0xFF if it cannot
+// trigger the ADC. OCR0A is TOP, not a sampling compare
+constexpr uint8_t pwm_adc_trigger(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & (pwm_vector_slot(ABCD_out) == 0)) ? 4 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) == 0)) ? 6 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) == 2)) ? 5 : 0xFF;
+}
+
+// conversions of Channel (MUX[3..0]) against Reference (REFS[10]), started by the trigger ADTS, ADC
+// clock F_CPU >> ADPS, with the ADC interrupt
+inline void pwm_adc_setup(const uint8_t ADTS, const uint8_t Channel, const uint8_t Reference, const uint8_t ADPS)
+{
+	//ADMUX  = [ REFS1| REFS0| ADLAR|   -  |  MUX3|  MUX2|  MUX1|  MUX0]
+	ADMUX = (Reference << REFS0) | (Channel & 0x0F);
+	//ADCSRB = [   -  |  ACME|   -  |   -  |   -  | ADTS2| ADTS1| ADTS0]
+	ADCSRB = (ADCSRB & _BV(ACME)) | ADTS;
+	//ADCSRA = [  ADEN|  ADSC| ADATE|  ADIF|  ADIE| ADPS2| ADPS1| ADPS0]
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | ADPS;
+}
+
+// clear the flag of the trigger ADTS if no ISR does : the next event must be a rising edge
+inline void pwm_adc_rearm(const uint8_t ADTS)
+{
+	switch (ADTS)
+	{
+	case 4: if (!(TIMSK0 & _BV(TOIE0))) { TIFR0 = _BV(TOV0); } break;
+	case 5: if (!(TIMSK1 & _BV(OCIE1B))) { TIFR1 = _BV(OCF1B); } break;
+	case 6: if (!(TIMSK1 & _BV(TOIE1))) { TIFR1 = _BV(TOV1); } break;
+	}
+}
+
+// ISR profiler slots (see PWM_Profile.h)
+#if defined(PWM_PROFILE)
+enum { PWM_PROFILE_T1 = 0, PWM_PROFILE_T1A, PWM_PROFILE_T1B, PWM_PROFILE_T2, PWM_PROFILE_T2A, PWM_PROFILE_T2B, PWM_PROFILE_T0A, PWM_PROFILE_T0B, PWM_PROFILE_USER };
+static_assert(PWM_PROFILE_USER <= PWM_PROFILE_SLOTS, "PWM_PROFILE_SLOTS : one per vector at least");
+#endif
+
 #ifndef PWM_NOISR
 //TIMER0_OVF_vect is already defined in wiring.h (used by millis())
 //ISR(TIMER0_OVF_vect) { interrupt0(); }
-//ISR(TIMER0_COMPA_vect) { pwm_interrupt0a(); }
-//ISR(TIMER0_COMPB_vect) { pwm_interrupt0b(); }
 
-ISR(TIMER1_OVF_vect) { pwm_interrupt1(); }
-ISR(TIMER1_COMPA_vect) { pwm_interrupt1a(); }
-ISR(TIMER1_COMPB_vect) { pwm_interrupt1b(); }
+#if defined(PWM_DITHER_FAST)
+PWM_DITHER_ISR16(TIMER1_OVF_vect, 1, ICR1)
+#elif defined(PWM_DECIMATE) & !defined(PWM_PROFILE) & !defined(PWM_ISR_STATIC)
+PWM_DECIMATE_ISR(TIMER1_OVF_vect, 1)
+#elif !defined(PWM_ISR_STATIC)
+PWM_ISR_PROFILED(TIMER1_OVF_vect, pwm_interrupt1, PWM_PROFILE_T1, TCNT1, pwm_profile_top(1), pwm_profile_top(1))
+#endif
+
+#if defined(PWM_DECIMATE) & !defined(PWM_PROFILE) & !defined(PWM_ISR_STATIC)
+PWM_DECIMATE_ISR(TIMER2_OVF_vect, 2)
+#elif !defined(PWM_ISR_STATIC)
+PWM_ISR_PROFILED(TIMER2_OVF_vect, pwm_interrupt2, PWM_PROFILE_T2, TCNT2, pwm_profile_top(2), pwm_profile_top(2))
+#endif
+
+#ifndef PWM_ISR_STATIC
+PWM_ISR_PROFILED(TIMER0_COMPA_vect, pwm_interrupt0a, PWM_PROFILE_T0A, TCNT0, OCR0A, pwm_profile_top(0))
+PWM_ISR_PROFILED(TIMER0_COMPB_vect, pwm_interrupt0b, PWM_PROFILE_T0B, TCNT0, OCR0B, pwm_profile_top(0))
 
-ISR(TIMER2_OVF_vect) { pwm_interrupt2(); }
-ISR(TIMER2_COMPA_vect) { pwm_interrupt2a(); }
-ISR(TIMER2_COMPB_vect) { pwm_interrupt2b(); }
+PWM_ISR_PROFILED(TIMER1_COMPA_vect, pwm_interrupt1a, PWM_PROFILE_T1A, TCNT1, OCR1A, pwm_profile_top(1))
+PWM_ISR_PROFILED(TIMER1_COMPB_vect, pwm_interrupt1b, PWM_PROFILE_T1B, TCNT1, OCR1B, pwm_profile_top(1))
+
+PWM_ISR_PROFILED(TIMER2_COMPA_vect, pwm_interrupt2a, PWM_PROFILE_T2A, TCNT2, OCR2A, pwm_profile_top(2))
+PWM_ISR_PROFILED(TIMER2_COMPB_vect, pwm_interrupt2b, PWM_PROFILE_T2B, TCNT2, OCR2B, pwm_profile_top(2))
+#endif
 #endif
 
 volatile bool OCR2A_state = false;
@@ -53,6 +156,153 @@ volatile bool OCR2A_state = false;
 #define OCR2A_pin 12
 #define OCR2B_pin 3
 
+// Timer description, used by the frequency solver (PWM::solve)
+// log2 of the prescalar selected by CSx[210] : Timer0/1 regular list, Timer2 has its own list
+//                                         1 8 64 256 1024
+constexpr uint8_t pwm_PS_regular_log2[8] = { 0,0,3,6, 8, 10,0,0 };
+//                                        1 8 32 64 128 256 1024
+constexpr uint8_t pwm_PS_timer2_log2[8] = { 0,0,3,5, 6, 7,  8, 10 };
+
+// TOP limit of the timer (0 : no such timer)
+constexpr uint16_t pwm_timer_max(const uint8_t Timer)
+{
+	return (Timer == 1) ? 0xFFFF : (((Timer == 0) | (Timer == 2)) ? 0xFF : 0);
+}
+// largest CSx[210] that selects an internal prescalar
+constexpr uint8_t pwm_cs_max(const uint8_t Timer)
+{
+	return (Timer == 2) ? 7 : 5;
+}
+// waveform mode of a timer for Mode : Timer0/2 (OCRxA as TOP) have no phase and frequency correct mode
+constexpr PWM_Mode pwm_mode(const uint8_t Timer, const PWM_Mode Mode)
+{
+	return ((Mode == PWM_FAST) | (Timer == 1)) ? Mode : PWM_PHASE_CORRECT;
+}
+// timer with a period ditherer on its overflow ISR
+constexpr bool pwm_dither_timer(const uint8_t Timer)
+{
+	return Timer == 1;
+}
+// TOP register double buffered in the PWM modes (OCR0A, OCR2A), ICR1 is not
+constexpr bool pwm_top_buffered(const uint8_t Timer)
+{
+	return Timer != 1;
+}
+constexpr uint8_t pwm_prescaler_log2(const uint8_t Timer, const uint8_t CSx3210)
+{
+	return (Timer == 2) ? pwm_PS_timer2_log2[CSx3210] : pwm_PS_regular_log2[CSx3210];
+}
+
+// Register image (PWM_Config) : Control = TCCRxA, TCCRxB
+// Arduino pin of output 'a' + Out
+constexpr uint8_t pwm_output_pin(const uint8_t Timer, const uint8_t Out)
+{
+	return (Out == 0) ? ((Timer == 0) ? OCR0A_pin : ((Timer == 1) ? OCR1A_pin : ((Timer == 2) ? OCR2A_pin : PWM_NO_PIN))) :
+		((Out == 1) ? ((Timer == 0) ? OCR0B_pin : ((Timer == 1) ? OCR1B_pin : ((Timer == 2) ? OCR2B_pin : PWM_NO_PIN))) : PWM_NO_PIN);
+}
+//TCCRxA = [COMxA1|COMxA0|COMxB1|COMxB0|   -  |   -  | WGMx1| WGMx0]
+constexpr uint8_t pwm_config_out_mask(const uint8_t Timer, const uint8_t Out, const uint8_t Reg)
+{
+	return ((Reg != 0) | (pwm_output_pin(Timer, Out) == PWM_NO_PIN)) ? 0 : ((Out == 0) ? 0xC0 : 0x30);
+}
+// OCR0A and OCR2A are TOP : toggled (COMxA = 01)
+constexpr uint8_t pwm_config_out_bits(const uint8_t Timer, const uint8_t Out, const uint8_t Reg, const bool invertOut)
+{
+	return (pwm_config_out_mask(Timer, Out, Reg) == 0) ? 0 :
+		((Out == 0) ? ((Timer == 1) ? ((2 + invertOut) << 6) : _BV(COM0A0)) : ((2 + invertOut) << 4));
+}
+// same modes as set_output
+//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
+//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+constexpr uint8_t pwm_config_mode_bits(const uint8_t Timer, const PWM_Mode Mode, const uint8_t CSx3210, const uint8_t Reg)
+{
+	return (Reg == 0) ?
+			((Timer == 1) ? ((Mode == PWM_PHASE_FREQUENCY_CORRECT) ? 0 : _BV(WGM11)) : ((Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00))) :
+		((Reg == 1) ?
+			(((Timer == 1) ? ((Mode == PWM_FAST) ? (_BV(WGM13) | _BV(WGM12)) : _BV(WGM13)) : _BV(WGM02)) | CSx3210) : 0);
+}
+
+// Software PWM timebase (see PWM_Soft.h) : Timer2 in CTC mode, the OCR2A (TOP) match starts
+// the period, OCR2B steps through the edges
+#define PWM_SOFT_TIMER 2
+#define PWM_SOFT_TCNT TCNT2
+#define PWM_SOFT_EDGE_OCR OCR2B
+#define PWM_SOFT_TIMSK TIMSK2
+#define PWM_SOFT_EDGE_IE OCIE2B
+#define PWM_SOFT_TIFR TIFR2
+#define PWM_SOFT_EDGE_IF OCF2B
+#define pwm_soft_period_interrupt pwm_interrupt2a
+#define pwm_soft_edge_interrupt pwm_interrupt2b
+
+inline void pwm_soft_timebase(const uint16_t PeriodRegister, const uint8_t CSx3210)
+{
+	//TCCR2A = [COM2A1|COM2A0|COM2B1|COM2B0|   -  |   -  | WGM21| WGM20]
+	//TCCR2B = [ FOC2A| FOC2B|   -  |   -  | WGM22|  CS22|  CS21|  CS20]
+	// stopped, compare outputs disconnected, WGM2[210] = 010 CTC with OCR2A as TOP
+	TCCR2B = 0;
+	TCCR2A = _BV(WGM21);
+	OCR2A = PeriodRegister;
+	TCNT2 = 0;
+	//TIMSK2 = [   -  |   -  |   -  |   -  |   -  |OCIE2B|OCIE2A| TOIE2]
+	TIFR2 = _BV(OCF2B) | _BV(OCF2A) | _BV(TOV2);
+	TIMSK2 = _BV(OCIE2A);
+	TCCR2B = CSx3210;
+}
+
+// Bit angle modulation timebase (see PWM_BAM.h) : Timer1 counts freely (normal mode), each OCR1A
+// match ends a bit-plane slot and moves OCR1A on by the next one, the SPI master shifts the planes out
+#define PWM_BAM_TIMER 1
+#define PWM_BAM_SLOT_OCR OCR1A
+#define pwm_bam_slot_interrupt pwm_interrupt1a
+#define PWM_BAM_MOSI_pin 11
+#define PWM_BAM_SCK_pin 13
+#define PWM_BAM_SS_pin 10
+
+inline void pwm_bam_timebase(const uint16_t FirstMatch, const uint8_t CSx3210)
+{
+	//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|   -  |   -  | WGM11| WGM10]
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	// stopped, compare outputs disconnected, WGM1[3210] = 0000 normal
+	TCCR1B = 0;
+	TCCR1A = 0;
+	OCR1A = FirstMatch;
+	TCNT1 = 0;
+	//TIMSK1 = [   -  |   -  | ICIE1|   -  |   -  |OCIE1B|OCIE1A| TOIE1]
+	TIFR1 = _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TIMSK1 = _BV(OCIE1A);
+	TCCR1B = CSx3210;
+}
+
+// Long period timebase (see PWM_Long.h) : Timer1 counts freely (normal mode), OC1A and OC1B are set or
+// cleared by their match (non PWM), the match ISRs move OCR1x on towards the next edge
+#define PWM_LONG_TIMER 1
+#define PWM_LONG_BITS 16
+
+// Outputs : bit 0 OC1A, bit 1 OC1B, cleared by a forced compare, their first match at First
+inline void pwm_long_timebase(const uint8_t Outputs, const uint16_t First, const uint8_t CSx3210)
+{
+	//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|   -  |   -  | WGM11| WGM10]
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	//TCCR1C = [ FOC1A| FOC1B|   -  |   -  |   -  |   -  |   -  |   -  ]
+	// stopped, WGM1[3210] = 0000 normal, COM1x = 10 clear
+	TCCR1B = 0;
+	TCCR1A = ((Outputs & 1) ? _BV(COM1A1) : 0) | ((Outputs & 2) ? _BV(COM1B1) : 0);
+	TCCR1C = ((Outputs & 1) ? _BV(FOC1A) : 0) | ((Outputs & 2) ? _BV(FOC1B) : 0);
+	OCR1A = First;
+	OCR1B = First;
+	TCNT1 = 0;
+	//TIMSK1 = [   -  |   -  | ICIE1|   -  |   -  |OCIE1B|OCIE1A| TOIE1]
+	TIFR1 = _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TIMSK1 = 0;
+	TCCR1B = CSx3210;
+}
+// COM1x of output Out (0 : OC1A, 1 : OC1B) : set (High) or clear at its next match
+__attribute__((always_inline)) inline void pwm_long_action(const uint8_t Out, const bool High)
+{
+	const uint8_t Shift = Out ? COM1B0 : COM1A0;
+	TCCR1A = (TCCR1A & ~(3 << Shift)) | ((2 + High) << Shift);
+}
+
 // HACK : I think OCR2A only toggles if OCR2A = TOP (255)
 void softPWM_OCR2A()
 {
@@ -60,53 +310,112 @@ void softPWM_OCR2A()
 	OCR2A_state = !OCR2A_state;
 }
 
-void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const uint16_t DutyCycle_Divisor, const bool invertOut)
+PWM_Result PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const PWM_Duty Duty, const bool invertOut, const bool dither, const PWM_Mode Mode)
 {
-	uint16_t CSx3210 = 0;
-	uint32_t FrequencyCount = base_clock / FrequencyHz;
-	uint32_t PeriodRegister = 0;
-	uint32_t PulseWidthRegister = 0;
-
-	// COMx[10]   = [10] non-inverting ,[11] inverting mode
-	const uint8_t COMx10 = 2 + invertOut;
-
-	// Extended set of prescalar values
-	//                   0 1 2 3 4  5  6  7  8   9   10  11   12   13   14    15
-	uint16_t _PS[16] = { 0,1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384 };
-	// Index of the regular set of prescalar values
-	uint8_t N[6] = { 0,1,4,7,9,11 }; // _PS = { 0,1,8,64,256,1024 };
+	const PWM_Mode WaveformMode = pwm_mode(Timer, Mode);
 
-	// find the right prescalar
-	switch (Timer)
-	{
-	case 1:
-		// 16b timer, regular prescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFFFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS[Timer] = _PS[N[CSx3210]];
-		break;
-	default:
-		// 8b timer, regular rescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS[Timer] = _PS[N[CSx3210]];
-		break;
-	}
-	PS_IDX[Timer] = CSx3210;
+	// find the prescalar and PeriodRegister closest to FrequencyHz
+	// dither : the largest PeriodRegister below it, the overflow ISR adds the fraction
+	const PWM_Result Result = (dither & pwm_dither_timer(Timer)) ? solve_dither(Timer, FrequencyHz, WaveformMode) : solve(Timer, FrequencyHz, WaveformMode);
+	PS_IDX[Timer] = Result.CSx3210;
+	PS[Timer] = Result.Prescalar;
 
-	// frequency = f_clk/(PS * (1 + PeriodRegister)); 
-	PeriodRegister = (FrequencyCount / PS[Timer]) - 1;
-	PulseWidthRegister = PeriodRegister / DutyCycle_Divisor;
+	pwm_set_period(Timer, Result.PeriodRegister, WaveformMode != PWM_FAST);
+	const uint16_t PulseWidthRegister = pwm_pulse_width(Timer, Duty);
 	
 	#if (_DEBUG > 0)
 	Serial.print(F("Timer "));
 	Serial.println(Timer);
 	Serial.print(F("PeriodRegister = "));
-	Serial.println(PeriodRegister);
+	Serial.println(Result.PeriodRegister);
 	Serial.print(F("PulseWidthRegister = "));
 	Serial.println(PulseWidthRegister);
 	#endif
 
+	set_output(Timer, ABCD_out, Result.PeriodRegister, PulseWidthRegister, invertOut, WaveformMode);
+	set_dither(Timer, Result.PeriodRegister, Result.PeriodFraction);
+	return Result;
+}
+
+void PWM::set_dither(const uint8_t Timer, const uint16_t PeriodRegister, const uint16_t PeriodFraction)
+{
+	if (!pwm_dither_timer(Timer))
+	{
+		return;
+	}
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dither[Timer].top = PeriodRegister;
+	pwm_dither[Timer].frac = PeriodFraction;
+	pwm_dither[Timer].acc = 0;
+#if !defined(PWM_DITHER_FAST)
+	// install (or remove) the ditherer as the overflow callback
+	switch (Timer)
+	{
+	case 1:
+		if (PeriodFraction) { pwm_interrupt1 = pwm_dither1; }
+		else if (pwm_interrupt1 == pwm_dither1) { pwm_interrupt1 = pwm_empty_interrupt; }
+		break;
+	}
+#endif
+	SREG = sreg;
+
+	if (PeriodFraction)
+	{
+		enableInterrupt(Timer);
+	}
+}
+
+bool PWM::commit(const uint8_t Timer)
+{
+	PWM_Stage &s = pwm_staged[Timer];
+	if (pwm_commit[Timer].Phase != PWM_COMMIT_IDLE)
+	{
+		return false;
+	}
+	if (s.Mask & PWM_STAGE_TOP)
+	{
+		pwm_period_register[Timer] = s.Top;
+	}
+
+	const uint8_t sreg = SREG;
+	cli();
+	switch (Timer)
+	{
+	case 0:
+		// the overflow ISR is used by millis(), OCR0A (TOP) and OCR0B are double buffered
+		pwm_commit_now(0, OCR0A, (volatile uint8_t *)0, &OCR0B, (volatile uint8_t *)0, false);
+		break;
+	case 1:
+	#if defined(PWM_DITHER_FAST)
+		// OCR1x are double buffered, the overflow ISR writes ICR1 from pwm_dither
+		pwm_commit_now(1, ICR1, &OCR1A, &OCR1B, (volatile uint16_t *)0, true);
+		if (s.Mask & PWM_STAGE_TOP) { pwm_commit_enable(TIMSK1, TOIE1, TIFR1, TOV1); }
+	#else
+		if (s.Mask) { pwm_commit_arm(1, pwm_interrupt1, pwm_commit1); pwm_commit_enable(TIMSK1, TOIE1, TIFR1, TOV1); }
+	#endif
+		break;
+	case 2:
+		if (s.Mask) { pwm_commit_arm(2, pwm_interrupt2, pwm_commit2); pwm_commit_enable(TIMSK2, TOIE2, TIFR2, TOV2); }
+		break;
+	}
+	SREG = sreg;
+
+	s.Mask = 0;
+	return true;
+}
+
+void PWM::set_output(const uint8_t Timer, const char ABCD_out, const uint16_t PeriodRegister, const uint16_t PulseWidthRegister, const bool invertOut, const PWM_Mode Mode)
+{
+	// COMx[10]   = [10] non-inverting ,[11] inverting mode
+	const uint8_t COMx10 = 2 + invertOut;
+
 	// WGMx[210]  =  [111] Fast PWM, OCRxA as top
+	//               [101] Phase correct PWM, OCRxA as top
 	// WGMx[3210] = [1110] Fast PWM,  ICRx as top
+	//              [1010] Phase correct PWM, ICRx as top
+	//              [1000] Phase and frequency correct PWM, ICRx as top
 	// WGMx[3210] = [1111] Fast PWM, OCRxA as top (Timer4 - OCR4C)
 
 	switch (Timer)
@@ -138,14 +447,14 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM
+		// Set the waveform mode, OCR0A as TOP : 111 Fast PWM, 101 Phase correct PWM
 		//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
 		//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
 		// clear the old bits
 		TCCR0A &= ~_BV(WGM01) & ~_BV(WGM00);
 		TCCR0B &= ~_BV(WGM02);
 		// set the new bits
-		TCCR0A |= _BV(WGM01) | _BV(WGM00);
+		TCCR0A |= (Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00);
 		TCCR0B |= _BV(WGM02);
 		break;
 	case 1:
@@ -176,15 +485,15 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM, ICR1 as TOP : 1110
+		// Set the waveform mode, ICR1 as TOP : 1110 Fast PWM, 1010 Phase correct, 1000 Phase and frequency correct
 		//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|   -  |   -  | WGM11| WGM10]
 		//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
 		// clear the old bits
 		TCCR1A &= ~_BV(WGM11) & ~_BV(WGM10);
 		TCCR1B &= ~_BV(WGM13) & ~_BV(WGM12);
 		// set the new bits
-		TCCR1A |= _BV(WGM11);
-		TCCR1B |= _BV(WGM13) | _BV(WGM12);
+		TCCR1A |= (Mode == PWM_PHASE_FREQUENCY_CORRECT) ? 0 : _BV(WGM11);
+		TCCR1B |= (Mode == PWM_FAST) ? (_BV(WGM13) | _BV(WGM12)) : _BV(WGM13);
 		break;
 	case 2:
 		// set the period register
@@ -213,19 +522,64 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM, OCR2A as TOP : 111
+		// Set the waveform mode, OCR2A as TOP : 111 Fast PWM, 101 Phase correct PWM
 		//TCCR2A = [COM2A1|COM2A0|COM2B1|COM2B0|   -  |   -  | WGM21| WGM20]
 		//TCCR2B = [ FOC2A| FOC2B|   -  |   -  | WGM22|  CS22|  CS21|  CS20]
 		// clear the old bits
 		TCCR2A &= ~_BV(WGM21) & ~_BV(WGM20);
 		TCCR2B &= ~_BV(WGM22);
 		// set the new bits
-		TCCR2A |= _BV(WGM21) | _BV(WGM20);
+		TCCR2A |= (Mode == PWM_FAST) ? (_BV(WGM21) | _BV(WGM20)) : _BV(WGM20);
 		TCCR2B |= _BV(WGM22);
 		break;
 	}
 }
 
+void PWM::apply(const PWM_Config &Config, const bool Atomic)
+{
+	const uint8_t Timer = Config.Timer;
+	PS_IDX[Timer] = Config.CSx3210;
+	PS[Timer] = 1 << pwm_prescaler_log2(Timer, Config.CSx3210);
+	pwm_set_period(Timer, Config.Top, Config.DualSlope);
+	set_dither(Timer, Config.Top, 0);
+	for (uint8_t Out = 0; Out < 2; ++Out)
+	{
+		if (Config.Outputs & _BV(Out)) { pinMode(pwm_output_pin(Timer, Out), OUTPUT); }
+	}
+
+	const uint8_t sreg = SREG;
+	if (Atomic) { cli(); }
+	switch (Timer)
+	{
+	case 0:
+		OCR0A = Config.Top;
+		OCR0B = Config.Compare[1];
+		TCCR0A = Config.Control[0];
+		TCCR0B = Config.Control[1];
+		break;
+	case 1:
+		ICR1 = Config.Top;
+		OCR1A = Config.Compare[0];
+		OCR1B = Config.Compare[1];
+		TCCR1A = Config.Control[0];
+		TCCR1B = Config.Control[1];
+		break;
+	case 2:
+		OCR2A = Config.Top;
+		OCR2B = Config.Compare[1];
+		TCCR2A = Config.Control[0];
+		TCCR2B = Config.Control[1];
+		break;
+	}
+	if (Atomic) { SREG = sreg; }
+}
+
+// no PLL : every timer counts the CPU clock
+uint32_t PWM::setClock(const uint8_t Timer, const PWM_Clock Source)
+{
+	return ((Source == PWM_CLOCK_CPU) & (pwm_timer_max(Timer) != 0)) ? timer_clock[Timer] : 0;
+}
+
 void PWM::start(const int8_t Timer)
 {
 	// stop the Timer before setting the new prescalar value
@@ -256,6 +610,27 @@ void PWM::start(const int8_t Timer)
 	}
 }
 
+void PWM::startSync(const uint16_t *Phase)
+{
+	stop();
+	enableInterrupt();
+
+	const uint8_t sreg = SREG;
+	cli();
+	//GTCCR  = [   TSM|   -  |   -  |   -  |   -  |   -  |PSRASY|PSRSYNC]
+	// halt and reset the prescalers of Timer0/1 (PSRSYNC) and Timer2 (PSRASY)
+	GTCCR |= _BV(TSM) | _BV(PSRASY) | _BV(PSRSYNC);
+	TCNT0 = Phase ? Phase[0] : 0;
+	TCNT1 = Phase ? Phase[1] : 0;
+	TCNT2 = Phase ? Phase[2] : 0;
+	TCCR0B |= PS_IDX[0];
+	TCCR1B |= PS_IDX[1];
+	TCCR2B |= PS_IDX[2];
+	// release : every timer counts from the same prescaler edge
+	GTCCR &= ~_BV(TSM);
+	SREG = sreg;
+}
+
 void PWM::stop(const int8_t Timer)
 {
 	// Set the PWM prescalar to zero (stops the timer)
@@ -351,6 +726,20 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = isr;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = isr;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -363,6 +752,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt1b = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t1)
+					{
+						pwm_decimation[1].Callback = isr;
+						isr = pwm_decimated1;
+					}
+#endif
 					pwm_interrupt1 = isr;
 			}
 			break;
@@ -378,6 +775,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt2b = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t2)
+					{
+						pwm_decimation[2].Callback = isr;
+						isr = pwm_decimated2;
+					}
+#endif
 					pwm_interrupt2 = isr;
 			}
 			break;
@@ -391,6 +796,20 @@ void PWM::detachInterrupt(const uint8_t &Timer, const char &ABCD_out)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = pwm_empty_interrupt;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = pwm_empty_interrupt;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -4,14 +4,14 @@
 //+------------+---+--------+--------+--------+--------+--------+
 //| Chip       |   | Timer0 | Timer1 | Timer2 | Timer3 | Timer4 |
 //+------------+---+--------+--------+--------+--------+--------+
-//|            |   | 8b PS  | 8b PS  |   --   | 16b PS | 8b ePS |
+//|            |   | 8b PS  | 16b PS |   --   | 16b PS |10b ePS |
 //|            +---+--------+--------+--------+--------+--------+
 //| ATmega32u4 | A |  D11   |   D9   |   --   |   D5   |  D13   |
 //|            | B |   D3   |  D10   |   --   |   --   |  D10   |
 //|            | C |   --   |  D11   |   --   |   --   |   --   |
 //|            | D |   --   |   --   |   --   |   --   |   D6   |
 //+------------+---+--------+--------+--------+--------+--------+
-// 8b/16b : 8 bit or 16 bit timer
+// 8b/10b/16b : 8, 10 or 16 bit timer
 // PS/ePS : Regular prescalar, Extended prescalar selection
 //  PS = [0,1,8,64,256,1024]
 // ePS = [0,1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384]
@@ -20,8 +20,8 @@
 // 
 
 //void(*pwm_interrupt0)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
 
 void(*pwm_interrupt1)() = &pwm_empty_interrupt;
 void(*pwm_interrupt1a)() = &pwm_empty_interrupt;
@@ -38,26 +38,150 @@ void(*pwm_interrupt4a)() = &pwm_empty_interrupt;
 void(*pwm_interrupt4b)() = &pwm_empty_interrupt;
 void(*pwm_interrupt4d)() = &pwm_empty_interrupt;
 
+// period dither, installed as the overflow callback by set_dither (see PWM_Dither.h)
+void pwm_dither1() { pwm_dither_step(pwm_dither[1], ICR1); }
+void pwm_dither3() { pwm_dither_step(pwm_dither[3], ICR3); }
+void pwm_dither4() { auto Top = pwm_register10(OCR4C); pwm_dither_step(pwm_dither[4], Top); }
+
+// staged update, installed as the overflow callback by commit (see PWM_Commit.h)
+void pwm_commit1() { pwm_commit_step(1, TCNT1, ICR1, &OCR1A, &OCR1B, &OCR1C, false, &TCCR1B, _BV(CS12) | _BV(CS11) | _BV(CS10), pwm_interrupt1, TIMSK1, TOIE1); }
+void pwm_commit3() { pwm_commit_step(3, TCNT3, ICR3, &OCR3A, &OCR3B, &OCR3C, false, &TCCR3B, _BV(CS32) | _BV(CS31) | _BV(CS30), pwm_interrupt3, TIMSK3, TOIE3); }
+void pwm_commit4()
+{
+	auto Counter = pwm_register10(TCNT4), Top = pwm_register10(OCR4C);
+	auto A = pwm_register10(OCR4A), B = pwm_register10(OCR4B), D = pwm_register10(OCR4D);
+	pwm_commit_step(4, Counter, Top, &A, &B, &D, true, (volatile uint8_t *)0, 0, pwm_interrupt4, TIMSK4, TOIE4);
+}
+
+#if defined(PWM_DECIMATE)
+// down counter in front of the attached overflow callback (see PWM_Decimate.h)
+void pwm_decimated1() { pwm_decimate_step(1); }
+void pwm_decimated3() { pwm_decimate_step(3); }
+void pwm_decimated4() { pwm_decimate_step(4); }
+#endif
+
+// subscriber tables, installed as the callback of a vector by subscribe() (see PWM_Subscribe.h)
+enum { PWM_VECTOR_T0A = 0, PWM_VECTOR_T0B, PWM_VECTOR_T1, PWM_VECTOR_T1A, PWM_VECTOR_T1B, PWM_VECTOR_T1C, PWM_VECTOR_T3, PWM_VECTOR_T3A, PWM_VECTOR_T3B, PWM_VECTOR_T3C, PWM_VECTOR_T4, PWM_VECTOR_T4A, PWM_VECTOR_T4B, PWM_VECTOR_T4D, PWM_VECTORS };
+PWM_Subscribers pwm_subscribers[PWM_VECTORS];
+void pwm_subscribers_t0a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0A]); }
+void pwm_subscribers_t0b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0B]); }
+void pwm_subscribers_t1() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1]); }
+void pwm_subscribers_t1a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1A]); }
+void pwm_subscribers_t1b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1B]); }
+void pwm_subscribers_t1c() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1C]); }
+void pwm_subscribers_t3() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T3]); }
+void pwm_subscribers_t3a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T3A]); }
+void pwm_subscribers_t3b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T3B]); }
+void pwm_subscribers_t3c() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T3C]); }
+void pwm_subscribers_t4() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T4]); }
+void pwm_subscribers_t4a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T4A]); }
+void pwm_subscribers_t4b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T4B]); }
+void pwm_subscribers_t4d() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T4D]); }
+void(*const pwm_subscribers_isr[PWM_VECTORS])() = {
+	pwm_subscribers_t0a, pwm_subscribers_t0b, pwm_subscribers_t1, pwm_subscribers_t1a, pwm_subscribers_t1b, pwm_subscribers_t1c, pwm_subscribers_t3, pwm_subscribers_t3a, pwm_subscribers_t3b, pwm_subscribers_t3c, pwm_subscribers_t4, pwm_subscribers_t4a, pwm_subscribers_t4b, pwm_subscribers_t4d };
+
+// table of the overflow (any ABCD_out but an output) or of an output of Timer, PWM_VECTORS if none
+constexpr uint8_t pwm_vector(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & ((uint8_t)(pwm_vector_slot(ABCD_out) - 1) < 2)) ? PWM_VECTOR_T0A + pwm_vector_slot(ABCD_out) - 1 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) <= 3)) ? PWM_VECTOR_T1 + pwm_vector_slot(ABCD_out) :
+		((Timer == 3) & (pwm_vector_slot(ABCD_out) <= 3)) ? PWM_VECTOR_T3 + pwm_vector_slot(ABCD_out) :
+		((Timer == 4) & (pwm_vector_slot(ABCD_out) <= 3)) ? PWM_VECTOR_T4 + pwm_vector_slot(ABCD_out) : PWM_VECTORS;
+}
+
+// the overflow flag of Timer is set : a period started since its overflow ISR was entered
+inline bool pwm_overflow_pending(const uint8_t Timer)
+{
+	switch (Timer)
+	{
+	case 0: return TIFR0 & _BV(TOV0);
+	case 1: return TIFR1 & _BV(TOV1);
+	case 3: return TIFR3 & _BV(TOV3);
+	case 4: return TIFR4 & _BV(TOV4);
+	}
+	return false;
+}
+
+// ADC auto trigger (see PWM_ADC.h)
+#define PWM_ADC_VCC 1 // REFS[10] : AVcc
+
+// ADTS of the overflow (any ABCD_out but an output) or compare ABCD_out of Timer, 0xFF if it cannot
+// trigger the ADC. OCR0A and OCR4C are TOP, not sampling compares
+constexpr uint8_t pwm_adc_trigger(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & (pwm_vector_slot(ABCD_out) == 0)) ? 4 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) == 0)) ? 6 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) == 2)) ? 5 :
+		((Timer == 4) & (pwm_vector_slot(ABCD_out) <= 3)) ? 8 + pwm_vector_slot(ABCD_out) : 0xFF;
+}
+
+// conversions of Channel (MUX[5..0]) against Reference (REFS[10]), started by the trigger ADTS, ADC
+// clock F_CPU >> ADPS, with the ADC interrupt
+inline void pwm_adc_setup(const uint8_t ADTS, const uint8_t Channel, const uint8_t Reference, const uint8_t ADPS)
+{
+	//ADMUX  = [ REFS1| REFS0| ADLAR|  MUX4|  MUX3|  MUX2|  MUX1|  MUX0]
+	ADMUX = (Reference << REFS0) | (Channel & 0x1F);
+	//ADCSRB = [ ADHSM|  ACME|  MUX5|   -  | ADTS3| ADTS2| ADTS1| ADTS0]
+	ADCSRB = (ADCSRB & (_BV(ADHSM) | _BV(ACME))) | ((Channel & 0x20) ? _BV(MUX5) : 0) | ADTS;
+	//ADCSRA = [  ADEN|  ADSC| ADATE|  ADIF|  ADIE| ADPS2| ADPS1| ADPS0]
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | ADPS;
+}
+
+// clear the flag of the trigger ADTS if no ISR does : the next event must be a rising edge
+inline void pwm_adc_rearm(const uint8_t ADTS)
+{
+	switch (ADTS)
+	{
+	case 4: if (!(TIMSK0 & _BV(TOIE0))) { TIFR0 = _BV(TOV0); } break;
+	case 5: if (!(TIMSK1 & _BV(OCIE1B))) { TIFR1 = _BV(OCF1B); } break;
+	case 6: if (!(TIMSK1 & _BV(TOIE1))) { TIFR1 = _BV(TOV1); } break;
+	case 8: if (!(TIMSK4 & _BV(TOIE4))) { TIFR4 = _BV(TOV4); } break;
+	case 9: if (!(TIMSK4 & _BV(OCIE4A))) { TIFR4 = _BV(OCF4A); } break;
+	case 10: if (!(TIMSK4 & _BV(OCIE4B))) { TIFR4 = _BV(OCF4B); } break;
+	case 11: if (!(TIMSK4 & _BV(OCIE4D))) { TIFR4 = _BV(OCF4D); } break;
+	}
+}
+
+// ISR profiler slots (see PWM_Profile.h)
+#if defined(PWM_PROFILE)
+enum { PWM_PROFILE_T1 = 0, PWM_PROFILE_T1A, PWM_PROFILE_T1B, PWM_PROFILE_T1C, PWM_PROFILE_T3, PWM_PROFILE_T3A, PWM_PROFILE_T3B, PWM_PROFILE_T3C, PWM_PROFILE_T4, PWM_PROFILE_T4A, PWM_PROFILE_T4B, PWM_PROFILE_T4D, PWM_PROFILE_T0A, PWM_PROFILE_T0B, PWM_PROFILE_USER };
+static_assert(PWM_PROFILE_USER <= PWM_PROFILE_SLOTS, "PWM_PROFILE_SLOTS : one per vector at least");
+#endif
+
 #ifndef PWM_NOISR
 //TIMER0_OVF_vect is already defined in wiring.h (used by millis())
 //ISR(TIMER0_OVF_vect) { interrupt0(); }
-//ISR(TIMER0_COMPA_vect) { pwm_interrupt0a(); }
-//ISR(TIMER0_COMPB_vect) { pwm_interrupt0b(); }
-
-ISR(TIMER1_OVF_vect) { pwm_interrupt1(); }
-ISR(TIMER1_COMPA_vect) { pwm_interrupt1a(); }
-ISR(TIMER1_COMPB_vect) { pwm_interrupt1b(); }
-ISR(TIMER1_COMPC_vect) { pwm_interrupt1c(); }
-
-ISR(TIMER3_OVF_vect) { pwm_interrupt3(); }
-ISR(TIMER3_COMPA_vect) { pwm_interrupt3a(); }
-ISR(TIMER3_COMPB_vect) { pwm_interrupt3a(); }
-ISR(TIMER3_COMPC_vect) { pwm_interrupt3a(); }
-
-ISR(TIMER4_OVF_vect) { pwm_interrupt4(); }
-ISR(TIMER4_COMPA_vect) { pwm_interrupt4a(); }
-ISR(TIMER4_COMPB_vect) { pwm_interrupt4b(); }
-ISR(TIMER4_COMPD_vect) { pwm_interrupt4d(); }
+
+#if defined(PWM_DITHER_FAST)
+PWM_DITHER_ISR16(TIMER1_OVF_vect, 1, ICR1)
+PWM_DITHER_ISR16(TIMER3_OVF_vect, 3, ICR3)
+PWM_DITHER_ISR10(TIMER4_OVF_vect, 4, OCR4C, TC4H)
+#elif defined(PWM_DECIMATE) & !defined(PWM_PROFILE) & !defined(PWM_ISR_STATIC)
+PWM_DECIMATE_ISR(TIMER1_OVF_vect, 1)
+PWM_DECIMATE_ISR(TIMER3_OVF_vect, 3)
+PWM_DECIMATE_ISR(TIMER4_OVF_vect, 4)
+#elif !defined(PWM_ISR_STATIC)
+PWM_ISR_PROFILED(TIMER1_OVF_vect, pwm_interrupt1, PWM_PROFILE_T1, TCNT1, pwm_profile_top(1), pwm_profile_top(1))
+PWM_ISR_PROFILED(TIMER3_OVF_vect, pwm_interrupt3, PWM_PROFILE_T3, TCNT3, pwm_profile_top(3), pwm_profile_top(3))
+PWM_ISR_PROFILED(TIMER4_OVF_vect, pwm_interrupt4, PWM_PROFILE_T4, pwm_read10(TCNT4), pwm_profile_top(4), pwm_profile_top(4))
+#endif
+
+#ifndef PWM_ISR_STATIC
+PWM_ISR_PROFILED(TIMER0_COMPA_vect, pwm_interrupt0a, PWM_PROFILE_T0A, TCNT0, OCR0A, pwm_profile_top(0))
+PWM_ISR_PROFILED(TIMER0_COMPB_vect, pwm_interrupt0b, PWM_PROFILE_T0B, TCNT0, OCR0B, pwm_profile_top(0))
+
+PWM_ISR_PROFILED(TIMER1_COMPA_vect, pwm_interrupt1a, PWM_PROFILE_T1A, TCNT1, OCR1A, pwm_profile_top(1))
+PWM_ISR_PROFILED(TIMER1_COMPB_vect, pwm_interrupt1b, PWM_PROFILE_T1B, TCNT1, OCR1B, pwm_profile_top(1))
+PWM_ISR_PROFILED(TIMER1_COMPC_vect, pwm_interrupt1c, PWM_PROFILE_T1C, TCNT1, OCR1C, pwm_profile_top(1))
+
+PWM_ISR_PROFILED(TIMER3_COMPA_vect, pwm_interrupt3a, PWM_PROFILE_T3A, TCNT3, OCR3A, pwm_profile_top(3))
+PWM_ISR_PROFILED(TIMER3_COMPB_vect, pwm_interrupt3b, PWM_PROFILE_T3B, TCNT3, OCR3B, pwm_profile_top(3))
+PWM_ISR_PROFILED(TIMER3_COMPC_vect, pwm_interrupt3c, PWM_PROFILE_T3C, TCNT3, OCR3C, pwm_profile_top(3))
+
+PWM_ISR_PROFILED(TIMER4_COMPA_vect, pwm_interrupt4a, PWM_PROFILE_T4A, pwm_read10(TCNT4), pwm_read10(OCR4A), pwm_profile_top(4))
+PWM_ISR_PROFILED(TIMER4_COMPB_vect, pwm_interrupt4b, PWM_PROFILE_T4B, pwm_read10(TCNT4), pwm_read10(OCR4B), pwm_profile_top(4))
+PWM_ISR_PROFILED(TIMER4_COMPD_vect, pwm_interrupt4d, PWM_PROFILE_T4D, pwm_read10(TCNT4), pwm_read10(OCR4D), pwm_profile_top(4))
+#endif
 #endif
 
 #define OCR0A_pin 11
@@ -69,55 +193,371 @@ ISR(TIMER4_COMPD_vect) { pwm_interrupt4d(); }
 #define OCR4A_pin 13
 #define OCR4B_pin 10
 #define OCR4D_pin 6
+// complementary outputs of Timer4 (!OC4x, see PWM::setComplementary)
+#define OCR4A_n_pin 5
+#define OCR4B_n_pin 9
+#define OCR4D_n_pin 12
+
+// Timer description, used by the frequency solver (PWM::solve)
+// log2 of the prescalar selected by CSx[3210] : regular list (Timer0/1/3), extended list (Timer4)
+//                                         1 8 64 256 1024
+constexpr uint8_t pwm_PS_regular_log2[8] = { 0,0,3,6, 8, 10,0,0 };
 
-void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const uint16_t DutyCycle_Divisor, const bool invertOut)
+// TOP limit of the timer (0 : no such timer)
+constexpr uint16_t pwm_timer_max(const uint8_t Timer)
 {
-	uint16_t CSx3210 = 0;
-	uint32_t FrequencyCount = base_clock / FrequencyHz;
-	uint32_t PeriodRegister = 0;
-	uint32_t PulseWidthRegister = 0;
+	return ((Timer == 1) | (Timer == 3)) ? 0xFFFF : ((Timer == 4) ? 0x3FF : ((Timer == 0) ? 0xFF : 0));
+}
+// largest CSx[3210] that selects an internal prescalar
+constexpr uint8_t pwm_cs_max(const uint8_t Timer)
+{
+	return (Timer == 4) ? 15 : 5;
+}
+// waveform mode of a timer for Mode : Timer0 has no phase and frequency correct mode,
+// Timer4 only has phase and frequency correct (WGM4[10] = 01)
+constexpr PWM_Mode pwm_mode(const uint8_t Timer, const PWM_Mode Mode)
+{
+	return ((Mode == PWM_FAST) | (Timer == 1) | (Timer == 3)) ? Mode : ((Timer == 4) ? PWM_PHASE_FREQUENCY_CORRECT : PWM_PHASE_CORRECT);
+}
+// timer with a period ditherer on its overflow ISR
+constexpr bool pwm_dither_timer(const uint8_t Timer)
+{
+	return (Timer == 1) | (Timer == 3) | (Timer == 4);
+}
+// TOP register double buffered in the PWM modes (OCR0A, OCR4C), ICR1 and ICR3 are not
+constexpr bool pwm_top_buffered(const uint8_t Timer)
+{
+	return (Timer != 1) & (Timer != 3);
+}
+constexpr uint8_t pwm_prescaler_log2(const uint8_t Timer, const uint8_t CSx3210)
+{
+	return (Timer == 4) ? (CSx3210 - 1) : pwm_PS_regular_log2[CSx3210];
+}
 
-	// COMx[10]   = [10] non-inverting ,[11] inverting mode
-	const uint8_t COMx10 = 2 + invertOut;
+// Register image (PWM_Config) : Control = TCCRxA, TCCRxB (Timer0/1/3), TCCR4A, TCCR4B, TCCR4C, TCCR4D (Timer4)
+// Arduino pin of output 'a' + Out
+constexpr uint8_t pwm_output_pin(const uint8_t Timer, const uint8_t Out)
+{
+	return (Timer == 0) ? ((Out == 0) ? OCR0A_pin : ((Out == 1) ? OCR0B_pin : PWM_NO_PIN)) :
+		((Timer == 1) ? ((Out == 0) ? OCR1A_pin : ((Out == 1) ? OCR1B_pin : ((Out == 2) ? OCR1C_pin : PWM_NO_PIN))) :
+		((Timer == 3) ? ((Out == 0) ? OCR3A_pin : PWM_NO_PIN) :
+		((Timer == 4) ? ((Out == 0) ? OCR4A_pin : ((Out == 1) ? OCR4B_pin : ((Out == 3) ? OCR4D_pin : PWM_NO_PIN))) : PWM_NO_PIN)));
+}
+//TCCRxA = [COMxA1|COMxA0|COMxB1|COMxB0|COMxC1|COMxC0| WGMx1| WGMx0]
+//TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A| FOC4B| PWM4A| PWM4B]
+//TCCR4C = [COM4A1S|COM4A0S|COM4B1S|COM4B0S|COM4D1|COM4D0| FOC4D| PWM4D]
+constexpr uint8_t pwm_config_out_mask(const uint8_t Timer, const uint8_t Out, const uint8_t Reg)
+{
+	return (pwm_output_pin(Timer, Out) == PWM_NO_PIN) ? 0 :
+		((Timer != 4) ? ((Reg != 0) ? 0 : (0xC0 >> (2 * Out))) :
+		((Reg == 0) ? ((Out == 0) ? (_BV(COM4A1) | _BV(COM4A0) | _BV(PWM4A)) : ((Out == 1) ? (_BV(COM4B1) | _BV(COM4B0) | _BV(PWM4B)) : 0)) :
+		(((Reg == 2) & (Out == 3)) ? (_BV(COM4D1) | _BV(COM4D0) | _BV(PWM4D)) : 0)));
+}
+// OCR0A is TOP : toggled (COM0A = 01)
+constexpr uint8_t pwm_config_out_bits(const uint8_t Timer, const uint8_t Out, const uint8_t Reg, const bool invertOut)
+{
+	return (pwm_config_out_mask(Timer, Out, Reg) == 0) ? 0 :
+		(((Timer == 0) & (Out == 0)) ? _BV(COM0A0) :
+		((Timer != 4) ? ((2 + invertOut) << (6 - 2 * Out)) :
+		((Out == 0) ? (((2 + invertOut) << 6) | _BV(PWM4A)) :
+		((Out == 1) ? (((2 + invertOut) << 4) | _BV(PWM4B)) : (((2 + invertOut) << 2) | _BV(PWM4D))))));
+}
+// same modes as set_output
+//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
+//TCCRxB = [ ICNCx| ICESx|   -  | WGMx3| WGMx2|  CSx2|  CSx1|  CSx0]
+//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
+//TCCR4D = [  FPIE4|  FPEN4|  FPNC4|  FPES4| FPAC4|  FPF4| WGM41| WGM40]
+constexpr uint8_t pwm_config_mode_bits(const uint8_t Timer, const PWM_Mode Mode, const uint8_t CSx3210, const uint8_t Reg)
+{
+	return (Timer == 4) ? ((Reg == 1) ? CSx3210 : (((Reg == 3) & (Mode != PWM_FAST)) ? _BV(WGM40) : 0)) :
+		((Reg == 0) ?
+			((Timer == 0) ? ((Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00)) : ((Mode == PWM_PHASE_FREQUENCY_CORRECT) ? 0 : _BV(WGM11))) :
+		((Reg == 1) ?
+			(((Timer == 0) ? _BV(WGM02) : ((Mode == PWM_FAST) ? (_BV(WGM13) | _BV(WGM12)) : _BV(WGM13))) | CSx3210) : 0));
+}
+
+// Timer4 dead time : DT4H counts delay the rising edge of OC4x, DT4L counts the one of !OC4x, a count
+// is 2^DTPS4[10] cycles of the Timer4 clock (before its prescalar). Rounded up : at least the time asked,
+// at most 15 counts of CK / 8 (7.5us at 16MHz)
+constexpr uint16_t pwm_dead_ticks(const uint32_t BaseClock, const uint16_t Ns)
+{
+	return ((uint32_t)Ns * (BaseClock / 10000) + 99999) / 100000;
+}
+constexpr uint8_t pwm_dead_count(const uint16_t Ticks, const uint8_t DTPS)
+{
+	return (((Ticks + _BV(DTPS) - 1) >> DTPS) > 15) ? 15 : ((Ticks + _BV(DTPS) - 1) >> DTPS);
+}
+// smallest DTPS4[10] that holds Ticks in 4 bits (3 if none does)
+constexpr uint8_t pwm_dead_prescaler(const uint16_t Ticks, const uint8_t DTPS = 0)
+{
+	return ((((Ticks + _BV(DTPS) - 1) >> DTPS) <= 15) | (DTPS == 3)) ? DTPS : pwm_dead_prescaler(Ticks, DTPS + 1);
+}
+constexpr uint16_t pwm_dead_time_(const uint16_t RisingTicks, const uint16_t FallingTicks, const uint8_t DTPS)
+{
+	return ((uint16_t)DTPS << 8) | (pwm_dead_count(RisingTicks, DTPS) << 4) | pwm_dead_count(FallingTicks, DTPS);
+}
+// (DTPS4[10] << 8) | DT4
+constexpr uint16_t pwm_dead_time(const uint32_t BaseClock, const uint16_t RisingNs, const uint16_t FallingNs)
+{
+	return pwm_dead_time_(pwm_dead_ticks(BaseClock, RisingNs), pwm_dead_ticks(BaseClock, FallingNs),
+		pwm_dead_prescaler((pwm_dead_ticks(BaseClock, RisingNs) > pwm_dead_ticks(BaseClock, FallingNs)) ? pwm_dead_ticks(BaseClock, RisingNs) : pwm_dead_ticks(BaseClock, FallingNs)));
+}
+constexpr bool pwm_dead_time_fits(const uint32_t BaseClock, const uint16_t RisingNs, const uint16_t FallingNs)
+{
+	return (pwm_dead_ticks(BaseClock, RisingNs) <= 15 * 8) & (pwm_dead_ticks(BaseClock, FallingNs) <= 15 * 8);
+}
+
+// Software PWM timebase (see PWM_Soft.h) : Timer1 in CTC mode, the OCR1A (TOP) match starts
+// the period, OCR1B steps through the edges
+#define PWM_SOFT_TIMER 1
+#define PWM_SOFT_TCNT TCNT1
+#define PWM_SOFT_EDGE_OCR OCR1B
+#define PWM_SOFT_TIMSK TIMSK1
+#define PWM_SOFT_EDGE_IE OCIE1B
+#define PWM_SOFT_TIFR TIFR1
+#define PWM_SOFT_EDGE_IF OCF1B
+#define pwm_soft_period_interrupt pwm_interrupt1a
+#define pwm_soft_edge_interrupt pwm_interrupt1b
+
+inline void pwm_soft_timebase(const uint16_t PeriodRegister, const uint8_t CSx3210)
+{
+	//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|COM1C1|COM1C0| WGM11| WGM10]
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	// stopped, compare outputs disconnected, WGM1[3210] = 0100 CTC with OCR1A as TOP
+	TCCR1B = 0;
+	TCCR1A = 0;
+	OCR1A = PeriodRegister;
+	TCNT1 = 0;
+	//TIMSK1 = [   -  |   -  | ICIE1|   -  |OCIE1C|OCIE1B|OCIE1A| TOIE1]
+	TIFR1 = _BV(OCF1C) | _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TIMSK1 = _BV(OCIE1A);
+	TCCR1B = _BV(WGM12) | CSx3210;
+}
+
+// Bit angle modulation timebase (see PWM_BAM.h) : Timer1 counts freely (normal mode), each OCR1A
+// match ends a bit-plane slot and moves OCR1A on by the next one, the SPI master shifts the planes out
+#define PWM_BAM_TIMER 1
+#define PWM_BAM_SLOT_OCR OCR1A
+#define pwm_bam_slot_interrupt pwm_interrupt1a
+#define PWM_BAM_MOSI_pin 16
+#define PWM_BAM_SCK_pin 15
+#define PWM_BAM_SS_pin 17
+
+inline void pwm_bam_timebase(const uint16_t FirstMatch, const uint8_t CSx3210)
+{
+	//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|COM1C1|COM1C0| WGM11| WGM10]
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	// stopped, compare outputs disconnected, WGM1[3210] = 0000 normal
+	TCCR1B = 0;
+	TCCR1A = 0;
+	OCR1A = FirstMatch;
+	TCNT1 = 0;
+	//TIMSK1 = [   -  |   -  | ICIE1|   -  |OCIE1C|OCIE1B|OCIE1A| TOIE1]
+	TIFR1 = _BV(OCF1C) | _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TIMSK1 = _BV(OCIE1A);
+	TCCR1B = CSx3210;
+}
+
+// Long period timebase (see PWM_Long.h) : Timer1 counts freely (normal mode), OC1A and OC1B are set or
+// cleared by their match (non PWM), the match ISRs move OCR1x on towards the next edge
+#define PWM_LONG_TIMER 1
+#define PWM_LONG_BITS 16
+
+// Outputs : bit 0 OC1A, bit 1 OC1B, cleared by a forced compare, their first match at First
+inline void pwm_long_timebase(const uint8_t Outputs, const uint16_t First, const uint8_t CSx3210)
+{
+	//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|COM1C1|COM1C0| WGM11| WGM10]
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	//TCCR1C = [ FOC1A| FOC1B| FOC1C|   -  |   -  |   -  |   -  |   -  ]
+	// stopped, WGM1[3210] = 0000 normal, COM1x = 10 clear
+	TCCR1B = 0;
+	TCCR1A = ((Outputs & 1) ? _BV(COM1A1) : 0) | ((Outputs & 2) ? _BV(COM1B1) : 0);
+	TCCR1C = ((Outputs & 1) ? _BV(FOC1A) : 0) | ((Outputs & 2) ? _BV(FOC1B) : 0);
+	OCR1A = First;
+	OCR1B = First;
+	TCNT1 = 0;
+	//TIMSK1 = [   -  |   -  | ICIE1|   -  |OCIE1C|OCIE1B|OCIE1A| TOIE1]
+	TIFR1 = _BV(OCF1C) | _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TIMSK1 = 0;
+	TCCR1B = CSx3210;
+}
+// COM1x of output Out (0 : OC1A, 1 : OC1B) : set (High) or clear at its next match
+__attribute__((always_inline)) inline void pwm_long_action(const uint8_t Out, const bool High)
+{
+	const uint8_t Shift = Out ? COM1B0 : COM1A0;
+	TCCR1A = (TCCR1A & ~(3 << Shift)) | ((2 + High) << Shift);
+}
+
+PWM_Result PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const PWM_Duty Duty, const bool invertOut, const bool dither, const PWM_Mode Mode)
+{
+	const PWM_Mode WaveformMode = pwm_mode(Timer, Mode);
+
+	// find the prescalar and PeriodRegister closest to FrequencyHz
+	// dither : the largest PeriodRegister below it, the overflow ISR adds the fraction
+	const PWM_Result Result = (dither & pwm_dither_timer(Timer)) ? solve_dither(Timer, FrequencyHz, WaveformMode) : solve(Timer, FrequencyHz, WaveformMode);
+	PS_IDX[Timer] = Result.CSx3210;
+	PS[Timer] = Result.Prescalar;
+
+	pwm_set_period(Timer, Result.PeriodRegister, WaveformMode != PWM_FAST);
+	const uint16_t PulseWidthRegister = pwm_pulse_width(Timer, Duty);
+
+	set_output(Timer, ABCD_out, Result.PeriodRegister, PulseWidthRegister, invertOut, WaveformMode);
+	set_dither(Timer, Result.PeriodRegister, Result.PeriodFraction);
+	return Result;
+}
+
+void PWM::set_dither(const uint8_t Timer, const uint16_t PeriodRegister, const uint16_t PeriodFraction)
+{
+	if (!pwm_dither_timer(Timer))
+	{
+		return;
+	}
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dither[Timer].top = PeriodRegister;
+	pwm_dither[Timer].frac = PeriodFraction;
+	pwm_dither[Timer].acc = 0;
+#if !defined(PWM_DITHER_FAST)
+	// install (or remove) the ditherer as the overflow callback
+	switch (Timer)
+	{
+	case 1:
+		if (PeriodFraction) { pwm_interrupt1 = pwm_dither1; }
+		else if (pwm_interrupt1 == pwm_dither1) { pwm_interrupt1 = pwm_empty_interrupt; }
+		break;
+	case 3:
+		if (PeriodFraction) { pwm_interrupt3 = pwm_dither3; }
+		else if (pwm_interrupt3 == pwm_dither3) { pwm_interrupt3 = pwm_empty_interrupt; }
+		break;
+	case 4:
+		if (PeriodFraction) { pwm_interrupt4 = pwm_dither4; }
+		else if (pwm_interrupt4 == pwm_dither4) { pwm_interrupt4 = pwm_empty_interrupt; }
+		break;
+	}
+#endif
+	SREG = sreg;
+
+	if (PeriodFraction)
+	{
+		enableInterrupt(Timer);
+	}
+}
 
-	// Extended set of prescalar values
-	//                   0 1 2 3 4  5  6  7  8   9   10  11   12   13   14    15
-	uint16_t _PS[16] = { 0,1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384 };
-	// Index of the regular set of prescalar values
-	uint8_t N[6] = { 0,1,4,7,9,11 }; // _PS = { 0,1,8,64,256,1024 };
+bool PWM::commit(const uint8_t Timer)
+{
+	PWM_Stage &s = pwm_staged[Timer];
+	if (pwm_commit[Timer].Phase != PWM_COMMIT_IDLE)
+	{
+		return false;
+	}
+	if (s.Mask & PWM_STAGE_TOP)
+	{
+		pwm_period_register[Timer] = s.Top;
+	}
 
-	// find the right prescalar
+	const uint8_t sreg = SREG;
+	cli();
 	switch (Timer)
 	{
 	case 0:
-		// 8b timer, regular rescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS[Timer] = _PS[N[CSx3210]];
+		// the overflow ISR is used by millis(), OCR0A (TOP) and OCR0B are double buffered
+		pwm_commit_now(0, OCR0A, (volatile uint8_t *)0, &OCR0B, (volatile uint8_t *)0, false);
 		break;
+	#if defined(PWM_DITHER_FAST)
+	// OCRx are double buffered, the overflow ISR writes TOP from pwm_dither
 	case 1:
-		// 16b timer, regular prescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFFFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS[Timer] = _PS[N[CSx3210]];
+		pwm_commit_now(1, ICR1, &OCR1A, &OCR1B, &OCR1C, true);
+		if (s.Mask & PWM_STAGE_TOP) { pwm_commit_enable(TIMSK1, TOIE1, TIFR1, TOV1); }
 		break;
 	case 3:
-		// 16b timer, regular prescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFFFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS[Timer] = _PS[N[CSx3210]];
+		pwm_commit_now(3, ICR3, &OCR3A, &OCR3B, &OCR3C, true);
+		if (s.Mask & PWM_STAGE_TOP) { pwm_commit_enable(TIMSK3, TOIE3, TIFR3, TOV3); }
 		break;
 	case 4:
-		// 8b timer, extended prescalar list
-		while ((FrequencyCount > (1 + _PS[CSx3210] * 0xFF)) & (CSx3210 < 15)) { ++CSx3210; }
-		PS[Timer] = _PS[CSx3210];
+	{
+		auto Top = pwm_register10(OCR4C);
+		auto A = pwm_register10(OCR4A), B = pwm_register10(OCR4B), D = pwm_register10(OCR4D);
+		pwm_commit_now(4, Top, &A, &B, &D, true);
+		if (s.Mask & PWM_STAGE_TOP) { pwm_commit_enable(TIMSK4, TOIE4, TIFR4, TOV4); }
 		break;
 	}
-	PS_IDX[Timer] = CSx3210;
+	#else
+	case 1:
+		if (s.Mask) { pwm_commit_arm(1, pwm_interrupt1, pwm_commit1); pwm_commit_enable(TIMSK1, TOIE1, TIFR1, TOV1); }
+		break;
+	case 3:
+		if (s.Mask) { pwm_commit_arm(3, pwm_interrupt3, pwm_commit3); pwm_commit_enable(TIMSK3, TOIE3, TIFR3, TOV3); }
+		break;
+	case 4:
+		if (s.Mask) { pwm_commit_arm(4, pwm_interrupt4, pwm_commit4); pwm_commit_enable(TIMSK4, TOIE4, TIFR4, TOV4); }
+		break;
+	#endif
+	}
+	SREG = sreg;
 
-	// frequency = f_clk/(PS * (1 + PeriodRegister)); 
-	PeriodRegister = (FrequencyCount / PS[Timer]) - 1;
-	PulseWidthRegister = PeriodRegister / DutyCycle_Divisor;
+	s.Mask = 0;
+	return true;
+}
+
+PWM_Result PWM::setComplementary(const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const uint16_t RisingNs, const uint16_t FallingNs, const PWM_Mode Mode)
+{
+	const PWM_Result Result = set(4, ABCD_out, FrequencyHz, Duty, false, false, Mode);
+	set_complementary(ABCD_out, pwm_dead_time(timer_clock[4], RisingNs, FallingNs));
+	return Result;
+}
+
+template <uint16_t RisingNs, uint16_t FallingNs, uint32_t TimerClock>
+PWM_Result PWM::setComplementary(const char ABCD_out, const uint32_t FrequencyHz, const PWM_Duty Duty, const PWM_Mode Mode)
+{
+	static_assert(pwm_dead_time_fits(TimerClock, RisingNs, FallingNs), "dead time above 15 counts of CK / 8");
+	constexpr uint16_t DeadTime = pwm_dead_time(TimerClock, RisingNs, FallingNs);
+	const PWM_Result Result = set(4, ABCD_out, FrequencyHz, Duty, false, false, Mode);
+	set_complementary(ABCD_out, DeadTime);
+	return Result;
+}
+
+void PWM::set_complementary(const char ABCD_out, const uint16_t DeadTime)
+{
+	//TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A| FOC4B| PWM4A| PWM4B]
+	//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
+	//TCCR4C = [COM4A1S|COM4A0S|COM4B1S|COM4B0S|COM4D1|COM4D0| FOC4D| PWM4D]
+	//DT4    = [ DT4H3| DT4H2| DT4H1| DT4H0| DT4L3| DT4L2| DT4L1| DT4L0]
+	// one dead time for the three pairs
+	DT4 = DeadTime;
+	TCCR4B = (TCCR4B & ~(_BV(DTPS41) | _BV(DTPS40))) | ((DeadTime >> 8) << DTPS40);
+
+	// COM4x[10] = [01] : OC4x as in the non-inverting mode, !OC4x its complement
+	switch (ABCD_out)
+	{
+	case 'a':
+	case 'A':
+		pinMode(OCR4A_n_pin, OUTPUT);
+		TCCR4A = (TCCR4A & ~_BV(COM4A1)) | _BV(COM4A0);
+		break;
+	case 'b':
+	case 'B':
+		pinMode(OCR4B_n_pin, OUTPUT);
+		TCCR4A = (TCCR4A & ~_BV(COM4B1)) | _BV(COM4B0);
+		break;
+	case 'd':
+	case 'D':
+		pinMode(OCR4D_n_pin, OUTPUT);
+		TCCR4C = (TCCR4C & ~_BV(COM4D1)) | _BV(COM4D0);
+		break;
+	}
+}
+
+void PWM::set_output(const uint8_t Timer, const char ABCD_out, const uint16_t PeriodRegister, const uint16_t PulseWidthRegister, const bool invertOut, const PWM_Mode Mode)
+{
+	// COMx[10]   = [10] non-inverting ,[11] inverting mode
+	const uint8_t COMx10 = 2 + invertOut;
 
 	// WGMx[210]  =  [111] Fast PWM, OCRxA as top
+	//               [101] Phase correct PWM, OCRxA as top
 	// WGMx[3210] = [1110] Fast PWM,  ICRx as top
+	//              [1010] Phase correct PWM, ICRx as top
+	//              [1000] Phase and frequency correct PWM, ICRx as top
 	// WGMx[3210] = [1111] Fast PWM, OCRxA as top (Timer4 - OCR4C)
 
 	switch (Timer)
@@ -149,14 +589,14 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM
+		// Set the waveform mode, OCR0A as TOP : 111 Fast PWM, 101 Phase correct PWM
 		//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
 		//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
 		// clear the old bits
 		TCCR0A &= ~_BV(WGM01) & ~_BV(WGM00);
 		TCCR0B &= ~_BV(WGM02);
 		// set the new bits
-		TCCR0A |= _BV(WGM01) | _BV(WGM00);
+		TCCR0A |= (Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00);
 		TCCR0B |= _BV(WGM02);
 		break;
 	case 1:
@@ -187,15 +627,15 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM, ICR1 as TOP : 1110
+		// Set the waveform mode, ICR1 as TOP : 1110 Fast PWM, 1010 Phase correct, 1000 Phase and frequency correct
 		//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|   -  |   -  | WGM11| WGM10]
 		//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
 		// clear the old bits
 		TCCR1A &= ~_BV(WGM11) & ~_BV(WGM10);
 		TCCR1B &= ~_BV(WGM13) & ~_BV(WGM12);
 		// set the new bits
-		TCCR1A |= _BV(WGM11);
-		TCCR1B |= _BV(WGM13) | _BV(WGM12);
+		TCCR1A |= (Mode == PWM_PHASE_FREQUENCY_CORRECT) ? 0 : _BV(WGM11);
+		TCCR1B |= (Mode == PWM_FAST) ? (_BV(WGM13) | _BV(WGM12)) : _BV(WGM13);
 		break;
 	case 3:
 		// set the period register
@@ -235,19 +675,19 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM, ICR3 as TOP : 1110
+		// Set the waveform mode, ICR3 as TOP : 1110 Fast PWM, 1010 Phase correct, 1000 Phase and frequency correct
 		//TCCR3A = [COM3A1|COM3A0|COM3B1|COM3B0|COM3C1|COM3C0| WGM31| WGM30]
 		//TCCR3B = [ ICNC3| ICES3|   -  | WGM33| WGM32|  CS32|  CS31|  CS30]
 		// clear the old bits
 		TCCR3A &= ~_BV(WGM31) & ~_BV(WGM30);
 		TCCR3B &= ~_BV(WGM33) & ~_BV(WGM32);
 		// set the new bits
-		TCCR3A |= _BV(WGM31);
-		TCCR3B |= _BV(WGM33) | _BV(WGM32);
+		TCCR3A |= (Mode == PWM_PHASE_FREQUENCY_CORRECT) ? 0 : _BV(WGM31);
+		TCCR3B |= (Mode == PWM_FAST) ? (_BV(WGM33) | _BV(WGM32)) : _BV(WGM33);
 		break;
 	case 4:
-		// set the period register
-		OCR4C = PeriodRegister;
+		// set the period register (10b : TC4H first)
+		pwm_write10(OCR4C, PeriodRegister);
 
 		//TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A| FOC4B| PWM4A| PWM4B]
 		//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
@@ -257,7 +697,7 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 		{
 		case 'a':
 		case 'A':
-			OCR4A = PulseWidthRegister;
+			pwm_write10(OCR4A, PulseWidthRegister);
 			pinMode(OCR4A_pin, OUTPUT);
 			// clear the old bits
 			TCCR4A &= ~_BV(COM4A1) & ~_BV(COM4A0) & ~_BV(PWM4A);
@@ -266,7 +706,7 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		case 'b':
 		case 'B':
-			OCR4B = PulseWidthRegister;
+			pwm_write10(OCR4B, PulseWidthRegister);
 			pinMode(OCR4B_pin, OUTPUT);
 			// clear the old bits
 			TCCR4A &= ~_BV(COM4B1) & ~_BV(COM4B0) & ~_BV(PWM4B);
@@ -275,7 +715,7 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		case 'd':
 		case 'D':
-			OCR4D = PulseWidthRegister;
+			pwm_write10(OCR4D, PulseWidthRegister);
 			pinMode(OCR4D_pin, OUTPUT);
 			// clear the old bits
 			TCCR4C &= ~_BV(COM4D1) & ~_BV(COM4D0) & ~_BV(PWM4D);
@@ -284,10 +724,101 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 		//WGM4[10]  =  [00] Fast PWM,  OCR4C as top
+		//WGM4[10]  =  [01] Phase and frequency correct PWM, OCR4C as top
 		TCCR4D &= ~_BV(WGM41) & ~_BV(WGM40);
+		TCCR4D |= (Mode == PWM_FAST) ? 0 : _BV(WGM40);
+		break;
+	}
+}
+
+void PWM::apply(const PWM_Config &Config, const bool Atomic)
+{
+	const uint8_t Timer = Config.Timer;
+	PS_IDX[Timer] = Config.CSx3210;
+	PS[Timer] = 1 << pwm_prescaler_log2(Timer, Config.CSx3210);
+	pwm_set_period(Timer, Config.Top, Config.DualSlope);
+	set_dither(Timer, Config.Top, 0);
+	for (uint8_t Out = 0; Out < 4; ++Out)
+	{
+		if (Config.Outputs & _BV(Out)) { pinMode(pwm_output_pin(Timer, Out), OUTPUT); }
+	}
+
+	const uint8_t sreg = SREG;
+	if (Atomic) { cli(); }
+	switch (Timer)
+	{
+	case 0:
+		OCR0A = Config.Top;
+		OCR0B = Config.Compare[1];
+		TCCR0A = Config.Control[0];
+		TCCR0B = Config.Control[1];
 		break;
+	case 1:
+		ICR1 = Config.Top;
+		OCR1A = Config.Compare[0];
+		OCR1B = Config.Compare[1];
+		OCR1C = Config.Compare[2];
+		TCCR1A = Config.Control[0];
+		TCCR1B = Config.Control[1];
+		break;
+	case 3:
+		ICR3 = Config.Top;
+		OCR3A = Config.Compare[0];
+		TCCR3A = Config.Control[0];
+		TCCR3B = Config.Control[1];
+		break;
+	case 4:
+		pwm_write10(OCR4C, Config.Top);
+		pwm_write10(OCR4A, Config.Compare[0]);
+		pwm_write10(OCR4B, Config.Compare[1]);
+		pwm_write10(OCR4D, Config.Compare[3]);
+		TCCR4A = Config.Control[0];
+		// COM4A/B shadow bits : the same as in TCCR4A
+		TCCR4C = Config.Control[2] | (Config.Control[0] & 0xF0);
+		TCCR4D = Config.Control[3];
+		TCCR4B = Config.Control[1];
+		break;
+	}
+	if (Atomic) { SREG = sreg; }
+}
+
+// Timer4 can count the PLL through its postscaler : 48MHz / 1 (the USB clock), 96MHz / 1.5 or 96MHz / 1
+// with USB at 96MHz / 2. Moving the PLL to 96MHz relocks it, the USB clock stops for that time
+uint32_t PWM::setClock(const uint8_t Timer, const PWM_Clock Source)
+{
+	if (Source == PWM_CLOCK_CPU)
+	{
+		if (pwm_timer_max(Timer) == 0)
+		{
+			return 0;
+		}
+		// postscaler off : Timer4 back on clkI/O, the PLL keeps running for USB
+		if (Timer == 4) { PLLFRQ &= ~_BV(PLLTM1) & ~_BV(PLLTM0); }
+		timer_clock[Timer] = F_CPU;
+		return F_CPU;
 	}
+	if (Timer != 4)
+	{
+		return 0;
+	}
+	//PLLCSR = [   -  |   -  |   -  |PINDIV|   -  |   -  |  PLLE| PLOCK]
+	//PLLFRQ = [PINMUX|PLLUSB|PLLTM1|PLLTM0| PDIV3| PDIV2| PDIV1| PDIV0]
+	//PDIV[3210]  = [0100] 48MHz, [1010] 96MHz
+	//PLLTM[10]   = [01] / 1, [10] / 1.5
+	const uint8_t PDIV = (Source == PWM_CLOCK_PLL_LOW) ? 0x04 : 0x0A;
+	const uint8_t PLLTM = (Source == PWM_CLOCK_PLL) ? 2 : 1;
+	if (!(PLLCSR & _BV(PLLE)) | ((PLLFRQ & 0x0F) != PDIV))
+	{
+		// the PLL input must be 8MHz : the 16MHz crystal is divided by 2
+		PLLFRQ = (PLLFRQ & _BV(PINMUX)) | ((PDIV == 0x0A) << PLLUSB) | PDIV;
+		PLLCSR = ((F_CPU == 16000000UL) << PINDIV) | _BV(PLLE);
+	}
+	while (!(PLLCSR & _BV(PLOCK))) {}
+	PLLFRQ = (PLLFRQ & ~_BV(PLLTM1) & ~_BV(PLLTM0)) | (PLLTM << PLLTM0);
+	timer_clock[4] = (Source == PWM_CLOCK_PLL_LOW) ? 48000000UL : ((Source == PWM_CLOCK_PLL) ? 64000000UL : 96000000UL);
+	return timer_clock[4];
 }
+
 void PWM::start(const int8_t Timer)
 {
 	// stop the Timer before setting the new prescalar value
@@ -322,6 +853,37 @@ void PWM::start(const int8_t Timer)
 		break;
 	}
 }
+void PWM::startSync(const uint16_t *Phase)
+{
+	stop();
+	enableInterrupt();
+
+	const uint8_t sreg = SREG;
+	cli();
+	//GTCCR  = [   TSM|   -  |   -  |   -  |   -  |   -  |   -  |PSRSYNC]
+	// halt and reset the prescaler of Timer0/1/3
+	GTCCR |= _BV(TSM) | _BV(PSRSYNC);
+	TCNT0 = Phase ? Phase[0] : 0;
+	TCNT1 = Phase ? Phase[1] : 0;
+	TCNT3 = Phase ? Phase[3] : 0;
+	TCCR0B |= PS_IDX[0];
+	TCCR1B |= PS_IDX[1];
+	TCCR3B |= PS_IDX[3];
+	// Timer4 has its own prescaler, not halted by TSM : reset and started by the TCCR4B store. Both
+	// values are computed first, the sts of TCCR4B is followed by the out of GTCCR (the release) :
+	// Timer4 leads by PWM_SYNC_LEAD_CYCLES CPU cycle(s). In fast PWM TCNT4 is preloaded that many Timer4 counts back (whole counts : 4 from the PLL at
+	// 64MHz, prescalar 1, 1 from the CPU clock), the dual slope modes keep the lead
+	//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
+	const uint16_t Phase4 = Phase ? Phase[4] : 0;
+	const uint16_t Lead = (pwm_dual_slope & _BV(4)) ? 0 : (uint16_t)((PWM_SYNC_LEAD_CYCLES * (timer_clock[4] / F_CPU)) >> pwm_prescaler_log2(4, PS_IDX[4]));
+	pwm_write10(TCNT4, (Phase4 >= Lead) ? Phase4 - Lead : Phase4 + pwm_period_register[4] + 1 - Lead);
+	const uint8_t Tccr4b = TCCR4B | _BV(PSR4) | PS_IDX[4];
+	const uint8_t Gtccr = GTCCR & ~_BV(TSM);
+	TCCR4B = Tccr4b;
+	GTCCR = Gtccr;
+	SREG = sreg;
+}
+
 void PWM::stop(const int8_t Timer)
 {
 	// Set the PWM prescalar to zero (stops the timer)
@@ -385,10 +947,10 @@ void PWM::print()
 	printRegister(TCCR3C);
 
 	Serial.println(F("Timer4"));
-	printRegister(OCR4A, F("OCR4A  = "));
-	printRegister(OCR4B, F("OCR4B  = "));
-	printRegister(OCR4C, F("OCR4C  = "));
-	printRegister(OCR4D, F("OCR4D  = "));
+	printRegister(pwm_read10(OCR4A), F("OCR4A  = "));
+	printRegister(pwm_read10(OCR4B), F("OCR4B  = "));
+	printRegister(pwm_read10(OCR4C), F("OCR4C  = "));
+	printRegister(pwm_read10(OCR4D), F("OCR4D  = "));
 	Serial.println(F("TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A | FOC4B | PWM4A | PWM4B ]"));
 	printRegister(TCCR4A);
 	Serial.println(F("TCCR4B = [ PWM4X |  PSR4 | DTPS41| DTPS40|  CS43 |  CS42 |  CS41 |  CS40 ]"));
@@ -433,9 +995,9 @@ void PWM::print()
 	TimerFrequency /= (OCR3A + 1);
 	Serial.print(F("Timer3 : ")); Serial.print(TimerFrequency); Serial.println(F("Hz"));
 
-	Serial.print(F("PRESCALAR[4] : ")); Serial.print(PS[4]); Serial.print(F(", OCR4C : ")); Serial.println(OCR4A);
-	TimerFrequency = base_clock / PS[4];
-	TimerFrequency /= (OCR4C + 1);
+	Serial.print(F("PRESCALAR[4] : ")); Serial.print(PS[4]); Serial.print(F(", OCR4C : ")); Serial.println(pwm_read10(OCR4C));
+	TimerFrequency = timer_clock[4] / PS[4];
+	TimerFrequency /= (pwm_read10(OCR4C) + 1);
 	Serial.print(F("Timer4 : ")); Serial.print(TimerFrequency); Serial.println(F("Hz"));
 #endif
 }
@@ -445,6 +1007,20 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = isr;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = isr;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -457,6 +1033,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt1b = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t1)
+					{
+						pwm_decimation[1].Callback = isr;
+						isr = pwm_decimated1;
+					}
+#endif
 					pwm_interrupt1 = isr;
 			}
 			break;
@@ -476,6 +1060,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt3c = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t3)
+					{
+						pwm_decimation[3].Callback = isr;
+						isr = pwm_decimated3;
+					}
+#endif
 					pwm_interrupt3 = isr;
 			}
 			break;
@@ -495,6 +1087,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt4d = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t4)
+					{
+						pwm_decimation[4].Callback = isr;
+						isr = pwm_decimated4;
+					}
+#endif
 					pwm_interrupt4 = isr;
 			}
 			break;
@@ -508,6 +1108,20 @@ void PWM::detachInterrupt(const uint8_t &Timer, const char &ABCD_out)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = pwm_empty_interrupt;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = pwm_empty_interrupt;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -16,22 +16,111 @@
 // 
 
 //void(*pwm_interrupt0)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
-//void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0a)() = &pwm_empty_interrupt;
+void(*pwm_interrupt0b)() = &pwm_empty_interrupt;
 
 void(*pwm_interrupt1)() = &pwm_empty_interrupt;
 void(*pwm_interrupt1a)() = &pwm_empty_interrupt;
 void(*pwm_interrupt1b)() = &pwm_empty_interrupt;
 
+// period dither, installed as the overflow callback by set_dither (see PWM_Dither.h)
+void pwm_dither1() { pwm_dither_step(pwm_dither[1], OCR1C); }
+
+// staged update, installed as the overflow callback by commit (see PWM_Commit.h)
+void pwm_commit1() { pwm_commit_step(1, TCNT1, OCR1C, &OCR1A, &OCR1B, (volatile uint8_t *)0, true, &TCCR1, _BV(CS13) | _BV(CS12) | _BV(CS11) | _BV(CS10), pwm_interrupt1, TIMSK, TOIE1); }
+
+#if defined(PWM_DECIMATE)
+// down counter in front of the attached overflow callback (see PWM_Decimate.h)
+void pwm_decimated1() { pwm_decimate_step(1); }
+#endif
+
+// subscriber tables, installed as the callback of a vector by subscribe() (see PWM_Subscribe.h)
+enum { PWM_VECTOR_T0A = 0, PWM_VECTOR_T0B, PWM_VECTOR_T1, PWM_VECTOR_T1A, PWM_VECTOR_T1B, PWM_VECTORS };
+PWM_Subscribers pwm_subscribers[PWM_VECTORS];
+void pwm_subscribers_t0a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0A]); }
+void pwm_subscribers_t0b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T0B]); }
+void pwm_subscribers_t1() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1]); }
+void pwm_subscribers_t1a() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1A]); }
+void pwm_subscribers_t1b() { pwm_subscribers_run(pwm_subscribers[PWM_VECTOR_T1B]); }
+void(*const pwm_subscribers_isr[PWM_VECTORS])() = {
+	pwm_subscribers_t0a, pwm_subscribers_t0b, pwm_subscribers_t1, pwm_subscribers_t1a, pwm_subscribers_t1b };
+
+// table of the overflow (any ABCD_out but an output) or of an output of Timer, PWM_VECTORS if none
+constexpr uint8_t pwm_vector(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & ((uint8_t)(pwm_vector_slot(ABCD_out) - 1) < 2)) ? PWM_VECTOR_T0A + pwm_vector_slot(ABCD_out) - 1 :
+		((Timer == 1) & (pwm_vector_slot(ABCD_out) <= 2)) ? PWM_VECTOR_T1 + pwm_vector_slot(ABCD_out) : PWM_VECTORS;
+}
+
+// the overflow flag of Timer is set : a period started since its overflow ISR was entered
+inline bool pwm_overflow_pending(const uint8_t Timer)
+{
+	switch (Timer)
+	{
+	case 0: return TIFR & _BV(TOV0);
+	case 1: return TIFR & _BV(TOV1);
+	}
+	return false;
+}
+
+// ADC auto trigger (see PWM_ADC.h)
+#define PWM_ADC_VCC 0 // REFS[210] : Vcc
+
+// ADTS of the overflow (any ABCD_out but an output) or compare ABCD_out of Timer, 0xFF if it cannot
+// trigger the ADC. OCR0A is TOP, not a sampling compare, Timer1 is no trigger source
+constexpr uint8_t pwm_adc_trigger(const uint8_t Timer, const char ABCD_out)
+{
+	return ((Timer == 0) & (pwm_vector_slot(ABCD_out) == 0)) ? 4 :
+		((Timer == 0) & (pwm_vector_slot(ABCD_out) == 2)) ? 5 : 0xFF;
+}
+
+// conversions of Channel (MUX[3..0]) against Reference (REFS[210]), started by the trigger ADTS, ADC
+// clock F_CPU >> ADPS, with the ADC interrupt
+inline void pwm_adc_setup(const uint8_t ADTS, const uint8_t Channel, const uint8_t Reference, const uint8_t ADPS)
+{
+	//ADMUX  = [ REFS1| REFS0| ADLAR| REFS2|  MUX3|  MUX2|  MUX1|  MUX0]
+	ADMUX = ((Reference & 0x3) << REFS0) | ((Reference & 0x4) ? _BV(REFS2) : 0) | (Channel & 0x0F);
+	//ADCSRB = [   BIN|  ACME|   IPR|   -  |   -  | ADTS2| ADTS1| ADTS0]
+	ADCSRB = (ADCSRB & 0xE0) | ADTS;
+	//ADCSRA = [  ADEN|  ADSC| ADATE|  ADIF|  ADIE| ADPS2| ADPS1| ADPS0]
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | ADPS;
+}
+
+// clear the flag of the trigger ADTS if no ISR does : the next event must be a rising edge
+inline void pwm_adc_rearm(const uint8_t ADTS)
+{
+	switch (ADTS)
+	{
+	case 4: if (!(TIMSK & _BV(TOIE0))) { TIFR = _BV(TOV0); } break;
+	case 5: if (!(TIMSK & _BV(OCIE0B))) { TIFR = _BV(OCF0B); } break;
+	}
+}
+
+// ISR profiler slots (see PWM_Profile.h)
+#if defined(PWM_PROFILE)
+enum { PWM_PROFILE_T1 = 0, PWM_PROFILE_T1A, PWM_PROFILE_T1B, PWM_PROFILE_T0A, PWM_PROFILE_T0B, PWM_PROFILE_USER };
+static_assert(PWM_PROFILE_USER <= PWM_PROFILE_SLOTS, "PWM_PROFILE_SLOTS : one per vector at least");
+#endif
+
 #ifndef PWM_NOISR
 //TIMER0_OVF_vect is already defined in wiring.h (used by millis())
 //ISR(TIMER0_OVF_vect) { interrupt0(); } 
-//ISR(TIMER0_COMPA_vect) { pwm_interrupt0a(); }
-//ISR(TIMER0_COMPB_vect) { pwm_interrupt0b(); }
 
-ISR(TIMER1_OVF_vect) { pwm_interrupt1(); }
-ISR(TIMER1_COMPA_vect) { pwm_interrupt1a(); }
-ISR(TIMER1_COMPB_vect) { pwm_interrupt1b(); }
+#if defined(PWM_DITHER_FAST)
+PWM_DITHER_ISR8(TIMER1_OVF_vect, 1, OCR1C)
+#elif defined(PWM_DECIMATE) & !defined(PWM_PROFILE) & !defined(PWM_ISR_STATIC)
+PWM_DECIMATE_ISR(TIMER1_OVF_vect, 1)
+#elif !defined(PWM_ISR_STATIC)
+PWM_ISR_PROFILED(TIMER1_OVF_vect, pwm_interrupt1, PWM_PROFILE_T1, TCNT1, pwm_profile_top(1), pwm_profile_top(1))
+#endif
+
+#ifndef PWM_ISR_STATIC
+PWM_ISR_PROFILED(TIMER0_COMPA_vect, pwm_interrupt0a, PWM_PROFILE_T0A, TCNT0, OCR0A, pwm_profile_top(0))
+PWM_ISR_PROFILED(TIMER0_COMPB_vect, pwm_interrupt0b, PWM_PROFILE_T0B, TCNT0, OCR0B, pwm_profile_top(0))
+
+PWM_ISR_PROFILED(TIMER1_COMPA_vect, pwm_interrupt1a, PWM_PROFILE_T1A, TCNT1, OCR1A, pwm_profile_top(1))
+PWM_ISR_PROFILED(TIMER1_COMPB_vect, pwm_interrupt1b, PWM_PROFILE_T1B, TCNT1, OCR1B, pwm_profile_top(1))
+#endif
 #endif
 
 #define OCR0A_pin 0
@@ -39,46 +128,234 @@ ISR(TIMER1_COMPB_vect) { pwm_interrupt1b(); }
 #define OCR1A_pin 1
 #define OCR1B_pin 4
 
-void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const uint16_t DutyCycle_Divisor, const bool invertOut)
+// Timer description, used by the frequency solver (PWM::solve)
+// log2 of the prescalar selected by CSx[3210] : regular list (Timer0), extended list (Timer1)
+//                                         1 8 64 256 1024
+constexpr uint8_t pwm_PS_regular_log2[8] = { 0,0,3,6, 8, 10,0,0 };
+
+// TOP limit of the timer (0 : no such timer)
+constexpr uint16_t pwm_timer_max(const uint8_t Timer)
 {
-	uint16_t CSx3210 = 0;
-	uint32_t FrequencyCount = base_clock / FrequencyHz;
-	uint32_t PeriodRegister = 0;
-	uint32_t PulseWidthRegister = 0;
+	return (Timer <= 1) ? 0xFF : 0;
+}
+// largest CSx[3210] that selects an internal prescalar
+constexpr uint8_t pwm_cs_max(const uint8_t Timer)
+{
+	return (Timer == 1) ? 15 : 5;
+}
+// waveform mode of a timer for Mode : Timer0 has no phase and frequency correct mode,
+// Timer1 only counts up (fast PWM)
+constexpr PWM_Mode pwm_mode(const uint8_t Timer, const PWM_Mode Mode)
+{
+	return ((Mode == PWM_FAST) | (Timer == 1)) ? PWM_FAST : PWM_PHASE_CORRECT;
+}
+// timer with a period ditherer on its overflow ISR
+constexpr bool pwm_dither_timer(const uint8_t Timer)
+{
+	return Timer == 1;
+}
+// TOP register double buffered in the PWM modes (OCR0A), OCR1C is not
+constexpr bool pwm_top_buffered(const uint8_t Timer)
+{
+	return Timer != 1;
+}
+constexpr uint8_t pwm_prescaler_log2(const uint8_t Timer, const uint8_t CSx3210)
+{
+	return (Timer == 1) ? (CSx3210 - 1) : pwm_PS_regular_log2[CSx3210];
+}
 
-	// COMx[10]   = [10] non-inverting ,[11] inverting mode
-	const uint8_t COMx10 = 2 + invertOut;
+// Register image (PWM_Config) : Control = TCCR0A, TCCR0B (Timer0), TCCR1, GTCCR (Timer1)
+// Arduino pin of output 'a' + Out
+constexpr uint8_t pwm_output_pin(const uint8_t Timer, const uint8_t Out)
+{
+	return (Out == 0) ? ((Timer == 0) ? OCR0A_pin : ((Timer == 1) ? OCR1A_pin : PWM_NO_PIN)) :
+		((Out == 1) ? ((Timer == 0) ? OCR0B_pin : ((Timer == 1) ? OCR1B_pin : PWM_NO_PIN)) : PWM_NO_PIN);
+}
+//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
+//TCCR1 =  [  CTC1| PWM1A|COM1A1|COM1A0|  CS13|  CS12|  CS11|  CS10]
+//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+// OC1B also sets COM1A (errata, see set_output)
+constexpr uint8_t pwm_config_out_mask(const uint8_t Timer, const uint8_t Out, const uint8_t Reg)
+{
+	return (pwm_output_pin(Timer, Out) == PWM_NO_PIN) ? 0 :
+		((Timer == 0) ? ((Reg != 0) ? 0 : ((Out == 0) ? 0xC0 : 0x30)) :
+		((Reg == 0) ? ((Out == 0) ? (_BV(PWM1A) | _BV(COM1A1) | _BV(COM1A0)) : (_BV(COM1A1) | _BV(COM1A0))) :
+		(((Reg == 1) & (Out == 1)) ? (_BV(PWM1B) | _BV(COM1B1) | _BV(COM1B0)) : 0)));
+}
+// OCR0A is TOP : toggled (COM0A = 01)
+constexpr uint8_t pwm_config_out_bits(const uint8_t Timer, const uint8_t Out, const uint8_t Reg, const bool invertOut)
+{
+	return (pwm_config_out_mask(Timer, Out, Reg) == 0) ? 0 :
+		((Timer == 0) ? ((Out == 0) ? _BV(COM0A0) : ((2 + invertOut) << 4)) :
+		(((Reg == 0) & (Out == 0)) ? (_BV(PWM1A) | ((2 + invertOut) << 4)) :
+		((Reg == 0) ? ((2 + invertOut) << 4) : (_BV(PWM1B) | ((2 + invertOut) << 4)))));
+}
+// same modes as set_output
+//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
+constexpr uint8_t pwm_config_mode_bits(const uint8_t Timer, const PWM_Mode Mode, const uint8_t CSx3210, const uint8_t Reg)
+{
+	return (Timer == 0) ?
+			((Reg == 0) ? ((Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00)) : ((Reg == 1) ? (_BV(WGM02) | CSx3210) : 0)) :
+		((Reg == 0) ? CSx3210 : 0);
+}
+
+// Software PWM timebase (see PWM_Soft.h) : Timer1 in CTC mode (cleared after the OCR1C match),
+// the OCR1A match at TOP starts the period, OCR1B steps through the edges
+#define PWM_SOFT_TIMER 1
+#define PWM_SOFT_TCNT TCNT1
+#define PWM_SOFT_EDGE_OCR OCR1B
+#define PWM_SOFT_TIMSK TIMSK
+#define PWM_SOFT_EDGE_IE OCIE1B
+#define PWM_SOFT_TIFR TIFR
+#define PWM_SOFT_EDGE_IF OCF1B
+#define pwm_soft_period_interrupt pwm_interrupt1a
+#define pwm_soft_edge_interrupt pwm_interrupt1b
 
-	// Extended set of prescalar values
-	//                   0 1 2 3 4  5  6  7  8   9   10  11   12   13   14    15
-	uint16_t _PS[16] = { 0,1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384 };
-	// Index of the regular set of prescalar values
-	uint8_t N[6] = { 0,1,4,7,9,11 }; // _PS = { 0,1,8,64,256,1024 };
+inline void pwm_soft_timebase(const uint16_t PeriodRegister, const uint8_t CSx3210)
+{
+	//TCCR1 =  [  CTC1| PWM1A|COM1A1|COM1A0|  CS13|  CS12|  CS11|  CS10]
+	//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+	// stopped, compare outputs disconnected, no PWM : CTC with OCR1C as TOP
+	TCCR1 = 0;
+	GTCCR &= ~_BV(PWM1B) & ~_BV(COM1B1) & ~_BV(COM1B0);
+	OCR1C = PeriodRegister;
+	OCR1A = PeriodRegister;
+	TCNT1 = 0;
+	//TIMSK  = [   -  |OCIE1A|OCIE1B|OCIE0A|OCIE0B| TOIE1| TOIE0|   -  ] (shared with Timer0)
+	TIFR = _BV(OCF1A) | _BV(OCF1B) | _BV(TOV1);
+	TIMSK = (TIMSK & ~_BV(OCIE1B) & ~_BV(TOIE1)) | _BV(OCIE1A);
+	TCCR1 = _BV(CTC1) | CSx3210;
+}
+
+// Long period timebase (see PWM_Long.h) : Timer1 counts freely (no PWM nor CTC, MAX 0xFF), OC1A and OC1B
+// are set or cleared by their match, the match ISRs move OCR1x on towards the next edge
+#define PWM_LONG_TIMER 1
+#define PWM_LONG_BITS 8
+
+// Outputs : bit 0 OC1A, bit 1 OC1B, cleared by a forced compare, their first match at First
+inline void pwm_long_timebase(const uint8_t Outputs, const uint16_t First, const uint8_t CSx3210)
+{
+	//TCCR1 =  [  CTC1| PWM1A|COM1A1|COM1A0|  CS13|  CS12|  CS11|  CS10]
+	//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+	// stopped, COM1x = 10 clear
+	TCCR1 = (Outputs & 1) ? _BV(COM1A1) : 0;
+	GTCCR = (GTCCR & ~_BV(PWM1B) & ~_BV(COM1B1) & ~_BV(COM1B0)) | ((Outputs & 2) ? _BV(COM1B1) : 0);
+	GTCCR |= ((Outputs & 1) ? _BV(FOC1A) : 0) | ((Outputs & 2) ? _BV(FOC1B) : 0);
+	OCR1A = First;
+	OCR1B = First;
+	TCNT1 = 0;
+	//TIMSK  = [   -  |OCIE1A|OCIE1B|OCIE0A|OCIE0B| TOIE1| TOIE0|   -  ] (shared with Timer0)
+	TIFR = _BV(OCF1A) | _BV(OCF1B) | _BV(TOV1);
+	TIMSK &= ~_BV(OCIE1A) & ~_BV(OCIE1B) & ~_BV(TOIE1);
+	TCCR1 |= CSx3210;
+}
+// COM1x of output Out (0 : OC1A, 1 : OC1B) : set (High) or clear at its next match
+__attribute__((always_inline)) inline void pwm_long_action(const uint8_t Out, const bool High)
+{
+	if (Out)
+	{
+		GTCCR = (GTCCR & ~_BV(COM1B1) & ~_BV(COM1B0)) | ((2 + High) << COM1B0);
+	}
+	else
+	{
+		TCCR1 = (TCCR1 & ~_BV(COM1A1) & ~_BV(COM1A0)) | ((2 + High) << COM1A0);
+	}
+}
+
+PWM_Result PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &FrequencyHz, const PWM_Duty Duty, const bool invertOut, const bool dither, const PWM_Mode Mode)
+{
+	const PWM_Mode WaveformMode = pwm_mode(Timer, Mode);
+
+	// find the prescalar and PeriodRegister closest to FrequencyHz
+	// dither : the largest PeriodRegister below it, the overflow ISR adds the fraction
+	const PWM_Result Result = (dither & pwm_dither_timer(Timer)) ? solve_dither(Timer, FrequencyHz, WaveformMode) : solve(Timer, FrequencyHz, WaveformMode);
+	PS_IDX[Timer] = Result.CSx3210;
+	PS[Timer] = Result.Prescalar;
+
+	pwm_set_period(Timer, Result.PeriodRegister, WaveformMode != PWM_FAST);
+	const uint16_t PulseWidthRegister = pwm_pulse_width(Timer, Duty);
+
+	set_output(Timer, ABCD_out, Result.PeriodRegister, PulseWidthRegister, invertOut, WaveformMode);
+	set_dither(Timer, Result.PeriodRegister, Result.PeriodFraction);
+	return Result;
+}
+
+void PWM::set_dither(const uint8_t Timer, const uint16_t PeriodRegister, const uint16_t PeriodFraction)
+{
+	if (!pwm_dither_timer(Timer))
+	{
+		return;
+	}
 
-	// find the right prescalar
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dither[Timer].top = PeriodRegister;
+	pwm_dither[Timer].frac = PeriodFraction;
+	pwm_dither[Timer].acc = 0;
+#if !defined(PWM_DITHER_FAST)
+	// install (or remove) the ditherer as the overflow callback
 	switch (Timer)
 	{
 	case 1:
-		// 8b timer, extended prescalar list
-		// pg89 shows extended prescalars
-		while ((FrequencyCount > (1 + _PS[CSx3210] * 0xFF)) & (CSx3210 < 15)) { ++CSx3210; }
-		PS_IDX[Timer] = CSx3210;
-		PS[Timer] = _PS[PS_IDX[Timer]];
+		if (PeriodFraction) { pwm_interrupt1 = pwm_dither1; }
+		else if (pwm_interrupt1 == pwm_dither1) { pwm_interrupt1 = pwm_empty_interrupt; }
+		break;
+	}
+#endif
+	SREG = sreg;
+
+	if (PeriodFraction)
+	{
+		enableInterrupt(Timer);
+	}
+}
+
+bool PWM::commit(const uint8_t Timer)
+{
+	PWM_Stage &s = pwm_staged[Timer];
+	if (pwm_commit[Timer].Phase != PWM_COMMIT_IDLE)
+	{
+		return false;
+	}
+	if (s.Mask & PWM_STAGE_TOP)
+	{
+		pwm_period_register[Timer] = s.Top;
+	}
+
+	const uint8_t sreg = SREG;
+	cli();
+	switch (Timer)
+	{
+	case 0:
+		// the overflow ISR is used by millis(), OCR0A (TOP) and OCR0B are double buffered
+		pwm_commit_now(0, OCR0A, (volatile uint8_t *)0, &OCR0B, (volatile uint8_t *)0, false);
 		break;
-	default: // Timer 0
-		// 8b timer, regular rescalar list
-		while ((FrequencyCount > (1 + _PS[N[CSx3210]] * 0xFF)) & (CSx3210 < 5)) { ++CSx3210; }
-		PS_IDX[Timer] = CSx3210;
-		PS[Timer] = _PS[N[PS_IDX[Timer]]];
+	case 1:
+	#if defined(PWM_DITHER_FAST)
+		// OCR1A/OCR1B are double buffered, the overflow ISR writes OCR1C from pwm_dither
+		pwm_commit_now(1, OCR1C, &OCR1A, &OCR1B, (volatile uint8_t *)0, true);
+		if (s.Mask & PWM_STAGE_TOP) { pwm_commit_enable(TIMSK, TOIE1, TIFR, TOV1); }
+	#else
+		if (s.Mask) { pwm_commit_arm(1, pwm_interrupt1, pwm_commit1); pwm_commit_enable(TIMSK, TOIE1, TIFR, TOV1); }
+	#endif
 		break;
 	}
+	SREG = sreg;
+
+	s.Mask = 0;
+	return true;
+}
 
-	// frequency = f_clk/(PS * (1 + PeriodRegister)); 
-	PeriodRegister = (FrequencyCount / PS[Timer]) - 1;
-	PulseWidthRegister = PeriodRegister / DutyCycle_Divisor;
+void PWM::set_output(const uint8_t Timer, const char ABCD_out, const uint16_t PeriodRegister, const uint16_t PulseWidthRegister, const bool invertOut, const PWM_Mode Mode)
+{
+	// COMx[10]   = [10] non-inverting ,[11] inverting mode
+	const uint8_t COMx10 = 2 + invertOut;
 
 	// WGMx[210]  =  [111] Fast PWM, OCRxA as top
+	//               [101] Phase correct PWM, OCRxA as top
 	// WGMx[3210] = [1110] Fast PWM,  ICRx as top
+	//              [1010] Phase correct PWM, ICRx as top
+	//              [1000] Phase and frequency correct PWM, ICRx as top
 	// WGMx[3210] = [1111] Fast PWM, OCRxA as top (Timer4 - OCR4C)
 
 	switch (Timer)
@@ -110,14 +387,14 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 			break;
 		}
 
-		// Set the waveform mode to fast PWM
+		// Set the waveform mode, OCR0A as TOP : 111 Fast PWM, 101 Phase correct PWM
 		//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
 		//TCCR0B = [ FOC0A| FOC0A|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
 		// clear the old bits
 		TCCR0A &= ~_BV(WGM01) & ~_BV(WGM00);
 		TCCR0B &= ~_BV(WGM02);
 		// set the new bits
-		TCCR0A |= _BV(WGM01) | _BV(WGM00);
+		TCCR0A |= (Mode == PWM_FAST) ? (_BV(WGM01) | _BV(WGM00)) : _BV(WGM00);
 		TCCR0B |= _BV(WGM02);
 		break;
 	case 1:
@@ -158,6 +435,74 @@ void PWM::set(const uint8_t &Timer, const char &ABCD_out, const uint32_t &Freque
 		break;
 	}
 }
+
+void PWM::apply(const PWM_Config &Config, const bool Atomic)
+{
+	const uint8_t Timer = Config.Timer;
+	PS_IDX[Timer] = Config.CSx3210;
+	PS[Timer] = 1 << pwm_prescaler_log2(Timer, Config.CSx3210);
+	pwm_set_period(Timer, Config.Top, Config.DualSlope);
+	set_dither(Timer, Config.Top, 0);
+	for (uint8_t Out = 0; Out < 2; ++Out)
+	{
+		if (Config.Outputs & _BV(Out)) { pinMode(pwm_output_pin(Timer, Out), OUTPUT); }
+	}
+
+	const uint8_t sreg = SREG;
+	if (Atomic) { cli(); }
+	switch (Timer)
+	{
+	case 0:
+		OCR0A = Config.Top;
+		OCR0B = Config.Compare[1];
+		TCCR0A = Config.Control[0];
+		TCCR0B = Config.Control[1];
+		break;
+	case 1:
+		OCR1C = Config.Top;
+		OCR1A = Config.Compare[0];
+		OCR1B = Config.Compare[1];
+		GTCCR = Config.Control[1];
+		TCCR1 = Config.Control[0];
+		break;
+	}
+	if (Atomic) { SREG = sreg; }
+}
+
+// Timer1 can count PCK, the 64MHz PLL output (32MHz in low speed mode)
+uint32_t PWM::setClock(const uint8_t Timer, const PWM_Clock Source)
+{
+	if (Source == PWM_CLOCK_CPU)
+	{
+		if (pwm_timer_max(Timer) == 0)
+		{
+			return 0;
+		}
+		// the PLL keeps running : it may clock the CPU (CKSEL = 0001)
+		if (Timer == 1) { PLLCSR &= ~_BV(PCKE); }
+		timer_clock[Timer] = F_CPU;
+		return F_CPU;
+	}
+	if ((Timer != 1) | (Source == PWM_CLOCK_PLL_HIGH))
+	{
+		return 0;
+	}
+	//PLLCSR = [   LSM|   -  |   -  |   -  |   -  |  PCKE|  PLLE| PLOCK]
+	// already locked when the PLL clocks the CPU, otherwise start it and let it settle for 100us
+	if (!(PLLCSR & _BV(PLLE)))
+	{
+		PLLCSR |= _BV(PLLE);
+		delayMicroseconds(100);
+	}
+	while (!(PLLCSR & _BV(PLOCK))) {}
+	// LSM before PCKE, it cannot be set while the PLL clocks the CPU
+	if (Source == PWM_CLOCK_PLL_LOW) { PLLCSR |= _BV(LSM); }
+	else { PLLCSR &= ~_BV(LSM); }
+	PLLCSR |= _BV(PCKE);
+	timer_clock[1] = (Source == PWM_CLOCK_PLL_LOW) ? 32000000UL : 64000000UL;
+	return timer_clock[1];
+}
+
 void PWM::start(const int8_t Timer)
 {
 	// stop the Timer before setting the new prescalar value
@@ -182,6 +527,32 @@ void PWM::start(const int8_t Timer)
 		break;
 	}
 }
+void PWM::startSync(const uint16_t *Phase)
+{
+	stop();
+	enableInterrupt();
+
+	const uint8_t sreg = SREG;
+	cli();
+	//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+	// halt and reset the prescaler of Timer0 (PSR0). TSM does not hold PSR1 : Timer1 counts from the
+	// store of its clock select bits
+	GTCCR |= _BV(TSM) | _BV(PSR0);
+	TCNT0 = Phase ? Phase[0] : 0;
+	TCCR0B |= PS_IDX[0];
+	// TCCR1 and GTCCR are computed first and written by two consecutive out : the second one releases
+	// Timer0 and resets the Timer1 prescaler, Timer1 leads by PWM_SYNC_LEAD_CYCLES. TCNT1 is preloaded that
+	// many Timer1 counts back (whole counts : the PCK at 64MHz is 8 at 8MHz, prescalar 1)
+	const uint8_t Lead = (uint8_t)((PWM_SYNC_LEAD_CYCLES * (timer_clock[1] / F_CPU)) >> pwm_prescaler_log2(1, PS_IDX[1]));
+	const uint8_t Phase1 = Phase ? Phase[1] : 0;
+	TCNT1 = (Phase1 >= Lead) ? Phase1 - Lead : Phase1 + OCR1C + 1 - Lead;
+	const uint8_t Tccr1 = TCCR1 | PS_IDX[1];
+	const uint8_t Gtccr = (GTCCR & ~_BV(TSM)) | _BV(PSR1);
+	TCCR1 = Tccr1;
+	GTCCR = Gtccr;
+	SREG = sreg;
+}
+
 void PWM::stop(const int8_t Timer)
 {
 	// Set the PWM prescalar to zero (stops the timer)
@@ -243,7 +614,7 @@ void PWM::print()
 
 	Serial.print(F("PRESCALAR[1] : ")); Serial.print(PS[1]);
 	Serial.print(F(", OCR1C : ")); Serial.println(OCR1C);
-	TimerFrequency = base_clock / PS[1];
+	TimerFrequency = timer_clock[1] / PS[1];
 	TimerFrequency /= (OCR1C + 1);
 
 	Serial.print(F("Timer1 : ")); Serial.print(TimerFrequency); Serial.println(F("Hz"));
@@ -255,6 +626,20 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = isr;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = isr;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -267,6 +652,14 @@ void PWM::attachInterrupt(const uint8_t &Timer, const char &ABCD_out, void(*isr)
 					pwm_interrupt1b = isr;
 					break;
 				default:
+#if defined(PWM_DECIMATE)
+					// the subscribers run every period
+					if (isr != pwm_subscribers_t1)
+					{
+						pwm_decimation[1].Callback = isr;
+						isr = pwm_decimated1;
+					}
+#endif
 					pwm_interrupt1 = isr;
 			}
 			break;
@@ -280,6 +673,20 @@ void PWM::detachInterrupt(const uint8_t &Timer, const char &ABCD_out)
 	
 	switch (Timer)
 	{
+		case 0:
+			// the overflow is used by millis()
+			switch (ABCD_out)
+			{
+				case 'a':
+				case 'A':
+					pwm_interrupt0a = pwm_empty_interrupt;
+					break;
+				case 'b':
+				case 'B':
+					pwm_interrupt0b = pwm_empty_interrupt;
+					break;
+			}
+			break;
 		case 1:
 			switch (ABCD_out)
 			{
@@ -0,0 +1,229 @@
+#ifndef PWM_BAM_H
+#define PWM_BAM_H
+
+// Bit angle modulation of 74HC595 chains over SPI
+// A brightness level of PWM_BAM_BITS bits is shown as its bit-planes : plane k (bit k of every
+// channel) is on the outputs for 2^k base slots, so a frame of 2^PWM_BAM_BITS - 1 slots shows each
+// channel high for Level slots. One timer of the back-end (PWM_BAM_TIMER : Timer1, counting freely)
+// ends each slot with a compare match, the ISR latches the plane shifted during that slot, moves the
+// compare register on by the length of the new one and shifts the following plane out over SPI (MOSI -> SER, SCK -> SRCLK, LatchPin -> RCLK,
+// the first 74HC595 of the chain drives channels 0..7, Q7 = channel 7).
+//
+//   #include <PWM.h>
+//   #include <PWM_BAM.h>
+//   pwm_bam.begin(200, 8);                    // 200 frames per second, RCLK on pin 8
+//   pwm_bam.set(12, 64);                      // channel 12 at 64/255
+//   pwm_bam.show();                           // on the outputs from the next frame
+//
+// PWM_BAM_BITS interrupts per frame whatever the resolution (software PWM takes one per edge), each
+// shifting PWM_BAM_CHANNELS / 8 bytes at fosc/2 (blocking, 16 cycles a byte : no interrupt per byte).
+// set() writes the bits of one channel into the back planes and show() hands them to the ISR, which
+// swaps at the end of a frame : a frame never mixes two sets of levels. Neither waits for the frame,
+// a set() before the swap takes the back planes back (show() again to hand them over).
+// The slots are counted from compare match to compare match, the ISR latency does not add up.
+//
+// The shortest slot must hold the whole ISR : begin() stretches the base slot to PWM_BAM_ISR_CYCLES.
+// Its default is an instruction count of the plane 0 slot, the shortest one (no shift of the base,
+// no frame end) : callback vector 85, latch pulse 17, compare register 22, plane address 16, store 2,
+// so 142 + 22 per byte (store 3, SPI 16, loop 3), 318 for 64 channels. That caps the frame rate
+// (64 channels, 8 bits, 16MHz : ~197Hz), the ISRs then take about PWM_BAM_BITS / (2^PWM_BAM_BITS - 1)
+// of the CPU (8 bits : ~3%). Max of the PWM_PROFILE_T1A slot plus the 74 cycles around the handler is
+// the ISR of a build : define PWM_BAM_ISR_CYCLES to it before including PWM_BAM.h.
+// Timer1 and its pins (OCR1A_pin, OCR1B_pin) are used, the SPI master owns MOSI, SCK and SS (output).
+
+#include <PWM.h>
+
+#if !defined(PWM_BAM_TIMER)
+#error "PWM_BAM.h : no SPI master on this chip (ATmega328p and ATmega32u4)"
+#endif
+
+#ifndef PWM_BAM_CHANNELS
+#define PWM_BAM_CHANNELS 64
+#endif
+#ifndef PWM_BAM_BITS
+#define PWM_BAM_BITS 8
+#endif
+#define PWM_BAM_BYTES (PWM_BAM_CHANNELS / 8)
+#ifndef PWM_BAM_ISR_CYCLES
+#define PWM_BAM_ISR_CYCLES (142 + 22 * PWM_BAM_BYTES)
+#endif
+
+static_assert((PWM_BAM_CHANNELS % 8 == 0) & (PWM_BAM_CHANNELS > 0), "PWM_BAM_CHANNELS : whole 74HC595s (multiple of 8)");
+static_assert((PWM_BAM_BITS >= 1) & (PWM_BAM_BITS <= 8), "PWM_BAM_BITS : 1 .. 8");
+
+uint8_t pwm_bam_planes[2][PWM_BAM_BITS][PWM_BAM_BYTES];
+volatile uint8_t pwm_bam_front = 0;    // planes shifted out by the ISR
+volatile uint8_t pwm_bam_pending = 0;  // the other ones are ready, swapped at the next frame
+uint8_t pwm_bam_plane = 0;             // plane in the shift registers, latched at the next match (ISR only)
+uint16_t pwm_bam_base = 1;             // timer ticks of the plane 0 slot
+volatile uint8_t *pwm_bam_latch_port;
+uint8_t pwm_bam_latch_bit;
+
+// shift one plane out, the byte of the last 74HC595 of the chain first
+inline void pwm_bam_shift(const uint8_t *Plane)
+{
+	for (uint8_t i = PWM_BAM_BYTES; i-- > 0;)
+	{
+		SPDR = Plane[i];
+		while (!(SPSR & _BV(SPIF))) {}
+	}
+}
+
+// slot match : show the shifted plane for its 2^k slots, shift the next one
+void pwm_bam_slot()
+{
+	*pwm_bam_latch_port |= pwm_bam_latch_bit;
+	*pwm_bam_latch_port &= ~pwm_bam_latch_bit;
+	const uint8_t Shown = pwm_bam_plane;
+	// 16b wrap around : a 65536 tick slot matches the same value again
+	PWM_BAM_SLOT_OCR += pwm_bam_base << Shown;
+
+	uint8_t Next = Shown + 1;
+	if (Next == PWM_BAM_BITS)
+	{
+		// end of the frame
+		Next = 0;
+		if (pwm_bam_pending)
+		{
+			pwm_bam_front ^= 1;
+			pwm_bam_pending = 0;
+		}
+	}
+	pwm_bam_shift(pwm_bam_planes[pwm_bam_front][Next]);
+	pwm_bam_plane = Next;
+}
+
+class PWM_BAM {
+protected:
+	bool Stale = false; // the back planes are older than the front ones (show() swapped in)
+
+	// make the back planes ours and up to date
+	void sync();
+
+public:
+	// start the frames at FrameHz or lower (see above), LatchPin drives RCLK
+	// Result : the base slot (PeriodRegister + 1 ticks), the achieved frame rate and DutyBits = PWM_BAM_BITS
+	PWM_Result begin(const uint32_t FrameHz, const uint8_t LatchPin);
+	// stop the frames, the outputs keep the last plane
+	void end();
+	// Level 0 .. 2^PWM_BAM_BITS - 1 of Channel, in the back planes
+	void set(const uint8_t Channel, const uint8_t Level);
+	// swap the back planes in at the next frame (set() takes them back until then)
+	void show();
+};
+
+void PWM_BAM::sync()
+{
+	// a show() not swapped in yet is withdrawn : the back planes are still the newest ones
+	const uint8_t sreg = SREG;
+	cli();
+	const bool Swapped = !pwm_bam_pending;
+	pwm_bam_pending = 0;
+	SREG = sreg;
+	if (Swapped & Stale)
+	{
+		const uint8_t Front = pwm_bam_front;
+		memcpy(pwm_bam_planes[Front ^ 1], pwm_bam_planes[Front], sizeof(pwm_bam_planes[0]));
+	}
+	Stale = false;
+}
+
+PWM_Result PWM_BAM::begin(const uint32_t FrameHz, const uint8_t LatchPin)
+{
+	// base slot : F_CPU / (FrameHz * (2^BITS - 1)) cycles, at least the ISR, the longest slot 65536 ticks at most
+	const uint32_t Slots = (1UL << PWM_BAM_BITS) - 1;
+	const uint32_t Den = FrameHz * Slots;
+	const uint32_t BaseCycles = Den ? (F_CPU + Den / 2) / Den : 0xFFFFFFFF;
+	const uint32_t BaseMax = 0x10000UL >> (PWM_BAM_BITS - 1);
+	uint8_t CSx3210 = 1;
+	uint32_t Base = 0;
+	for (;; ++CSx3210)
+	{
+		const uint8_t log2PS = pwm_prescaler_log2(PWM_BAM_TIMER, CSx3210);
+		const uint32_t MinTicks = (PWM_BAM_ISR_CYCLES + (1UL << log2PS) - 1) >> log2PS;
+		Base = (BaseCycles + ((1UL << log2PS) >> 1)) >> log2PS;
+		if (Base < MinTicks) { Base = MinTicks; }
+		if ((Base <= BaseMax) | (CSx3210 == pwm_cs_max(PWM_BAM_TIMER)))
+		{
+			break;
+		}
+	}
+	if (Base > BaseMax) { Base = BaseMax; }
+
+	PWM_Result Result;
+	Result.CSx3210 = CSx3210;
+	Result.Prescalar = pwm_prescaler(PWM_BAM_TIMER, CSx3210);
+	Result.PeriodRegister = Base - 1;
+	Result.FrequencyNumerator = F_CPU;
+	Result.FrequencyDenominator = ((uint32_t)Result.Prescalar * Base) * Slots;
+	Result.Error_ppm = pwm_ppm((int32_t)(F_CPU - Result.FrequencyDenominator * FrameHz), Result.FrequencyDenominator * FrameHz);
+	Result.DutyBits = PWM_BAM_BITS;
+	Result.PeriodFraction = 0;
+
+	//SPCR = [  SPIE|   SPE|  DORD|  MSTR|  CPOL|  CPHA|  SPR1|  SPR0]
+	//SPSR = [  SPIF|  WCOL|   -  |   -  |   -  |   -  |   -  | SPI2X]
+	// master, MSB first, mode 0, fosc/2
+	pinMode(PWM_BAM_SS_pin, OUTPUT);
+	pinMode(PWM_BAM_MOSI_pin, OUTPUT);
+	pinMode(PWM_BAM_SCK_pin, OUTPUT);
+	SPCR = _BV(SPE) | _BV(MSTR);
+	SPSR = _BV(SPI2X);
+	pinMode(LatchPin, OUTPUT);
+	digitalWrite(LatchPin, LOW);
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_bam_latch_port = portOutputRegister(digitalPinToPort(LatchPin));
+	pwm_bam_latch_bit = digitalPinToBitMask(LatchPin);
+	pwm_bam_base = Base;
+	pwm_bam_slot_interrupt = pwm_bam_slot;
+	// plane 0 goes out now, the first match latches it
+	pwm_bam_plane = 0;
+	pwm_bam_shift(pwm_bam_planes[pwm_bam_front][0]);
+	SREG = sreg;
+	pwm_bam_timebase(Base, CSx3210);
+	return Result;
+}
+
+void PWM_BAM::end()
+{
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_bam_timebase(0, 0);
+	pwm_bam_slot_interrupt = pwm_empty_interrupt;
+	// a show() no frame took : the back planes become the front ones, as the ISR would do
+	if (pwm_bam_pending)
+	{
+		pwm_bam_front ^= 1;
+		pwm_bam_pending = 0;
+	}
+	SREG = sreg;
+}
+
+void PWM_BAM::set(const uint8_t Channel, const uint8_t Level)
+{
+	if (Channel >= PWM_BAM_CHANNELS)
+	{
+		return;
+	}
+	sync();
+	uint8_t (&Planes)[PWM_BAM_BITS][PWM_BAM_BYTES] = pwm_bam_planes[pwm_bam_front ^ 1];
+	const uint8_t Byte = Channel >> 3;
+	const uint8_t Bit = _BV(Channel & 7);
+	for (uint8_t k = 0; k < PWM_BAM_BITS; ++k)
+	{
+		if (Level & _BV(k)) { Planes[k][Byte] |= Bit; }
+		else { Planes[k][Byte] &= ~Bit; }
+	}
+}
+
+void PWM_BAM::show()
+{
+	sync();
+	pwm_bam_pending = 1;
+	Stale = true;
+}
+
+PWM_BAM pwm_bam;
+
+#endif
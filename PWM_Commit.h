@@ -0,0 +1,184 @@
+#ifndef PWM_Commit_H
+#define PWM_Commit_H
+
+// Staged update
+// set() and setDuty() write the registers at once. A running timer then sees a TOP below TCNT
+// (the counter runs on to its MAX : a missing pulse) or one period with the new TOP and the old
+// compare values (a runt). Instead, stage the period and the duty cycles of the outputs of a timer,
+// then commit() them : the overflow ISR applies them together, at the start of a period.
+//
+//   pwm.stagePeriod(1, 399);
+//   pwm.stageDuty(1, 'a', pwm_q16(0x4000)); // scaled to the staged period
+//   pwm.stageDuty(1, 'b', 100);
+//   pwm.commit(1);
+//
+// The compare registers are double buffered by the hardware in the PWM modes, loaded at BOTTOM (TOP
+// in phase correct mode). The TOP registers are not always :
+//   buffered TOP (OCR0A, OCR2A, OCR4C) : written with the compare registers, from the first overflow
+//   ICRx                               : the compare registers from the first overflow, TOP from the
+//                                        next one, the start of the period that loads them
+//   ATtinyX5 Timer1                    : nothing is buffered, all written from the first overflow
+// so the old and the new values are never mixed within a period (except the first half of it in phase
+// correct mode, use PWM_PHASE_FREQUENCY_CORRECT for a changing TOP). In fast PWM the overflow flag is
+// set at TOP : with an unbuffered TOP (ICRx, ATtinyX5 OCR1C) the ISR waits for the counter to leave it
+// before it writes, or for the timer to stop (clock select 0, TSM). That wait is one timer count less
+// the interrupt entry at most, none with a count shorter than the entry (by instruction count 46 cycles,
+// vector entry 39 and callback call 7, taken as 40 below) : nothing up to PS 8, at most 24 cycles at
+// PS 64, 216 at 256 and 984 at 1024 (ATmega Timer1/3), 16344 at PS 16384 (ATtinyX5 Timer1). The buffered TOP timers (Timer2, Timer4) do not wait.
+// The ISR writes are TEMP register safe (interrupts are off). The commit is installed as the overflow
+// callback (pwm_interruptN) for one or two periods and chains to the previous one (ditherer, user
+// callback). Timer0 (overflow ISR used by millis()) and the dither timers with PWM_DITHER_FAST have no
+// callback : the compare registers are written at once (hardware buffered) and TOP directly (Timer0)
+// or through the ditherer, which loads it at the next overflow (the ATtinyX5 OCR1A/OCR1B are not buffered :
+// not glitch free with PWM_DITHER_FAST). A dither timer keeps its PeriodFraction.
+
+enum { PWM_COMMIT_IDLE = 0, PWM_COMMIT_COMPARE = 1, PWM_COMMIT_TOP = 2 };
+#define PWM_STAGE_TOP _BV(3)
+
+struct PWM_Stage
+{
+	uint16_t Top;
+	uint16_t Ocr[3]; // A, B, C (D on Timer4)
+	uint8_t Mask;    // bit 0..2 : Ocr[0..2] staged, PWM_STAGE_TOP : Top staged
+};
+
+struct PWM_Commit
+{
+	PWM_Stage Stage; // applied by the overflow ISR
+	uint8_t Phase;   // PWM_COMMIT_COMPARE or PWM_COMMIT_TOP : registers written by the next overflow
+	void(*Next)();   // overflow callback, restored when the commit is done
+};
+
+PWM_Stage pwm_staged[5];             // filled by stagePeriod / stageDuty
+volatile PWM_Commit pwm_commit[5];
+
+// index of an output in PWM_Stage::Ocr, 0xFF if unknown
+constexpr uint8_t pwm_channel(const char ABCD_out)
+{
+	return ((ABCD_out == 'a') | (ABCD_out == 'A')) ? 0 :
+		((ABCD_out == 'b') | (ABCD_out == 'B')) ? 1 :
+		((ABCD_out == 'c') | (ABCD_out == 'C') | (ABCD_out == 'd') | (ABCD_out == 'D')) ? 2 : 0xFF;
+}
+
+// one commit step, called from the overflow ISR of Timer
+// TopWithCompare : TOP is loaded at the same time as the compare registers, written in the same step
+// TCCRx, CSx : clock select register and bits of a timer with an unbuffered TOP, 0 if it is buffered
+template <typename Register>
+inline void pwm_commit_step(const uint8_t Timer, volatile Register &Counter, volatile Register &TopRegister,
+	volatile Register *OcrA, volatile Register *OcrB, volatile Register *OcrC, const bool TopWithCompare,
+	volatile uint8_t *TCCRx, const uint8_t CSx, void(*&Callback)(), volatile uint8_t &TIMSKx, const uint8_t TOIEx)
+{
+	volatile PWM_Commit &c = pwm_commit[Timer];
+	const uint8_t Mask = c.Stage.Mask;
+
+	// fast PWM : TOVx is set at TOP, an unbuffered TOP is written once the counter has left it (see above)
+	if (TCCRx)
+	{
+		while ((Counter == TopRegister) & ((*TCCRx & CSx) != 0) & !(GTCCR & _BV(TSM))) { PWM_SPIN(); }
+	}
+
+	uint8_t Phase = PWM_COMMIT_IDLE;
+	if (c.Phase == PWM_COMMIT_COMPARE)
+	{
+		if (OcrA && (Mask & _BV(0))) { *OcrA = c.Stage.Ocr[0]; }
+		if (OcrB && (Mask & _BV(1))) { *OcrB = c.Stage.Ocr[1]; }
+		if (OcrC && (Mask & _BV(2))) { *OcrC = c.Stage.Ocr[2]; }
+		if (Mask & PWM_STAGE_TOP)
+		{
+			if (TopWithCompare) { TopRegister = c.Stage.Top; }
+			else { Phase = PWM_COMMIT_TOP; }
+		}
+	}
+	else
+	{
+		TopRegister = c.Stage.Top;
+	}
+	if ((Mask & PWM_STAGE_TOP) && (Phase == PWM_COMMIT_IDLE))
+	{
+		pwm_dither[Timer].top = c.Stage.Top;
+	}
+	c.Phase = Phase;
+
+	void(*Next)() = c.Next;
+	if (Phase == PWM_COMMIT_IDLE)
+	{
+		Callback = Next;
+		if (Next == pwm_empty_interrupt) { TIMSKx &= ~_BV(TOIEx); }
+	}
+	Next();
+}
+
+// commit without an overflow callback (see above), interrupts off
+template <typename Register>
+inline void pwm_commit_now(const uint8_t Timer, volatile Register &TopRegister,
+	volatile Register *OcrA, volatile Register *OcrB, volatile Register *OcrC, const bool TopThroughDither)
+{
+	const PWM_Stage &s = pwm_staged[Timer];
+	if (OcrA && (s.Mask & _BV(0))) { *OcrA = s.Ocr[0]; }
+	if (OcrB && (s.Mask & _BV(1))) { *OcrB = s.Ocr[1]; }
+	if (OcrC && (s.Mask & _BV(2))) { *OcrC = s.Ocr[2]; }
+	if (s.Mask & PWM_STAGE_TOP)
+	{
+		pwm_dither[Timer].top = s.Top;
+		if (!TopThroughDither) { TopRegister = s.Top; }
+	}
+}
+
+// hand the stage to the overflow ISR of Timer, interrupts off
+inline void pwm_commit_arm(const uint8_t Timer, void(*&Callback)(), void(*Commit)())
+{
+	volatile PWM_Commit &c = pwm_commit[Timer];
+	const PWM_Stage &s = pwm_staged[Timer];
+	c.Stage.Top = s.Top;
+	c.Stage.Ocr[0] = s.Ocr[0];
+	c.Stage.Ocr[1] = s.Ocr[1];
+	c.Stage.Ocr[2] = s.Ocr[2];
+	c.Stage.Mask = s.Mask;
+	c.Phase = (s.Mask & ~PWM_STAGE_TOP) ? PWM_COMMIT_COMPARE : PWM_COMMIT_TOP;
+	c.Next = Callback;
+	Callback = Commit;
+}
+
+// enable the overflow interrupt of a timer for a commit : a flag left over while it was off
+// would run the ISR at once, in the middle of a period
+template <typename Flags>
+inline void pwm_commit_enable(volatile uint8_t &TIMSKx, const uint8_t TOIEx, Flags &TIFRx, const uint8_t TOVx)
+{
+	if (!(TIMSKx & _BV(TOIEx)))
+	{
+		TIFRx = _BV(TOVx);
+		TIMSKx |= _BV(TOIEx);
+	}
+}
+
+void PWM::stagePeriod(const uint8_t Timer, const uint16_t PeriodRegister)
+{
+	pwm_staged[Timer].Top = PeriodRegister;
+	pwm_staged[Timer].Mask |= PWM_STAGE_TOP;
+}
+
+void PWM::stageDuty(const uint8_t Timer, const char ABCD_out, const uint16_t PulseWidthRegister)
+{
+	const uint8_t Channel = pwm_channel(ABCD_out);
+	if (Channel > 2)
+	{
+		return;
+	}
+	pwm_staged[Timer].Ocr[Channel] = PulseWidthRegister;
+	pwm_staged[Timer].Mask |= _BV(Channel);
+}
+
+void PWM::stageDuty(const uint8_t Timer, const char ABCD_out, const PWM_Duty Duty)
+{
+	// scaled to the staged period if there is one
+	const PWM_Stage &s = pwm_staged[Timer];
+	const uint16_t PeriodRegister = (s.Mask & PWM_STAGE_TOP) ? s.Top : pwm_period_register[Timer];
+	stageDuty(Timer, ABCD_out, pwm_scale_duty(PeriodRegister, !(pwm_dual_slope & _BV(Timer)), Duty));
+}
+
+bool PWM::committed(const uint8_t Timer)
+{
+	return pwm_commit[Timer].Phase == PWM_COMMIT_IDLE;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef PWM_DDS_H
+#define PWM_DDS_H
+
+// Direct digital synthesis
+// A PWM carrier on one output of PWM_DDS_TIMER (Timer1 by default) is the DAC. A subscriber of its
+// overflow (see PWM_Subscribe.h) runs every period: it adds the step to a 32 bit phase accumulator, reads the sample
+// at the top 8 bits of the phase from a 256 entry table in PROGMEM, and writes it to the compare register.
+// The carrier frequency is the sample rate, the output frequency is Step * CarrierHz / 2^32.
+//
+//   #include <PWM.h>
+//   #include <PWM_DDS.h>
+//   pwm_dds.begin('a', 62500);                 // OC1A, 62.5kHz carrier (TOP 255 at 16MHz), sine
+//   pwm_dds.setFrequency(440);                 // 440Hz, in steps of about 15uHz at 62.5kHz
+//   pwm_dds.setTable(pwm_dds_triangle);        // or a const uint8_t Table[256] PROGMEM of your own
+//
+// A sample 0 .. 255 is a duty cycle of Sample / 256 of the period (the pwm_q16 scaling, 0 is off). A
+// new frequency only changes the step : the phase goes on from where it is, without a discontinuity.
+// An RC low pass (or the inductance of the load) well below the carrier recovers the waveform.
+//
+// One interrupt per sample. Its cycles, instruction counts (not measured, see PWM_Profile.h to time a
+// build) : callback vector 85, subscriber table 40, phase add 28, table read 10, the 16x16 multiply of
+// the scaling with its loads and clamp 35 (~160 in software without MUL), setDuty 15. Maximum sample rate :
+//   ATmega328p, ATmega32u4 at 16MHz (MUL)    : ~215 cycles, 74kHz at 100% of the CPU, 37kHz at 50%
+//   ATtinyX5 at 8MHz (no MUL, rjmp vectors)  : ~340 cycles, 23kHz at 100% of the CPU, 12kHz at 50%
+// The 62.5kHz carrier of the example takes ~84% of an ATmega.
+// A faster timer clock (PWM::setClock) raises the duty cycle resolution at a given carrier, not the sample rate.
+// PWM_DDS_TIMER cannot be dithered, its overflow is shared with the other subscribers. With
+// PWM_ISR_STATIC, bind the vector yourself, e.g. PWM_ISR(TIMER1_OVF_vect, pwm_dds_sample).
+
+#include <PWM.h>
+
+#ifndef PWM_DDS_TIMER
+#define PWM_DDS_TIMER 1
+#endif
+
+static_assert((PWM_DDS_TIMER != 0) & (pwm_timer_max(PWM_DDS_TIMER) != 0), "PWM_DDS_TIMER : Timer0 (millis) or no such timer");
+#if defined(PWM_DITHER_FAST)
+static_assert(!pwm_dither_timer(PWM_DDS_TIMER), "PWM_DDS_TIMER : its overflow ISR is the PWM_DITHER_FAST one");
+#endif
+
+// 127.5 + 127.5 * sin(2 pi i / 256)
+const uint8_t pwm_dds_sine[256] PROGMEM = {
+	128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+	176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+	218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+	245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+	255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+	245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+	218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+	176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+	128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+	 79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+	 37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+	 10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+	  0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+	 10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+	 37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+	 79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+};
+const uint8_t pwm_dds_triangle[256] PROGMEM = {
+	  0,   2,   4,   6,   8,  10,  12,  14,  16,  18,  20,  22,  24,  26,  28,  30,
+	 32,  34,  36,  38,  40,  42,  44,  46,  48,  50,  52,  54,  56,  58,  60,  62,
+	 64,  66,  68,  70,  72,  74,  76,  78,  80,  82,  84,  86,  88,  90,  92,  94,
+	 96,  98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+	128, 130, 132, 134, 136, 138, 140, 142, 144, 146, 148, 150, 152, 154, 156, 158,
+	160, 162, 164, 166, 168, 170, 172, 174, 176, 178, 180, 182, 184, 186, 188, 190,
+	192, 194, 196, 198, 200, 202, 204, 206, 208, 210, 212, 214, 216, 218, 220, 222,
+	224, 226, 228, 230, 232, 234, 236, 238, 240, 242, 244, 246, 248, 250, 252, 254,
+	255, 253, 251, 249, 247, 245, 243, 241, 239, 237, 235, 233, 231, 229, 227, 225,
+	223, 221, 219, 217, 215, 213, 211, 209, 207, 205, 203, 201, 199, 197, 195, 193,
+	191, 189, 187, 185, 183, 181, 179, 177, 175, 173, 171, 169, 167, 165, 163, 161,
+	159, 157, 155, 153, 151, 149, 147, 145, 143, 141, 139, 137, 135, 133, 131, 129,
+	127, 125, 123, 121, 119, 117, 115, 113, 111, 109, 107, 105, 103, 101,  99,  97,
+	 95,  93,  91,  89,  87,  85,  83,  81,  79,  77,  75,  73,  71,  69,  67,  65,
+	 63,  61,  59,  57,  55,  53,  51,  49,  47,  45,  43,  41,  39,  37,  35,  33,
+	 31,  29,  27,  25,  23,  21,  19,  17,  15,  13,  11,   9,   7,   5,   3,   1,
+};
+
+volatile uint32_t pwm_dds_step = 0;
+uint32_t pwm_dds_phase = 0;             // ISR only, once started
+const uint8_t *volatile pwm_dds_table = pwm_dds_sine;
+uint16_t pwm_dds_top = 0;
+bool pwm_dds_single_slope = true;
+char pwm_dds_out = 'a';
+
+// one sample, the overflow subscriber of PWM_DDS_TIMER
+void pwm_dds_sample(void * = 0)
+{
+	const uint32_t Phase = pwm_dds_phase + pwm_dds_step;
+	pwm_dds_phase = Phase;
+	const uint8_t Sample = pgm_read_byte(pwm_dds_table + (uint8_t)(Phase >> 24));
+	PWM::setDuty(PWM_DDS_TIMER, pwm_dds_out, pwm_scale_duty(pwm_dds_top, pwm_dds_single_slope, pwm_q16((uint16_t)Sample << 8)));
+}
+
+class PWM_DDS {
+protected:
+	uint32_t SampleNumerator = 1;   // sample rate = SampleNumerator / SampleDenominator Hz
+	uint32_t SampleDenominator = 1;
+	bool Running = false;
+
+public:
+	// carrier (the sample rate) on ABCD_out of PWM_DDS_TIMER, closest to CarrierHz, started at once (pwm.start(PWM_DDS_TIMER))
+	// the output starts at 0Hz (Table[0]). Mode : PWM_FAST, or a dual slope mode (half the carrier for the same TOP)
+	PWM_Result begin(const char ABCD_out, const uint32_t CarrierHz, const uint8_t *Table = pwm_dds_sine, const PWM_Mode Mode = PWM_FAST);
+	// stop the samples, the carrier keeps the last duty cycle
+	void end();
+	// false : not begun, or the subscriber table of the overflow was full (the carrier runs, no sample)
+	bool running() const { return Running; }
+	// phase continuous, FrequencyHz below half the sample rate (clamped there), returns the step
+	uint32_t setFrequency(const uint32_t FrequencyHz);
+	// phase increment per sample : output frequency = Step * sample rate / 2^32
+	void setStep(const uint32_t Step);
+	// 256 samples in PROGMEM, from the next sample on
+	void setTable(const uint8_t *Table) { pwm_dds_table = Table; }
+	// the accumulator, e.g. 0x40000000 : a quarter of a period ahead
+	void setPhase(const uint32_t Phase);
+};
+
+PWM_Result PWM_DDS::begin(const char ABCD_out, const uint32_t CarrierHz, const uint8_t *Table, const PWM_Mode Mode)
+{
+	end();
+	const PWM_Result Result = pwm.set(PWM_DDS_TIMER, ABCD_out, CarrierHz, pwm_q16((uint16_t)pgm_read_byte(Table) << 8), false, false, Mode);
+	SampleNumerator = Result.FrequencyNumerator;
+	SampleDenominator = Result.FrequencyDenominator;
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dds_top = Result.PeriodRegister;
+	pwm_dds_single_slope = (pwm_mode(PWM_DDS_TIMER, Mode) == PWM_FAST);
+	pwm_dds_out = ABCD_out;
+	pwm_dds_table = Table;
+	pwm_dds_step = 0;
+	pwm_dds_phase = 0;
+	SREG = sreg;
+	Running = pwm.subscribe(PWM_DDS_TIMER, 'o', pwm_dds_sample, 0);
+	pwm.start(PWM_DDS_TIMER);
+	return Result;
+}
+
+void PWM_DDS::end()
+{
+	if (Running)
+	{
+		pwm.unsubscribe(PWM_DDS_TIMER, 'o', pwm_dds_sample, 0);
+		Running = false;
+	}
+}
+
+uint32_t PWM_DDS::setFrequency(const uint32_t FrequencyHz)
+{
+	// Step = 2^32 * FrequencyHz * Den / Num : the 32 bits of the fraction FrequencyHz * Den / Num (below 1/2)
+	uint32_t Step = 0x80000000UL;
+	if (FrequencyHz < (SampleNumerator / 2) / SampleDenominator)
+	{
+		uint32_t Remainder = FrequencyHz * SampleDenominator;
+		Step = 0;
+		for (uint8_t i = 0; i < 32; ++i)
+		{
+			Remainder <<= 1;
+			Step <<= 1;
+			if (Remainder >= SampleNumerator)
+			{
+				Remainder -= SampleNumerator;
+				Step |= 1;
+			}
+		}
+		// rounded to nearest
+		Step += (2 * Remainder >= SampleNumerator);
+	}
+	setStep(Step);
+	return Step;
+}
+
+void PWM_DDS::setStep(const uint32_t Step)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dds_step = Step;
+	SREG = sreg;
+}
+
+void PWM_DDS::setPhase(const uint32_t Phase)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_dds_phase = Phase;
+	SREG = sreg;
+}
+
+PWM_DDS pwm_dds;
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef PWM_Decimate_H
+#define PWM_Decimate_H
+
+// Overflow decimation (define PWM_DECIMATE before including PWM.h)
+// attachInterrupt(Timer, 'o', ...) puts a down counter in front of the callback : it is called only
+// every Nth period, the others return from the counter :
+//
+//   pwm.set(1, 'a', 80000, pwm_q16(0x8000));  // 80kHz carrier
+//   pwm.attachInterrupt(1, 'o', control);     // control() at 4kHz :
+//   pwm_decimate(1, 20);
+//   pwm_decimate(2, 20, 10);                  // Timer2 : 10 periods later (pwm.start() synchronises the timers)
+//
+// Only the attached callback is decimated : the overflow helpers (period dither, commit(), PWM_Stream.h,
+// PWM_Fade.h, PWM_DDS.h, the subscribers) still run every period.
+// The overflow vectors are naked (PWM_DECIMATE_ISR). While the decimated callback is the only one of the
+// vector (pwm_interruptN is pwm_decimatedN) the prologue counts the periods down itself and jumps to a
+// signal handler that calls the callback on the Nth one. A skipped period then costs 35 cycles (34 on the
+// ATtinyX5) : interrupt response, push r24 and SREG, the callback test, the down count, reti (instruction
+// count). While a helper shares the vector the prologue jumps to the usual callback dispatch after the
+// test (18 to 22 cycles more than a plain vector), pwm_decimatedN counts down there.
+// With PWM_PROFILE the vectors stay the profiled C ones. They are not emitted with PWM_ISR_STATIC : bind
+// PWM_DECIMATE_ISR(TIMER1_OVF_vect, 1), or PWM_ISR_CALLBACK(TIMER1_OVF_vect, pwm_interrupt1) for the C path.
+
+struct PWM_Decimation
+{
+	uint8_t Count;  // periods to the next call
+	uint8_t Reload; // N, 0 : 256
+	void(*Callback)();
+};
+
+volatile PWM_Decimation pwm_decimation[5] = {
+	{ 1, 1, pwm_empty_interrupt }, { 1, 1, pwm_empty_interrupt }, { 1, 1, pwm_empty_interrupt },
+	{ 1, 1, pwm_empty_interrupt }, { 1, 1, pwm_empty_interrupt } };
+
+// the overflow callback of Timer every Periods periods (1 .. 256), the first on the (Phase + 1)th
+// overflow from now, Phase 0 .. Periods - 1
+inline void pwm_decimate(const uint8_t Timer, const uint16_t Periods, const uint8_t Phase = 0)
+{
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_decimation[Timer].Reload = (uint8_t)Periods;
+	pwm_decimation[Timer].Count = Phase + 1;
+	SREG = sreg;
+}
+
+// the down counter of Timer (pwm_decimatedN, the overflow callback while one is attached)
+inline void pwm_decimate_step(const uint8_t Timer)
+{
+	volatile PWM_Decimation &d = pwm_decimation[Timer];
+	const uint8_t Count = d.Count - 1;
+	if (Count)
+	{
+		d.Count = Count;
+		return;
+	}
+	d.Count = d.Reload;
+	d.Callback();
+}
+
+#if defined(__AVR__)
+// push r24, SREG / pwm_interruptN is not pwm_decimatedN : pop, jump to the callback dispatch / Count -= 1,
+// not 0 : store, pop, reti / 0 : Count = Reload, pop, jump to the caller of the decimated callback
+// (signal handlers : full prologue, reti)
+#define PWM_DECIMATE_ISR(vector, Timer) \
+extern "C" void __vector_pwm_decimated##Timer(void) __attribute__((signal, used, externally_visible)); \
+void __vector_pwm_decimated##Timer(void) { pwm_decimation[Timer].Callback(); } \
+extern "C" void __vector_pwm_overflow##Timer(void) __attribute__((signal, used, externally_visible)); \
+void __vector_pwm_overflow##Timer(void) { pwm_interrupt##Timer(); } \
+ISR(vector, ISR_NAKED) \
+{ \
+	asm volatile( \
+		"push r24"             "\n\t" \
+		"in   r24, __SREG__"   "\n\t" \
+		"push r24"             "\n\t" \
+		"lds  r24, %[isr]"     "\n\t" \
+		"cpi  r24, lo8(%[fn])" "\n\t" \
+		"brne 2f"              "\n\t" \
+		"lds  r24, %[isr]+1"   "\n\t" \
+		"cpi  r24, hi8(%[fn])" "\n\t" \
+		"brne 2f"              "\n\t" \
+		"lds  r24, %[count]"   "\n\t" \
+		"subi r24, 1"          "\n\t" \
+		"breq 1f"              "\n\t" \
+		"sts  %[count], r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"out  __SREG__, r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"reti"                 "\n\t" \
+		"1:"                   "\n\t" \
+		"lds  r24, %[reload]"  "\n\t" \
+		"sts  %[count], r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"out  __SREG__, r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"%~jmp __vector_pwm_decimated" #Timer "\n\t" \
+		"2:"                   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"out  __SREG__, r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"%~jmp __vector_pwm_overflow" #Timer "\n\t" \
+		:: [isr] "i" (&pwm_interrupt##Timer), [fn] "i" (&pwm_decimated##Timer), \
+		   [count] "i" (&pwm_decimation[Timer].Count), [reload] "i" (&pwm_decimation[Timer].Reload)); \
+}
+#else
+// the same down count, through the callback
+#define PWM_DECIMATE_ISR(vector, Timer) ISR(vector) { pwm_interrupt##Timer(); }
+#endif
+
+#endif
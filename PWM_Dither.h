@@ -0,0 +1,125 @@
+#ifndef PWM_Dither_H
+#define PWM_Dither_H
+
+// Fractional period dithering
+// The period count base_clock / (PS * FrequencyHz) is rarely a whole number. The whole part
+// is written to the TOP register and the fraction (PeriodFraction / 65536) is accumulated once
+// per period by the overflow ISR. When the accumulator carries, that period is one count longer :
+//
+//   TOP = PeriodRegister + carry(acc += PeriodFraction)
+//
+// so the average period is PeriodRegister + 1 + PeriodFraction / 65536 counts (first order
+// sigma-delta, the long and short periods are spread as evenly as possible).
+// Enabled per timer with pwm.set(Timer, ABCD_out, FrequencyHz, DutyCycle_Divisor, invertOut, true)
+//
+// In fast PWM the overflow flag is set at TOP, and ICRx (ATmega Timer1/3) and OCR1C (ATtinyX5) are
+// not double buffered : the ISR writes the TOP the counter is at. Once the counter has moved on that
+// is the next period, while it still reads TOP a shorter period loses its pulse (TOP below TCNTx,
+// the counter runs on to MAX). solve_dither only dithers these timers with a count of 32 CPU cycles
+// or less (PS 1 or 8 on the ATmega, up to 32 at the CPU clock on the ATtinyX5), the TOP store comes
+// later than that (41 cycles at the earliest, see the instruction count below). Below ~31Hz on a 16b timer at 16MHz, set() then returns the nearest whole period
+// (PeriodFraction 0). OCR4C (ATmega32u4 Timer4) is buffered and the dual slope modes take TOVx at
+// BOTTOM : any prescalar.
+//
+// The ISR is constant time (no branches). By default it runs through the overflow callback
+// (pwm_interruptN, the same as attachInterrupt(Timer, 'o', ...)), which costs the full register
+// save of a function call. Define PWM_DITHER_FAST to replace the overflow ISR of the dither timers
+// with a hand written one, which leaves most of the CPU (and millis()) free at a 100kHz+ carrier.
+// Its instruction count, interrupt response and reti included : 58 cycles with a 16b or 10b TOP, 56
+// with an 8b one (55 on the ATtinyX5, rjmp vectors), the first TOP store 41 cycles after the flag.
+// The overflow callback of these timers is then not available.
+
+struct PWM_Dither
+{
+	uint16_t top;  // PeriodRegister
+	uint16_t frac; // PeriodFraction
+	uint16_t acc;  // sigma-delta accumulator
+};
+
+volatile PWM_Dither pwm_dither[5];
+
+// one period of the ditherer, called from the overflow ISR of Timer
+template <typename Register>
+inline void pwm_dither_step(volatile PWM_Dither &d, volatile Register &TopRegister)
+{
+	const uint16_t acc = d.acc;
+	const uint16_t sum = acc + d.frac;
+	d.acc = sum;
+	// carry out of the accumulator : one more count this period
+	TopRegister = d.top + (sum < acc);
+}
+
+#if defined(__AVR__)
+// push r24, SREG, r25-r27 / acc += frac / TOP = top + carry / pop, reti
+// lds, sts and ldi leave the carry of the accumulator untouched
+#define PWM_DITHER_ISR_ENTER \
+		"push r24"             "\n\t" \
+		"in   r24, __SREG__"   "\n\t" \
+		"push r24"             "\n\t" \
+		"push r25"             "\n\t" \
+		"push r26"             "\n\t" \
+		"push r27"             "\n\t" \
+		"lds  r24, %[acc]"     "\n\t" \
+		"lds  r25, %[acc]+1"   "\n\t" \
+		"lds  r26, %[frac]"    "\n\t" \
+		"lds  r27, %[frac]+1"  "\n\t" \
+		"add  r24, r26"        "\n\t" \
+		"adc  r25, r27"        "\n\t" \
+		"sts  %[acc]+1, r25"   "\n\t" \
+		"sts  %[acc], r24"     "\n\t" \
+		"lds  r24, %[top]"     "\n\t" \
+		"lds  r25, %[top]+1"   "\n\t" \
+		"ldi  r26, 0"          "\n\t" \
+		"adc  r24, r26"        "\n\t" \
+		"adc  r25, r26"        "\n\t"
+#define PWM_DITHER_ISR_EXIT \
+		"pop  r27"             "\n\t" \
+		"pop  r26"             "\n\t" \
+		"pop  r25"             "\n\t" \
+		"pop  r24"             "\n\t" \
+		"out  __SREG__, r24"   "\n\t" \
+		"pop  r24"             "\n\t" \
+		"reti"                 "\n\t"
+#define PWM_DITHER_ISR_OPERANDS(Timer, TopRegister) \
+		: [acc] "i" (&pwm_dither[Timer].acc), [frac] "i" (&pwm_dither[Timer].frac), \
+		  [top] "i" (&pwm_dither[Timer].top), [reg] "n" (_SFR_MEM_ADDR(TopRegister))
+
+// 16b TOP register (ICRx), high byte first
+#define PWM_DITHER_ISR16(vector, Timer, TopRegister) \
+ISR(vector, ISR_NAKED) \
+{ \
+	asm volatile( \
+		PWM_DITHER_ISR_ENTER \
+		"sts  %[reg]+1, r25"   "\n\t" \
+		"sts  %[reg], r24"     "\n\t" \
+		PWM_DITHER_ISR_EXIT \
+		:: PWM_DITHER_ISR_OPERANDS(Timer, TopRegister)); \
+}
+// 8b TOP register (OCR1C on the ATtinyX5)
+#define PWM_DITHER_ISR8(vector, Timer, TopRegister) \
+ISR(vector, ISR_NAKED) \
+{ \
+	asm volatile( \
+		PWM_DITHER_ISR_ENTER \
+		"sts  %[reg], r24"     "\n\t" \
+		PWM_DITHER_ISR_EXIT \
+		:: PWM_DITHER_ISR_OPERANDS(Timer, TopRegister)); \
+}
+// 10b TOP register (OCR4C on the ATmega32u4), bits 9:8 through HighRegister (TC4H) first
+#define PWM_DITHER_ISR10(vector, Timer, TopRegister, HighRegister) \
+ISR(vector, ISR_NAKED) \
+{ \
+	asm volatile( \
+		PWM_DITHER_ISR_ENTER \
+		"sts  %[high], r25"    "\n\t" \
+		"sts  %[reg], r24"     "\n\t" \
+		PWM_DITHER_ISR_EXIT \
+		:: PWM_DITHER_ISR_OPERANDS(Timer, TopRegister), [high] "n" (_SFR_MEM_ADDR(HighRegister))); \
+}
+#else
+#define PWM_DITHER_ISR16(vector, Timer, TopRegister) ISR(vector) { pwm_dither_step(pwm_dither[Timer], TopRegister); }
+#define PWM_DITHER_ISR8(vector, Timer, TopRegister) ISR(vector) { pwm_dither_step(pwm_dither[Timer], TopRegister); }
+#define PWM_DITHER_ISR10(vector, Timer, TopRegister, HighRegister) ISR(vector) { auto Top = pwm_register10(TopRegister); pwm_dither_step(pwm_dither[Timer], Top); }
+#endif
+
+#endif
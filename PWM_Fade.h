@@ -0,0 +1,334 @@
+#ifndef PWM_Fade_H
+#define PWM_Fade_H
+
+// Duty cycle ramps, timed by the overflow of the output's timer
+// A channel is an output set() has configured. to() ramps it from where it is to a target in a number
+// of PWM periods, a subscriber of the timer's overflow moves every ramping channel of that timer one
+// step per period. The slope is computed once by to() : a Q16.16 step, added to a Q16.16 position.
+//   PWM_FADE_LINEAR      : the position is the compare register, each period is one add and one store
+//   PWM_FADE_EXPONENTIAL : the position indexes a 256 entry PROGMEM curve of Q0.16 duty cycles, scaled
+//   PWM_FADE_GAMMA         to the period of the last set() (one add, one table read, one multiply, one store)
+//   begin(..., Table)    : a const uint16_t Table[256] PROGMEM of your own, the same way
+// Through a curve the target (and the start of begin()) is the curve input : pwm_q16(0x8000) is half way
+// along the curve, e.g. 22% of the period for PWM_FADE_GAMMA.
+//
+//   #include <PWM.h>
+//   #include <PWM_Fade.h>
+//   pwm.set(1, 'a', 1000, pwm_q16(0));
+//   pwm.start();
+//   pwm_fade.begin(1, 'a', PWM_FADE_GAMMA);           // after pwm.start(), which stops the timers
+//   pwm_fade.to(1, 'a', pwm_q16(0xFFFF), 2000, Done); // 2s to full brightness at 1kHz, Done() from the ISR
+//
+// Up to PWM_FADE_CHANNELS channels (default 4), over any timers but Timer0 (millis()). A period visits
+// every channel of the table, ramping or not : the cost is bounded by the table size whatever ramps,
+// the curves at most. By instruction count (not measured, see PWM_Profile.h to time a build), a period is
+// 145 cycles (callback vector 85, subscriber table 40, the call and saved registers 20) and per channel :
+// idle 15, linear 85 (Q16.16 add 14, stores 12, count 9, setDuty 30 on the timer and output of the
+// channel, loop 20), curve 135 (table read 15, the scaling multiply 35, ~160 without MUL). The stores land in the double buffered compare registers, the new duty cycle
+// starts with the next period. The last step writes the target exactly, then the completion callback
+// runs (in the ISR, keep it short). Each timer with a channel has its overflow
+// subscribed to (see PWM_Subscribe.h) : shared with PWM_Stream.h, PWM_DDS.h ... on the same timer, no
+// period dither. With PWM_ISR_STATIC, bind the vectors yourself, e.g. PWM_ISR(TIMER1_OVF_vect, pwm_fade_period<1>).
+
+#include <PWM.h>
+
+#ifndef PWM_FADE_CHANNELS
+#define PWM_FADE_CHANNELS 4
+#endif
+
+enum PWM_FadeProfile : uint8_t
+{
+	PWM_FADE_LINEAR = 0,
+	PWM_FADE_EXPONENTIAL = 1,
+	PWM_FADE_GAMMA = 2
+};
+
+// 65535 * (2^(8 i / 255) - 1) / 255, about even steps of perceived brightness
+const uint16_t pwm_fade_exponential[256] PROGMEM = {
+	    0,     6,    11,    17,    23,    30,    36,    42,    49,    56,    62,    69,    77,    84,    91,    99,
+	  107,   115,   123,   131,   140,   149,   158,   167,   176,   186,   195,   205,   215,   226,   236,   247,
+	  258,   270,   281,   293,   305,   318,   330,   343,   356,   370,   384,   398,   412,   427,   442,   457,
+	  473,   489,   505,   522,   539,   557,   575,   593,   612,   631,   650,   670,   690,   711,   733,   754,
+	  777,   799,   823,   846,   871,   895,   921,   947,   973,  1000,  1028,  1056,  1085,  1114,  1144,  1175,
+	 1207,  1239,  1272,  1305,  1340,  1375,  1411,  1447,  1485,  1523,  1562,  1602,  1643,  1685,  1728,  1771,
+	 1816,  1861,  1908,  1956,  2004,  2054,  2105,  2157,  2210,  2264,  2319,  2376,  2434,  2493,  2553,  2615,
+	 2678,  2743,  2809,  2876,  2945,  3016,  3088,  3161,  3236,  3313,  3391,  3472,  3554,  3637,  3723,  3811,
+	 3900,  3991,  4085,  4180,  4278,  4377,  4479,  4583,  4690,  4799,  4910,  5023,  5139,  5258,  5379,  5503,
+	 5630,  5759,  5891,  6027,  6165,  6306,  6450,  6598,  6748,  6902,  7060,  7221,  7385,  7553,  7725,  7900,
+	 8080,  8263,  8450,  8642,  8837,  9037,  9241,  9450,  9664,  9882, 10105, 10332, 10565, 10803, 11046, 11295,
+	11549, 11808, 12073, 12345, 12622, 12905, 13194, 13490, 13792, 14101, 14416, 14739, 15069, 15406, 15750, 16102,
+	16461, 16829, 17205, 17588, 17981, 18382, 18791, 19210, 19638, 20076, 20523, 20979, 21446, 21923, 22411, 22909,
+	23419, 23939, 24471, 25015, 25570, 26138, 26718, 27311, 27917, 28537, 29170, 29817, 30478, 31153, 31844, 32550,
+	33271, 34008, 34761, 35531, 36318, 37122, 37944, 38783, 39642, 40519, 41415, 42331, 43268, 44225, 45202, 46202,
+	47223, 48267, 49334, 50424, 51538, 52677, 53840, 55030, 56245, 57487, 58757, 60054, 61380, 62735, 64120, 65535,
+};
+// 65535 * (i / 255)^2.2
+const uint16_t pwm_fade_gamma[256] PROGMEM = {
+	    0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,    79,    94,   111,   129,
+	  148,   169,   192,   216,   242,   270,   299,   330,   362,   396,   432,   469,   508,   549,   591,   635,
+	  681,   729,   779,   830,   883,   938,   995,  1053,  1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+	 1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,  2334,  2427,  2521,  2618,  2717,  2817,  2920,  3024,
+	 3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,  4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,
+	 5115,  5257,  5401,  5547,  5695,  5845,  5998,  6152,  6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+	 7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,  9111,  9305,  9501,  9699,  9900, 10102, 10307, 10515,
+	10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254, 12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140,
+	14386, 14635, 14885, 15138, 15394, 15652, 15912, 16174, 16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+	18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694, 20996, 21301, 21609, 21919, 22231, 22546, 22863, 23182,
+	23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826, 26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627,
+	28988, 29351, 29717, 30086, 30457, 30830, 31206, 31585, 31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+	35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981, 38402, 38825, 39252, 39680, 40112, 40546, 40982, 41421,
+	41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025, 45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793,
+	49275, 49761, 50249, 50739, 51232, 51728, 52226, 52727, 53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+	57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097, 61642, 62190, 62741, 63295, 63851, 64410, 64971, 65535,
+};
+
+struct PWM_FadeChannel
+{
+	uint8_t Timer;          // 0 : free
+	char Out;
+	const uint16_t *Table;  // 0 : linear, the position is the compare register
+	uint16_t Top;           // PeriodRegister of the curve scaling
+	bool SingleSlope;
+	uint32_t Position;      // Q16.16 : compare register or curve index (0 .. 255)
+	uint32_t Step;          // Q16.16, two's complement for a falling ramp
+	uint32_t End;           // Position of the last step
+	uint16_t Count;         // periods left, 0 : idle
+	void (*Done)();
+};
+
+PWM_FadeChannel pwm_fade_channel[PWM_FADE_CHANNELS];
+
+// one period of Timer : a step of each of its ramping channels
+void pwm_fade_run(const uint8_t Timer)
+{
+	for (uint8_t i = 0; i < PWM_FADE_CHANNELS; ++i)
+	{
+		PWM_FadeChannel &c = pwm_fade_channel[i];
+		if ((c.Timer != Timer) | (c.Count == 0))
+		{
+			continue;
+		}
+		uint32_t Position = c.Position + c.Step;
+		const uint16_t Count = c.Count - 1;
+		if (Count == 0) { Position = c.End; }
+		c.Position = Position;
+		c.Count = Count;
+		const uint16_t Value = Position >> 16;
+		PWM::setDuty(Timer, c.Out, c.Table ? pwm_scale_duty(c.Top, c.SingleSlope, pwm_q16(pgm_read_word(c.Table + (uint8_t)Value))) : Value);
+		if ((Count == 0) && c.Done)
+		{
+			c.Done();
+		}
+	}
+}
+
+// the overflow subscriber of Timer
+template <uint8_t Timer>
+void pwm_fade_period(void * = 0)
+{
+	pwm_fade_run(Timer);
+}
+
+class PWM_Fade {
+protected:
+	typedef void (*Subscriber)(void *);
+	uint8_t Subscribed = 0; // bit Timer : its overflow is subscribed to
+
+	// slot of ABCD_out of Timer, PWM_FADE_CHANNELS if none
+	uint8_t find(const uint8_t Timer, const char ABCD_out) const;
+	// Duty as a Position of the channel : the compare register, or the curve index
+	uint32_t position(const PWM_FadeChannel &c, const PWM_Duty Duty) const;
+	// pwm_fade_period of Timer, 0 : none
+	Subscriber subscriber(const uint8_t Timer) const;
+
+public:
+	// a channel on ABCD_out of Timer (set() before), at Start at once (no ramp). false : the table (or
+	// the subscriber table of the overflow) is full, Timer0 (millis()) or no such timer
+	bool begin(const uint8_t Timer, const char ABCD_out, const PWM_FadeProfile Profile = PWM_FADE_LINEAR, const PWM_Duty Start = pwm_q16(0));
+	// through a const uint16_t Table[256] PROGMEM of Q0.16 duty cycles
+	bool begin(const uint8_t Timer, const char ABCD_out, const uint16_t *Table, const PWM_Duty Start = pwm_q16(0));
+	// free the channel, the output keeps its duty cycle. The last channel of the timer unsubscribes
+	void end(const uint8_t Timer, const char ABCD_out);
+
+	// ramp from the present position to Target in Periods PWM periods (0 : at the next period), a ramp
+	// in progress is replaced. Done (or 0) is called from the ISR after the last step
+	void to(const uint8_t Timer, const char ABCD_out, const PWM_Duty Target, const uint16_t Periods, void (*Done)() = 0);
+	// hold where the ramp is
+	void stop(const uint8_t Timer, const char ABCD_out);
+	// periods left, 0 : not ramping
+	uint16_t remaining(const uint8_t Timer, const char ABCD_out) const;
+};
+
+uint8_t PWM_Fade::find(const uint8_t Timer, const char ABCD_out) const
+{
+	for (uint8_t i = 0; i < PWM_FADE_CHANNELS; ++i)
+	{
+		if ((pwm_fade_channel[i].Timer == Timer) & (pwm_out_index(pwm_fade_channel[i].Out) == pwm_out_index(ABCD_out)))
+		{
+			return i;
+		}
+	}
+	return PWM_FADE_CHANNELS;
+}
+
+uint32_t PWM_Fade::position(const PWM_FadeChannel &c, const PWM_Duty Duty) const
+{
+	if (c.Table == 0)
+	{
+		return (uint32_t)pwm_scale_duty(c.Top, c.SingleSlope, Duty) << 16;
+	}
+	// curve input 0 .. 255
+	uint16_t Input = Duty.Value;
+	if (Duty.Kind == PWM_DUTY_DIVISOR) { Input = Duty.Value ? 0xFFFF / Duty.Value : 0; }
+	return (uint32_t)(Input >> 8) << 16;
+}
+
+PWM_Fade::Subscriber PWM_Fade::subscriber(const uint8_t Timer) const
+{
+	switch (Timer)
+	{
+	case 1:
+		return pwm_fade_period<1>;
+	#if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+	case 2:
+		return pwm_fade_period<2>;
+	#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	case 3:
+		return pwm_fade_period<3>;
+	case 4:
+		return pwm_fade_period<4>;
+	#endif
+	}
+	return 0;
+}
+
+bool PWM_Fade::begin(const uint8_t Timer, const char ABCD_out, const PWM_FadeProfile Profile, const PWM_Duty Start)
+{
+	return begin(Timer, ABCD_out, (Profile == PWM_FADE_GAMMA) ? pwm_fade_gamma : ((Profile == PWM_FADE_EXPONENTIAL) ? pwm_fade_exponential : 0), Start);
+}
+
+bool PWM_Fade::begin(const uint8_t Timer, const char ABCD_out, const uint16_t *Table, const PWM_Duty Start)
+{
+	const Subscriber Period = subscriber(Timer);
+	if ((Timer == 0) | (pwm_timer_max(Timer) == 0) | (Period == 0))
+	{
+		return false;
+	}
+	uint8_t i = find(Timer, ABCD_out);
+	if (i == PWM_FADE_CHANNELS)
+	{
+		i = find(0, 0);
+		if (i == PWM_FADE_CHANNELS)
+		{
+			return false;
+		}
+	}
+	if (!(Subscribed & _BV(Timer)))
+	{
+		if (!pwm.subscribe(Timer, 'o', Period, 0))
+		{
+			return false;
+		}
+		Subscribed |= _BV(Timer);
+	}
+	PWM_FadeChannel c;
+	c.Timer = Timer;
+	c.Out = ABCD_out;
+	c.Table = Table;
+	c.Top = pwm_period_register[Timer];
+	c.SingleSlope = !(pwm_dual_slope & _BV(Timer));
+	c.Position = position(c, Start);
+	c.Step = 0;
+	c.End = c.Position;
+	c.Count = 0;
+	c.Done = 0;
+	const uint16_t Value = c.Position >> 16;
+	PWM::setDuty(Timer, ABCD_out, Table ? pwm_scale_duty(c.Top, c.SingleSlope, pwm_q16(pgm_read_word(Table + (uint8_t)Value))) : Value);
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_fade_channel[i] = c;
+	SREG = sreg;
+	return true;
+}
+
+void PWM_Fade::end(const uint8_t Timer, const char ABCD_out)
+{
+	const uint8_t i = find(Timer, ABCD_out);
+	if (i == PWM_FADE_CHANNELS)
+	{
+		return;
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_fade_channel[i].Timer = 0;
+	pwm_fade_channel[i].Out = 0;
+	pwm_fade_channel[i].Count = 0;
+	SREG = sreg;
+	for (uint8_t j = 0; j < PWM_FADE_CHANNELS; ++j)
+	{
+		if (pwm_fade_channel[j].Timer == Timer)
+		{
+			return;
+		}
+	}
+	pwm.unsubscribe(Timer, 'o', subscriber(Timer), 0);
+	Subscribed &= ~_BV(Timer);
+}
+
+void PWM_Fade::to(const uint8_t Timer, const char ABCD_out, const PWM_Duty Target, const uint16_t Periods, void (*Done)())
+{
+	const uint8_t i = find(Timer, ABCD_out);
+	if (i == PWM_FADE_CHANNELS)
+	{
+		return;
+	}
+	PWM_FadeChannel &c = pwm_fade_channel[i];
+	const uint32_t End = position(c, Target);
+	// from where the ramp is now (a step more may go by before the new one is in), the division with
+	// the interrupts on
+	const uint8_t sreg = SREG;
+	cli();
+	const uint32_t Position = c.Position;
+	SREG = sreg;
+	const uint16_t Count = Periods ? Periods : 1;
+	const uint32_t Magnitude = ((End >= Position) ? End - Position : Position - End) / Count;
+	const uint32_t Step = (End >= Position) ? Magnitude : 0 - Magnitude;
+	cli();
+	c.Step = Step;
+	c.End = End;
+	c.Done = Done;
+	c.Count = Count;
+	SREG = sreg;
+}
+
+void PWM_Fade::stop(const uint8_t Timer, const char ABCD_out)
+{
+	const uint8_t i = find(Timer, ABCD_out);
+	if (i == PWM_FADE_CHANNELS)
+	{
+		return;
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_fade_channel[i].Count = 0;
+	SREG = sreg;
+}
+
+uint16_t PWM_Fade::remaining(const uint8_t Timer, const char ABCD_out) const
+{
+	const uint8_t i = find(Timer, ABCD_out);
+	if (i == PWM_FADE_CHANNELS)
+	{
+		return 0;
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t Count = pwm_fade_channel[i].Count;
+	SREG = sreg;
+	return Count;
+}
+
+PWM_Fade pwm_fade;
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef PWM_Long_H
+#define PWM_Long_H
+
+// Long periods (0.1s to hours) on the outputs of PWM_LONG_TIMER (Timer1), for time proportioning loops
+// (heaters, valves). set() takes the period in milliseconds and picks the way it is made :
+//  * the hardware PWM of the timer (PWM_FAST) when a prescalar can count it, as PWM::apply() sets it
+//  * else overflow counting : the timer counts freely at its largest prescalar and each output has a
+//    32 bit period in ticks. The compare register of the output hops ahead by a whole counter wrap
+//    (the software overflow count) until the next edge is less than a wrap away, then lands on it.
+//    The edge itself is made by the compare output (COM1x set or clear at the match), not by the ISR :
+//    it is as exact as a hardware PWM edge, the ISR only has to arm the next one before it comes.
+//
+//   #include <PWM.h>
+//   #include <PWM_Long.h>
+//   pwm_long.set('a', 10000, pwm_q16(0x4000));   // OC1A, 10s period, 2.5s high
+//   pwm_long.setDuty('a', pwm_q16(0xC000));      // a period or two later (see below)
+//
+// Lowest hardware PWM frequency at 16MHz (Timer1, 16b, /1024) : 0.24Hz, an ATtinyX5 at 8MHz (Timer1,
+// 8b, /16384) : 1.9Hz. Below that one interrupt per output every 65536 ticks (~4.2s at 16MHz) or 256
+// (~0.5s on an ATtinyX5), plus two at each edge. A duty cycle is taken when the start of a period is
+// armed, up to a wrap ahead : it shows from the first period starting a wrap after setDuty() at the latest.
+// The tick (64us at 16MHz) is its resolution, pulses shorter than pwm_long_guard ticks are
+// lengthened to it (0 and the full period excepted). Both outputs share the timer and the period, set()
+// restarts them both. Timer1 cannot be used by pwm.set(), PWM_Soft.h or PWM_BAM.h at the same time.
+// The compare ISRs subscribe to the compare vectors of Timer1 (see PWM_Subscribe.h). With PWM_ISR_STATIC,
+// bind them yourself, e.g. PWM_ISR(TIMER1_COMPA_vect, pwm_long_match<0>).
+
+#include <PWM.h>
+
+#if !defined(PWM_LONG_TIMER)
+#error "PWM_Long.h : no long period timebase on this chip"
+#endif
+
+// cycles of the match ISR, vector included, the guard of an edge is that many ticks and 2. The default
+// is an instruction count of the longest path (not measured) : callback vector 85, subscriber table 40,
+// edge loads and stores 28, next edge and step 51, output level and action 34, compare register 21,
+// saved registers 24. Max of PWM_PROFILE_T1A plus the 74 cycles around the handler is that of a build
+#ifndef PWM_LONG_ISR_CYCLES
+#define PWM_LONG_ISR_CYCLES 283
+#endif
+#define PWM_LONG_WRAP (1UL << PWM_LONG_BITS)
+
+struct PWM_LongEdge
+{
+	uint32_t Width;     // ticks high, staged for the next period
+	uint32_t High;      // ticks high in this period
+	uint32_t Remaining; // ticks from the last match to the next edge, 0 : the match armed is the edge
+	uint16_t Position;  // compare register (counter ticks modulo the wrap)
+	bool Start;         // the next edge starts a period
+};
+
+volatile PWM_LongEdge pwm_long_edge[2];
+uint32_t pwm_long_period = 0; // ticks
+uint16_t pwm_long_guard = 2;  // shortest step after a match, in ticks
+
+// compare match of output Out (0 : OC1A, 1 : OC1B), a subscriber of its vector
+template <uint8_t Out>
+void pwm_long_match(void * = 0)
+{
+	volatile PWM_LongEdge &e = pwm_long_edge[Out];
+	const uint32_t Period = pwm_long_period;
+	uint32_t Remaining = e.Remaining;
+	bool Start = e.Start;
+	if (Remaining == 0)
+	{
+		// the edge went out at this match
+		if (Start)
+		{
+			const uint32_t High = e.High;
+			if ((High != 0) & (High < Period))
+			{
+				Start = false;
+				Remaining = High;
+			}
+			else
+			{
+				// 0% or 100% : no falling edge
+				Remaining = Period;
+			}
+		}
+		else
+		{
+			Start = true;
+			Remaining = Period - e.High;
+		}
+	}
+
+	// hop by a whole wrap (the match comes back at the same register value), half a wrap when the rest
+	// would be too short to arm, else land on the edge
+	uint32_t Step = Remaining;
+	if (Remaining > PWM_LONG_WRAP + pwm_long_guard)
+	{
+		Step = PWM_LONG_WRAP;
+	}
+	else if (Remaining > PWM_LONG_WRAP)
+	{
+		Step = PWM_LONG_WRAP / 2;
+	}
+	Remaining -= Step;
+
+	bool Action;
+	if (Remaining != 0)
+	{
+		// no edge : the match drives the level the output already has
+		Action = Start ? (e.High >= Period) : true;
+	}
+	else if (Start)
+	{
+		const uint32_t Width = e.Width;
+		e.High = Width;
+		Action = (Width != 0);
+	}
+	else
+	{
+		Action = false;
+	}
+	pwm_long_action(Out, Action);
+	if (Step != PWM_LONG_WRAP)
+	{
+		const uint16_t Position = (uint16_t)((e.Position + Step) & (PWM_LONG_WRAP - 1));
+		e.Position = Position;
+		PWM::setDuty(PWM_LONG_TIMER, Out ? 'b' : 'a', Position);
+	}
+	e.Remaining = Remaining;
+	e.Start = Start;
+}
+
+class PWM_Long {
+protected:
+	PWM_Duty Duty[2] = { { 0, PWM_DUTY_TICKS }, { 0, PWM_DUTY_TICKS } };
+	uint8_t Outputs = 0;    // bit 0 : 'a', bit 1 : 'b'
+	uint8_t Subscribed = 0; // the compare vectors subscribed to, same bits
+	bool Extended = false;
+	uint8_t CSx3210 = 0;
+	uint32_t Ticks = 0;
+
+	// Duty of the period in ticks, out of the guard band
+	uint32_t width(const PWM_Duty Duty) const;
+	// unsubscribe the compare ISRs
+	void release();
+
+public:
+	// PeriodMs on ABCD_out ('a' or 'b') of PWM_LONG_TIMER, started at once. An output set before keeps
+	// its duty cycle (scaled to the new period), both restart. false : no such output or no period, or
+	// a compare vector has no subscriber entry left (overflow counting)
+	bool set(const char ABCD_out, const uint32_t PeriodMs, const PWM_Duty Duty);
+	// pwm_q16(Fraction) or pwm_divisor(DutyCycle_Divisor) of the period, pwm_ticks(Ticks) of the timer
+	// from the next period armed on (with hardware PWM : at the next overflow)
+	void setDuty(const char ABCD_out, const PWM_Duty Duty);
+	// stop the timer, the outputs stay where they are
+	void end();
+
+	// true : overflow counting, false : hardware PWM
+	bool extended() const { return Extended; }
+	// period in timer ticks, of prescalar() timer clocks (see PWM::setClock)
+	uint32_t period() const { return Ticks; }
+	uint16_t prescalar() const { return pwm_prescaler(PWM_LONG_TIMER, CSx3210); }
+};
+
+uint32_t PWM_Long::width(const PWM_Duty Duty) const
+{
+	uint32_t Width;
+	if (Duty.Kind == PWM_DUTY_Q16)
+	{
+		// Ticks * Fraction / 65536 in 32 bits
+		Width = (Ticks >> 16) * Duty.Value + (((Ticks & 0xFFFF) * Duty.Value) >> 16);
+	}
+	else if (Duty.Kind == PWM_DUTY_TICKS)
+	{
+		Width = Duty.Value;
+	}
+	else
+	{
+		Width = Duty.Value ? Ticks / Duty.Value : 0;
+	}
+	if (Width >= Ticks)
+	{
+		return Ticks;
+	}
+	if ((Width != 0) & (Width < pwm_long_guard))
+	{
+		return pwm_long_guard;
+	}
+	if ((Width != 0) & (Width > Ticks - pwm_long_guard))
+	{
+		return Ticks - pwm_long_guard;
+	}
+	return Width;
+}
+
+bool PWM_Long::set(const char ABCD_out, const uint32_t PeriodMs, const PWM_Duty Duty)
+{
+	const uint8_t Out = pwm_out_index(ABCD_out);
+	if ((Out > 1) | (PeriodMs == 0))
+	{
+		return false;
+	}
+	this->Duty[Out] = Duty;
+	Outputs |= _BV(Out);
+
+	// PeriodMs * kHz / 2^log2PS, the milliseconds split so that the products fit in 32 bits
+	const uint32_t ClockKHz = pwm.getClock(PWM_LONG_TIMER) / 1000;
+	uint8_t CS = 1;
+	for (;; ++CS)
+	{
+		const uint8_t log2PS = pwm_prescaler_log2(PWM_LONG_TIMER, CS);
+		const uint32_t Mask = (1UL << log2PS) - 1;
+		Ticks = (PeriodMs >> log2PS) * ClockKHz + (((PeriodMs & Mask) * ClockKHz + (Mask + 1) / 2) >> log2PS);
+		if ((Ticks <= pwm_count_max(PWM_LONG_TIMER, false)) | (CS == pwm_cs_max(PWM_LONG_TIMER)))
+		{
+			break;
+		}
+	}
+	CSx3210 = CS;
+	if (Ticks < 2) { Ticks = 2; }
+	Extended = (Ticks > pwm_count_max(PWM_LONG_TIMER, false));
+
+	release();
+	if (!Extended)
+	{
+		PWM_Config Config = pwm_config_timer(PWM_LONG_TIMER, PWM_FAST, CS, (uint16_t)(Ticks - 1));
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			if (Outputs & _BV(i)) { Config = Config.output('a' + i, this->Duty[i]); }
+		}
+		pwm.apply(Config);
+		return true;
+	}
+
+	// the ISR must be done before the next match : PWM_LONG_ISR_CYCLES in ticks, and two
+	pwm_long_guard = (PWM_LONG_ISR_CYCLES >> pwm_prescaler_log2(PWM_LONG_TIMER, CS)) + 2;
+	pwm_long_period = Ticks;
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		if (Outputs & _BV(i)) { pinMode(pwm_output_pin(PWM_LONG_TIMER, i), OUTPUT); }
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		volatile PWM_LongEdge &e = pwm_long_edge[i];
+		// the first match is a guard long step with the output low, it arms the start of the first period
+		e.Width = width(this->Duty[i]);
+		e.High = 0;
+		e.Remaining = pwm_long_guard;
+		e.Position = pwm_long_guard;
+		e.Start = true;
+	}
+	pwm_long_timebase(Outputs, pwm_long_guard, CS);
+	if ((Outputs & 1) && pwm.subscribe(PWM_LONG_TIMER, 'a', pwm_long_match<0>, 0)) { Subscribed |= 1; }
+	if ((Outputs & 2) && pwm.subscribe(PWM_LONG_TIMER, 'b', pwm_long_match<1>, 0)) { Subscribed |= 2; }
+	SREG = sreg;
+	return Subscribed == Outputs;
+}
+
+void PWM_Long::release()
+{
+	if (Subscribed & 1) { pwm.unsubscribe(PWM_LONG_TIMER, 'a', pwm_long_match<0>, 0); }
+	if (Subscribed & 2) { pwm.unsubscribe(PWM_LONG_TIMER, 'b', pwm_long_match<1>, 0); }
+	Subscribed = 0;
+}
+
+void PWM_Long::setDuty(const char ABCD_out, const PWM_Duty Duty)
+{
+	const uint8_t Out = pwm_out_index(ABCD_out);
+	if (Out > 1)
+	{
+		return;
+	}
+	this->Duty[Out] = Duty;
+	if (!Extended)
+	{
+		PWM::setDuty(PWM_LONG_TIMER, ABCD_out, Duty);
+		return;
+	}
+	const uint32_t Width = width(Duty);
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_long_edge[Out].Width = Width;
+	SREG = sreg;
+}
+
+void PWM_Long::end()
+{
+	release();
+	pwm.stop(PWM_LONG_TIMER);
+	Outputs = 0;
+}
+
+PWM_Long pwm_long;
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef PWM_Profile_H
+#define PWM_Profile_H
+
+// ISR profiler (define PWM_PROFILE before including PWM.h)
+// Every vector of the back-ends (and the ones bound with PWM_ISR_PROFILED) reads a free running
+// clock when its handler starts and when it returns, and the count of its own timer on entry. The
+// slot of the vector (PWM_PROFILE_T1A ... in the back-end, PWM_PROFILE_USER and up for the sketch)
+// accumulates :
+//   Min, Max, Sum / Count               : handler cycles, callback included (not the vector around it : 74
+//                                         cycles for a callback vector, see below)
+//   LatencyMin, LatencyMax, LatencySum  : counts of the vector's timer from its event (the compare value,
+//                                         for the overflow TOP in fast PWM, BOTTOM in the dual slope modes)
+//                                         to the handler, in timer counts (times its prescalar for cycles).
+//                                         Modulo the period of a single slope timer set() has configured :
+//                                         up to half a period
+//
+//   pwm.start();
+//   pwm_profile_start();                                  // the clock, after pwm.start() (which stops all timers)
+//   ...
+//   PWM_ProfileStats s = pwm_profile_snapshot(PWM_PROFILE_T1);  // read and reset
+//   Serial.println(s.Sum / s.Count);
+//
+// The clock is a 16b timer at the CPU clock (Timer1 on the ATmega328p, Timer3 on the ATmega32u4, then
+// not available to set()), an ISR is measured up to 65535 cycles. Another clock : define PWM_PROFILE_CLOCK
+// (its TCNTx), PWM_PROFILE_CLOCK_LOG2PS and start it yourself (pwm_profile_start() then only clears the table). Count saturates at 65535 : Sum and
+// LatencySum stop there, Min and Max go on. 18 bytes of RAM per slot and ~150 cycles per interrupt : the
+// latency ~45 before the handler, the statistics ~100 after it (instruction count). The naked
+// PWM_DITHER_FAST vectors are not profiled.
+// The library handlers are timed in the slot of the vector they run from : PWM_Soft.h in the compare
+// slots of PWM_SOFT_TIMER, PWM_BAM.h and PWM_Long.h in PWM_PROFILE_T1A (T1B), PWM_DDS.h, PWM_Stream.h,
+// PWM_Fade.h and PWM_Scheduler.h in the overflow slot of their timer, with the other subscribers of it.
+// Their worst case ISR is Max and the callback vector around it, 74 cycles by instruction count (response
+// and jmp 7, prologue 32, epilogue 31, reti 4) : the ISR cycles PWM_BAM_ISR_CYCLES and PWM_LONG_ISR_CYCLES
+// stand for.
+
+#ifndef PWM_PROFILE_SLOTS
+#define PWM_PROFILE_SLOTS 16
+#endif
+
+#ifndef PWM_PROFILE_CLOCK
+#if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+#define PWM_PROFILE_CLOCK TCNT1
+#define PWM_PROFILE_TIMER 1
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+#define PWM_PROFILE_CLOCK TCNT3
+#define PWM_PROFILE_TIMER 3
+#else
+#error "PWM_Profile.h : no 16b timer for the clock, define PWM_PROFILE_CLOCK"
+#endif
+#endif
+#ifndef PWM_PROFILE_CLOCK_LOG2PS
+#define PWM_PROFILE_CLOCK_LOG2PS 0
+#endif
+
+struct PWM_ProfileStats
+{
+	uint16_t Count;
+	uint16_t Min, Max;               // cycles
+	uint32_t Sum;
+	uint16_t LatencyMin, LatencyMax; // counts of the vector's timer
+	uint32_t LatencySum;
+};
+
+volatile PWM_ProfileStats pwm_profile[PWM_PROFILE_SLOTS];
+
+// start the default clock : normal mode, no prescalar, interrupts off
+inline void pwm_profile_start()
+{
+#if defined(PWM_PROFILE_TIMER) && (PWM_PROFILE_TIMER == 1)
+	//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TIMSK1 = 0;
+	TCCR1B = _BV(CS10);
+#elif defined(PWM_PROFILE_TIMER) && (PWM_PROFILE_TIMER == 3)
+	//TCCR3B = [ ICNC3| ICES3|   -  | WGM33| WGM32|  CS32|  CS31|  CS30]
+	TCCR3B = 0;
+	TCCR3A = 0;
+	TIMSK3 = 0;
+	TCCR3B = _BV(CS30);
+#endif
+	for (uint8_t i = 0; i < PWM_PROFILE_SLOTS; ++i)
+	{
+		pwm_profile[i].Count = 0;
+		pwm_profile[i].Min = 0xFFFF;
+		pwm_profile[i].Max = 0;
+		pwm_profile[i].Sum = 0;
+		pwm_profile[i].LatencyMin = 0xFFFF;
+		pwm_profile[i].LatencyMax = 0;
+		pwm_profile[i].LatencySum = 0;
+	}
+}
+
+// copy a slot out with the interrupts held off, Reset : start it over
+PWM_ProfileStats pwm_profile_snapshot(const uint8_t Slot, const bool Reset = true)
+{
+	volatile PWM_ProfileStats &p = pwm_profile[Slot];
+	PWM_ProfileStats s;
+	const uint8_t sreg = SREG;
+	cli();
+	s.Count = p.Count;
+	s.Min = p.Min;
+	s.Max = p.Max;
+	s.Sum = p.Sum;
+	s.LatencyMin = p.LatencyMin;
+	s.LatencyMax = p.LatencyMax;
+	s.LatencySum = p.LatencySum;
+	if (Reset)
+	{
+		p.Count = 0;
+		p.Min = 0xFFFF;
+		p.Max = 0;
+		p.Sum = 0;
+		p.LatencyMin = 0xFFFF;
+		p.LatencyMax = 0;
+		p.LatencySum = 0;
+	}
+	SREG = sreg;
+	return s;
+}
+
+// the TOP of a single slope timer for PWM_ISR_PROFILED, 0 (no period) in the dual slope modes or before set()
+inline uint16_t pwm_profile_top(const uint8_t Timer)
+{
+	return (pwm_dual_slope & _BV(Timer)) ? 0 : pwm_period_register[Timer];
+}
+
+// lives for the handler of a vector (see PWM_ISR_PROFILED), interrupts are off
+class PWM_ProfileScope {
+protected:
+	const uint8_t Slot;
+	const uint16_t Start;
+	uint16_t Latency;
+
+public:
+	template <typename Register>
+	__attribute__((always_inline)) inline PWM_ProfileScope(const uint8_t Slot, const Register &Counter, const uint16_t Event, const uint16_t Top = 0)
+		: Slot(Slot), Start(PWM_PROFILE_CLOCK)
+	{
+		int32_t d = (int32_t)Counter - (int32_t)Event;
+		if (Top == 0)
+		{
+			// either slope of a dual slope timer
+			Latency = (d < 0) ? -d : d;
+			return;
+		}
+		// single slope : the counter may have wrapped past BOTTOM since the event
+		const int32_t Period = (int32_t)Top + 1;
+		if (d < 0) { d += Period; }
+		Latency = (d > Period / 2) ? Period - d : d;
+	}
+
+	__attribute__((always_inline)) inline ~PWM_ProfileScope()
+	{
+		const uint16_t Cycles = (uint16_t)(PWM_PROFILE_CLOCK - Start) << PWM_PROFILE_CLOCK_LOG2PS;
+		volatile PWM_ProfileStats &p = pwm_profile[Slot];
+		if (Cycles < p.Min) { p.Min = Cycles; }
+		if (Cycles > p.Max) { p.Max = Cycles; }
+		if (Latency < p.LatencyMin) { p.LatencyMin = Latency; }
+		if (Latency > p.LatencyMax) { p.LatencyMax = Latency; }
+		const uint16_t Count = p.Count;
+		if (Count != 0xFFFF)
+		{
+			p.Count = Count + 1;
+			p.Sum += Cycles;
+			p.LatencySum += Latency;
+		}
+	}
+};
+
+#endif
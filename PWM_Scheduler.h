@@ -0,0 +1,237 @@
+#ifndef PWM_Scheduler_H
+#define PWM_Scheduler_H
+
+// Control loop scheduler, locked to the periods of a PWM timer
+// Run to completion tasks (PID, state estimation ...) released every so many periods of a tick timer,
+// run from its overflow ISR : the loop timing does not depend on loop(). A task may return a duty
+// cycle, it is staged (stageDuty()) on the output the task drives and committed (commit()) once all
+// the tasks of the period have run : it starts with the next period, with the others of that timer.
+//
+//   #include <PWM.h>
+//   #include <PWM_Scheduler.h>
+//   bool pid(void *Context, PWM_Duty &Duty) { Duty = static_cast<Loop *>(Context)->update(); return true; }
+//   bool observer(void *Context, PWM_Duty &) { ...; return false; }  // no duty cycle
+//
+//   pwm.set(1, 'a', 20000, pwm_q16(0));
+//   pwm.start();
+//   pwm_scheduler.add(pid, &Current, 4, 2, 1, 'a');  // every 4 periods (5kHz), priority 2, OC1A
+//   pwm_scheduler.add(observer, 0, 20, 1, 0, 0, 1);  // every 20 periods, one period after the pid
+//   pwm_scheduler.begin(1);                          // after pwm.start(), which stops the timers
+//
+// At each period the due tasks are released, then run one after the other, the highest Priority first
+// (ties : in the order they were added), with the interrupts off. A task is not preempted : the next
+// period is the deadline of every task released in this one, the commit point of its duty cycle. The
+// overflow flag of the tick timer shows it has passed :
+//   * a task that returns after it, or is still waiting when it is released again, overruns
+//   * the tasks not started yet wait for the next period (they run then, before the ones of lower
+//     priority), their release overruns
+// overruns() reads and resets the count of a task. The table has PWM_SCHEDULER_TASKS entries (default
+// 4), no heap. A period counts down every task of the table, then runs the released ones and commits
+// once per timer. By instruction count (not measured, see PWM_Profile.h to time a build), a period is
+// ~185 cycles (callback vector 85, subscriber table 40, saved registers 32, tick count 20, loops 8) and
+// 20 per task of the table, a released task ~75 more around its Run (release 13, order and deadline
+// checks 40, call 22) and a duty cycle ~100 (stageDuty 60, commit 40). The tick is a subscriber of the overflow of its timer (see PWM_Subscribe.h), not
+// Timer0 (millis()). The timers of the outputs must
+// not stage or commit from loop() at the same time. With PWM_DECIMATE the deadline stays one carrier
+// period : give the tasks a period instead.
+
+#include <PWM.h>
+
+#ifndef PWM_SCHEDULER_TASKS
+#define PWM_SCHEDULER_TASKS 4
+#endif
+
+enum { PWM_TASK_IDLE = 0, PWM_TASK_DUE = 1, PWM_TASK_LATE = 2 };
+
+struct PWM_Task
+{
+	bool (*Run)(void *Context, PWM_Duty &Duty); // 0 : free. true : Duty goes to the output
+	void *Context;
+	uint16_t Period;    // ticks
+	uint16_t Countdown; // ticks to the next release
+	uint8_t Priority;   // the higher first
+	uint8_t Timer;      // output of the duty cycle
+	char Out;           // 0 : none
+	uint8_t State;      // PWM_TASK_IDLE, PWM_TASK_DUE (released), PWM_TASK_LATE (released, overrun counted)
+	uint16_t Overruns;
+};
+
+PWM_Task pwm_task[PWM_SCHEDULER_TASKS];
+uint8_t pwm_task_order[PWM_SCHEDULER_TASKS]; // slots by priority, pwm_task_count of them
+uint8_t pwm_task_count = 0;
+uint8_t pwm_scheduler_timer = 0;             // tick timer, 0 : not ticking
+volatile uint32_t pwm_scheduler_ticks = 0;
+
+// one period of the tick timer (subscriber of its overflow, interrupts are off)
+void pwm_scheduler_tick(void *)
+{
+	const uint8_t Tick = pwm_scheduler_timer;
+	pwm_scheduler_ticks = pwm_scheduler_ticks + 1;
+
+	for (uint8_t i = 0; i < PWM_SCHEDULER_TASKS; ++i)
+	{
+		PWM_Task &t = pwm_task[i];
+		if ((t.Run == 0) || (--t.Countdown != 0))
+		{
+			continue;
+		}
+		t.Countdown = t.Period;
+		if (t.State == PWM_TASK_IDLE) { t.State = PWM_TASK_DUE; }
+		else { ++t.Overruns; } // the last release has not run yet, this one is merged into it
+	}
+
+	uint8_t Commit = 0; // bit Timer : duty cycles staged
+	for (uint8_t n = 0; n < pwm_task_count; ++n)
+	{
+		PWM_Task &t = pwm_task[pwm_task_order[n]];
+		if (t.State == PWM_TASK_IDLE)
+		{
+			continue;
+		}
+		if (pwm_overflow_pending(Tick))
+		{
+			// the next period has started : wait for it
+			if (t.State == PWM_TASK_DUE) { t.State = PWM_TASK_LATE; ++t.Overruns; }
+			continue;
+		}
+		PWM_Duty Duty;
+		if (t.Run(t.Context, Duty) && t.Out)
+		{
+			pwm.stageDuty(t.Timer, t.Out, Duty);
+			Commit |= _BV(t.Timer);
+		}
+		if ((t.State == PWM_TASK_DUE) && pwm_overflow_pending(Tick)) { ++t.Overruns; }
+		t.State = PWM_TASK_IDLE;
+	}
+
+	// a commit still pending keeps the stage, it goes with the next one
+	for (uint8_t Timer = 0; Commit; ++Timer, Commit >>= 1)
+	{
+		if (Commit & 1) { pwm.commit(Timer); }
+	}
+}
+
+class PWM_Scheduler {
+public:
+	// tick on the overflow of Timer (set() before). false : Timer0, no such timer or its subscriber table is full
+	bool begin(const uint8_t Timer);
+	// stop ticking, the tasks stay in the table
+	void end();
+
+	// Run(Context, Duty) every Periods ticks (1 ..), first Offset + 1 ticks from now. When it returns true,
+	// Duty is staged on ABCD_out of Timer (0 : no output) and committed. The task number, or
+	// PWM_SCHEDULER_TASKS if the table is full
+	uint8_t add(bool (*Run)(void *Context, PWM_Duty &Duty), void *Context, const uint16_t Periods, const uint8_t Priority = 0,
+		const uint8_t Timer = 0, const char ABCD_out = 0, const uint16_t Offset = 0);
+	void remove(const uint8_t Task);
+	// overruns of Task since the last call
+	uint16_t overruns(const uint8_t Task);
+	// periods of the tick timer since begin()
+	uint32_t ticks() const;
+};
+
+bool PWM_Scheduler::begin(const uint8_t Timer)
+{
+	if ((Timer == 0) | (pwm_scheduler_timer != 0))
+	{
+		return false;
+	}
+	pwm_scheduler_ticks = 0;
+	pwm_scheduler_timer = Timer;
+	if (!pwm.subscribe(Timer, 'o', pwm_scheduler_tick, 0))
+	{
+		pwm_scheduler_timer = 0;
+		return false;
+	}
+	return true;
+}
+
+void PWM_Scheduler::end()
+{
+	if (pwm_scheduler_timer == 0)
+	{
+		return;
+	}
+	pwm.unsubscribe(pwm_scheduler_timer, 'o', pwm_scheduler_tick, 0);
+	pwm_scheduler_timer = 0;
+}
+
+uint8_t PWM_Scheduler::add(bool (*Run)(void *Context, PWM_Duty &Duty), void *Context, const uint16_t Periods, const uint8_t Priority,
+	const uint8_t Timer, const char ABCD_out, const uint16_t Offset)
+{
+	uint8_t i = 0;
+	while ((i < PWM_SCHEDULER_TASKS) && pwm_task[i].Run) { ++i; }
+	if ((i == PWM_SCHEDULER_TASKS) | (Run == 0))
+	{
+		return PWM_SCHEDULER_TASKS;
+	}
+	PWM_Task t;
+	t.Run = Run;
+	t.Context = Context;
+	t.Period = Periods ? Periods : 1;
+	t.Countdown = Offset + 1;
+	t.Priority = Priority;
+	t.Timer = Timer;
+	t.Out = ABCD_out;
+	t.State = PWM_TASK_IDLE;
+	t.Overruns = 0;
+
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_task[i] = t;
+	// after the tasks of the same or a higher priority
+	uint8_t n = pwm_task_count;
+	for (; (n > 0) && (pwm_task[pwm_task_order[n - 1]].Priority < Priority); --n)
+	{
+		pwm_task_order[n] = pwm_task_order[n - 1];
+	}
+	pwm_task_order[n] = i;
+	++pwm_task_count;
+	SREG = sreg;
+	return i;
+}
+
+void PWM_Scheduler::remove(const uint8_t Task)
+{
+	if ((Task >= PWM_SCHEDULER_TASKS) || (pwm_task[Task].Run == 0))
+	{
+		return;
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_task[Task].Run = 0;
+	uint8_t n = 0;
+	while (pwm_task_order[n] != Task) { ++n; }
+	for (--pwm_task_count; n < pwm_task_count; ++n)
+	{
+		pwm_task_order[n] = pwm_task_order[n + 1];
+	}
+	SREG = sreg;
+}
+
+uint16_t PWM_Scheduler::overruns(const uint8_t Task)
+{
+	if (Task >= PWM_SCHEDULER_TASKS)
+	{
+		return 0;
+	}
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t Overruns = pwm_task[Task].Overruns;
+	pwm_task[Task].Overruns = 0;
+	SREG = sreg;
+	return Overruns;
+}
+
+uint32_t PWM_Scheduler::ticks() const
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint32_t Ticks = pwm_scheduler_ticks;
+	SREG = sreg;
+	return Ticks;
+}
+
+PWM_Scheduler pwm_scheduler;
+
+#endif
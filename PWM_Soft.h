@@ -0,0 +1,276 @@
+#ifndef PWM_Soft_H
+#define PWM_Soft_H
+
+// Software PWM on any pins
+// One timer of the back-end (PWM_SOFT_TIMER : Timer2 on the ATmega328p, Timer1 on the ATmega32u4
+// and ATtinyX5) runs in CTC mode. Its TOP match starts the period and sets every channel with a
+// duty cycle, the second compare unit steps through a sorted list of edges and clears the pins
+// that end there. The pins are written through their PORTx registers (one AND per port and edge),
+// channels ending on the same count share an edge.
+//
+//   #include <PWM.h>
+//   #include <PWM_Soft.h>
+//   pwm_soft.begin(500);                      // 500Hz, prescalar and TOP from PWM::solve
+//   int8_t Led = pwm_soft.attach(7);          // channel of pin 7
+//   pwm_soft.set(Led, pwm_q16(0x4000));       // 25%, or a high time in timer ticks 0 .. TOP + 1
+//
+// The edge list is rebuilt by set() into a back buffer (insertion sort of PWM_SOFT_CHANNELS
+// channels) and swapped in by the period ISR, a period never mixes two lists. Edges closer than
+// the ISR are run by the same interrupt (the compare value is already passed), so a pin ends late
+// rather than a period late.
+//
+// The period ISR writes each port once. The edge ISR runs the edges it has caught up with, one AND
+// per port each : its worst case is every channel due in one interrupt, N channels on distinct counts
+// closer than the ISR. A period takes N + 1 interrupts at most.
+//
+// Worst case ISR cycles, instruction counts of pwm_soft_period / pwm_soft_run (not measured, see
+// PWM_Profile.h to time a build), P the ports in use :
+//   callback vector : 85 (response and jmp 7, prologue 32, callback load and icall 7, ret 4, epilogue 31, reti 4)
+//   period ISR      : 85 + 65 + 22 per port (schedule swap, set loop, first edge test)
+//   edge ISR        : 85 + 50 + N * (40 + 20 per port) (edge test, flag clear, AND loop)
+//
+//   N channels      1    2    4    8      period ISR
+//   1 port        195  255  375  615      172
+//   2 ports       215  295  455  775      194
+//   3 ports       235  335  535  935      216
+//
+// e.g. 8 channels on 8 distinct counts, one port, 500Hz at 16MHz : one period ISR and 8 edge ISRs of
+// 195 cycles, ~1730 cycles of a 32000 cycle period (~5.4% of the CPU).
+
+#include <PWM.h>
+
+#ifndef PWM_SOFT_CHANNELS
+#define PWM_SOFT_CHANNELS 8
+#endif
+#define PWM_SOFT_PORTS 3
+
+struct PWM_SoftEdge
+{
+	uint16_t Time;                 // compare value, the pins go low when the counter reaches it
+	uint8_t Clear[PWM_SOFT_PORTS]; // PORTx &= Clear[x]
+};
+
+struct PWM_SoftSchedule
+{
+	uint8_t Set[PWM_SOFT_PORTS];   // pins high at the start of the period
+	uint8_t Edges;
+	PWM_SoftEdge Edge[PWM_SOFT_CHANNELS];
+};
+
+PWM_SoftSchedule pwm_soft_schedule[2];
+volatile uint8_t pwm_soft_front = 0;    // schedule run by the ISR
+volatile uint8_t pwm_soft_pending = 0;  // the other one is ready, swapped at the next period
+uint8_t pwm_soft_next = 0;              // next edge of the front schedule (ISR only)
+uint16_t pwm_soft_top = 0;
+uint8_t pwm_soft_ports = 0;
+volatile uint8_t *pwm_soft_port[PWM_SOFT_PORTS];
+uint8_t pwm_soft_keep[PWM_SOFT_PORTS];  // pins of each port not driven by the engine
+
+// run the edges that are due, then arm the compare unit for the next one
+// the period ISR runs at TOP, where every edge of the new period is still to come
+inline void pwm_soft_run(const PWM_SoftSchedule &s)
+{
+	uint8_t i = pwm_soft_next;
+	for (;;)
+	{
+		if (i == s.Edges)
+		{
+			PWM_SOFT_TIMSK &= ~_BV(PWM_SOFT_EDGE_IE);
+			break;
+		}
+		const uint16_t Time = s.Edge[i].Time;
+		PWM_SOFT_EDGE_OCR = Time;
+		const uint16_t Now = PWM_SOFT_TCNT;
+		if ((Now < Time) | (Now == pwm_soft_top))
+		{
+			break;
+		}
+		// passed : the match is done (or missed), run it now
+		PWM_SOFT_TIFR = _BV(PWM_SOFT_EDGE_IF);
+		for (uint8_t p = 0; p < pwm_soft_ports; ++p)
+		{
+			*pwm_soft_port[p] &= s.Edge[i].Clear[p];
+		}
+		++i;
+	}
+	pwm_soft_next = i;
+}
+
+// TOP match : swap in a new schedule, set the pins, arm the first edge
+void pwm_soft_period()
+{
+	if (pwm_soft_pending)
+	{
+		pwm_soft_front ^= 1;
+		pwm_soft_pending = 0;
+	}
+	const PWM_SoftSchedule &s = pwm_soft_schedule[pwm_soft_front];
+	for (uint8_t p = 0; p < pwm_soft_ports; ++p)
+	{
+		*pwm_soft_port[p] = (*pwm_soft_port[p] & pwm_soft_keep[p]) | s.Set[p];
+	}
+	pwm_soft_next = 0;
+	PWM_SOFT_TIFR = _BV(PWM_SOFT_EDGE_IF);
+	PWM_SOFT_TIMSK |= _BV(PWM_SOFT_EDGE_IE);
+	pwm_soft_run(s);
+}
+
+// compare match of the next edge
+void pwm_soft_edge()
+{
+	pwm_soft_run(pwm_soft_schedule[pwm_soft_front]);
+}
+
+class PWM_Soft {
+protected:
+	uint8_t Channels = 0;
+	uint8_t Port[PWM_SOFT_CHANNELS];   // index in pwm_soft_port
+	uint8_t Mask[PWM_SOFT_CHANNELS];
+	uint16_t Duty[PWM_SOFT_CHANNELS];  // high time in timer ticks
+
+	// sort the channels into the back schedule, the period ISR swaps it in
+	void build();
+
+public:
+	// start the timebase at the closest frequency PWM_SOFT_TIMER can do
+	PWM_Result begin(const uint32_t FrequencyHz);
+	// stop the timebase, the pins are left low
+	void end();
+	// drive Pin (OUTPUT, low until set), returns its channel or -1 (PWM_SOFT_CHANNELS or PWM_SOFT_PORTS used)
+	int8_t attach(const uint8_t Pin);
+	// high time in timer ticks : 0 (off) .. TOP + 1 (on)
+	void set(const uint8_t Channel, const uint16_t Ticks);
+	// pwm_q16(Fraction), pwm_ticks(Ticks) or pwm_divisor(DutyCycle_Divisor)
+	void set(const uint8_t Channel, const PWM_Duty Duty);
+	uint16_t top() const { return pwm_soft_top; }
+};
+
+PWM_Result PWM_Soft::begin(const uint32_t FrequencyHz)
+{
+	const PWM_Result Result = pwm.solve(PWM_SOFT_TIMER, FrequencyHz);
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_soft_top = Result.PeriodRegister;
+	pwm_soft_period_interrupt = pwm_soft_period;
+	pwm_soft_edge_interrupt = pwm_soft_edge;
+	SREG = sreg;
+	build();
+	pwm_soft_timebase(Result.PeriodRegister, Result.CSx3210);
+	return Result;
+}
+
+void PWM_Soft::end()
+{
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_soft_timebase(pwm_soft_top, 0);
+	PWM_SOFT_TIMSK &= ~_BV(PWM_SOFT_EDGE_IE);
+	pwm_soft_period_interrupt = pwm_empty_interrupt;
+	pwm_soft_edge_interrupt = pwm_empty_interrupt;
+	for (uint8_t p = 0; p < pwm_soft_ports; ++p)
+	{
+		*pwm_soft_port[p] &= pwm_soft_keep[p];
+	}
+	SREG = sreg;
+}
+
+int8_t PWM_Soft::attach(const uint8_t Pin)
+{
+	if (Channels == PWM_SOFT_CHANNELS)
+	{
+		return -1;
+	}
+	volatile uint8_t *Output = portOutputRegister(digitalPinToPort(Pin));
+	const uint8_t Bit = digitalPinToBitMask(Pin);
+
+	uint8_t p = 0;
+	while ((p < pwm_soft_ports) && (pwm_soft_port[p] != Output)) { ++p; }
+	if (p == PWM_SOFT_PORTS)
+	{
+		return -1;
+	}
+
+	pinMode(Pin, OUTPUT);
+	digitalWrite(Pin, LOW);
+
+	const uint8_t sreg = SREG;
+	cli();
+	if (p == pwm_soft_ports)
+	{
+		// a new port : no edge clears it yet
+		pwm_soft_port[p] = Output;
+		pwm_soft_keep[p] = 0xFF;
+		for (uint8_t b = 0; b < 2; ++b)
+		{
+			pwm_soft_schedule[b].Set[p] = 0;
+			for (uint8_t e = 0; e < PWM_SOFT_CHANNELS; ++e) { pwm_soft_schedule[b].Edge[e].Clear[p] = 0xFF; }
+		}
+		++pwm_soft_ports;
+	}
+	pwm_soft_keep[p] &= ~Bit;
+	SREG = sreg;
+
+	Port[Channels] = p;
+	Mask[Channels] = Bit;
+	Duty[Channels] = 0;
+	return Channels++;
+}
+
+void PWM_Soft::set(const uint8_t Channel, const uint16_t Ticks)
+{
+	if (Channel >= Channels)
+	{
+		return;
+	}
+	Duty[Channel] = Ticks;
+	build();
+}
+
+void PWM_Soft::set(const uint8_t Channel, const PWM_Duty Duty)
+{
+	// high for Fraction * (TOP + 1) ticks (see pwm_scale_duty, the compare value is one less)
+	const uint16_t Ticks = pwm_scale_duty(pwm_soft_top, true, Duty);
+	set(Channel, ((Duty.Kind == PWM_DUTY_Q16) & (Ticks != 0)) ? Ticks + 1 : Ticks);
+}
+
+void PWM_Soft::build()
+{
+	// the back schedule is ours once no swap is pending
+	pwm_soft_pending = 0;
+	PWM_SoftSchedule &s = pwm_soft_schedule[pwm_soft_front ^ 1];
+
+	for (uint8_t p = 0; p < pwm_soft_ports; ++p) { s.Set[p] = 0; }
+	s.Edges = 0;
+	for (uint8_t c = 0; c < Channels; ++c)
+	{
+		const uint16_t Ticks = Duty[c];
+		const uint8_t p = Port[c];
+		if (Ticks == 0)
+		{
+			continue;
+		}
+		s.Set[p] |= Mask[c];
+		if (Ticks > pwm_soft_top)
+		{
+			continue;
+		}
+
+		// set at the TOP match, high for Ticks counts : cleared at the match of Ticks - 1
+		const uint16_t Time = Ticks - 1;
+		uint8_t e = 0;
+		while ((e < s.Edges) && (s.Edge[e].Time < Time)) { ++e; }
+		if ((e == s.Edges) || (s.Edge[e].Time != Time))
+		{
+			for (uint8_t i = s.Edges; i > e; --i) { s.Edge[i] = s.Edge[i - 1]; }
+			s.Edge[e].Time = Time;
+			for (uint8_t q = 0; q < pwm_soft_ports; ++q) { s.Edge[e].Clear[q] = 0xFF; }
+			++s.Edges;
+		}
+		s.Edge[e].Clear[p] &= ~Mask[c];
+	}
+	pwm_soft_pending = 1;
+}
+
+PWM_Soft pwm_soft;
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef PWM_Stream_H
+#define PWM_Stream_H
+
+// Duty cycle streaming
+// A single producer, single consumer ring of compare register values. loop() (or a serial receiver)
+// writes, and a subscriber of the timer's overflow takes one value per period and stores it to the output.
+//
+//   #include <PWM.h>
+//   #include <PWM_Stream.h>
+//   pwm.set(1, 'a', 8000, pwm_q16(0x8000));   // 8kHz sample rate, TOP 1999
+//   pwm.start();
+//   pwm_stream.begin(1, 'a');                 // after pwm.start(), which stops the timers
+//   if (pwm_stream.write(Sample)) { ... }     // false : full, the sample is dropped (an overrun)
+//
+// Lock free : the producer owns the head index and the ISR owns the tail, each written by a single store
+// (8 bit indices, running freely : count = head - tail). The producer never holds the interrupts off.
+// The value is stored before the head moves, so the ISR only reads complete slots. A period with
+// nothing to take is an underrun : the output keeps its last value (PWM_STREAM_HOLD) or goes to the
+// idle value (PWM_STREAM_IDLE).
+// The overflow of the timer is subscribed to (see PWM_Subscribe.h), it is shared with the other
+// subscribers (no period dither on it, not Timer0 : millis()). A period is a ring read and a compare
+// store, ~175 cycles by instruction count (not measured, see PWM_Profile.h to time a build) : callback
+// vector 85, subscriber table 40, indices and slot read 20, setDuty on the timer and output of begin() 30.
+// With PWM_ISR_STATIC, bind the vector yourself, e.g. PWM_ISR(TIMER1_OVF_vect, pwm_stream_sample).
+
+#include <PWM.h>
+
+#ifndef PWM_STREAM_SIZE
+#define PWM_STREAM_SIZE 64
+#endif
+#define PWM_STREAM_MASK (PWM_STREAM_SIZE - 1)
+
+static_assert((PWM_STREAM_SIZE >= 2) & (PWM_STREAM_SIZE <= 128) & ((PWM_STREAM_SIZE & PWM_STREAM_MASK) == 0),
+	"PWM_STREAM_SIZE : a power of two, 2 .. 128 (8 bit indices)");
+
+// what an underrun writes
+enum PWM_StreamPolicy : uint8_t
+{
+	PWM_STREAM_HOLD = 0, // nothing, the last value stays
+	PWM_STREAM_IDLE = 1  // the idle value of begin()
+};
+
+volatile uint16_t pwm_stream_buffer[PWM_STREAM_SIZE];
+volatile uint8_t pwm_stream_head = 0;      // next slot to write (producer only)
+volatile uint8_t pwm_stream_tail = 0;      // next slot to read (ISR only)
+volatile uint16_t pwm_stream_underruns = 0; // ISR only, saturates at 65535
+uint8_t pwm_stream_timer = 0; // 0 : not subscribed
+char pwm_stream_out = 'a';
+PWM_StreamPolicy pwm_stream_policy = PWM_STREAM_HOLD;
+uint16_t pwm_stream_idle = 0;
+
+// one period : the next value, or the underrun policy (the overflow subscriber)
+void pwm_stream_sample(void * = 0)
+{
+	const uint8_t Tail = pwm_stream_tail;
+	if (Tail == pwm_stream_head)
+	{
+		const uint16_t Underruns = pwm_stream_underruns;
+		if (Underruns != 0xFFFF) { pwm_stream_underruns = Underruns + 1; }
+		if (pwm_stream_policy == PWM_STREAM_IDLE) { PWM::setDuty(pwm_stream_timer, pwm_stream_out, pwm_stream_idle); }
+		return;
+	}
+	PWM::setDuty(pwm_stream_timer, pwm_stream_out, pwm_stream_buffer[Tail & PWM_STREAM_MASK]);
+	pwm_stream_tail = Tail + 1;
+}
+
+class PWM_Stream {
+protected:
+	uint16_t Overruns = 0; // producer only
+
+public:
+	// subscribe to the overflow of Timer (set() and started before), its values go to ABCD_out
+	// Idle : a compare register value, written at each underrun with PWM_STREAM_IDLE. The ring starts empty
+	// false : Timer0 (millis()), no such timer or its subscriber table is full
+	bool begin(const uint8_t Timer, const char ABCD_out, const PWM_StreamPolicy Policy = PWM_STREAM_HOLD, const uint16_t Idle = 0);
+	// unsubscribe, the output keeps its last value. Nothing if not begun
+	void end();
+
+	// producer side, no interrupt held off
+	// a compare register value (see PWM::setDuty), false : full, the value is dropped and counted
+	bool write(const uint16_t PulseWidthRegister);
+	// pwm_q16(Fraction) or pwm_divisor(DutyCycle_Divisor), scaled here to the period of the last set()
+	bool write(const PWM_Duty Duty) { return write(pwm_pulse_width(pwm_stream_timer, Duty)); }
+	// free slots
+	uint8_t space() const { return PWM_STREAM_SIZE - (uint8_t)(pwm_stream_head - pwm_stream_tail); }
+	// values not taken yet
+	uint8_t available() const { return (uint8_t)(pwm_stream_head - pwm_stream_tail); }
+
+	// writes dropped on a full ring
+	uint16_t overruns() const { return Overruns; }
+	// periods with an empty ring (read with the interrupts held off)
+	uint16_t underruns() const;
+	void clearCounters();
+};
+
+bool PWM_Stream::begin(const uint8_t Timer, const char ABCD_out, const PWM_StreamPolicy Policy, const uint16_t Idle)
+{
+	if ((Timer == 0) | (pwm_timer_max(Timer) == 0))
+	{
+		return false;
+	}
+	end();
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_stream_timer = Timer;
+	pwm_stream_out = ABCD_out;
+	pwm_stream_policy = Policy;
+	pwm_stream_idle = Idle;
+	pwm_stream_tail = pwm_stream_head;
+	SREG = sreg;
+	if (!pwm.subscribe(Timer, 'o', pwm_stream_sample, 0))
+	{
+		pwm_stream_timer = 0;
+		return false;
+	}
+	return true;
+}
+
+void PWM_Stream::end()
+{
+	if (pwm_stream_timer == 0)
+	{
+		return;
+	}
+	pwm.unsubscribe(pwm_stream_timer, 'o', pwm_stream_sample, 0);
+	pwm_stream_timer = 0;
+}
+
+bool PWM_Stream::write(const uint16_t PulseWidthRegister)
+{
+	const uint8_t Head = pwm_stream_head;
+	if ((uint8_t)(Head - pwm_stream_tail) == PWM_STREAM_SIZE)
+	{
+		++Overruns;
+		return false;
+	}
+	pwm_stream_buffer[Head & PWM_STREAM_MASK] = PulseWidthRegister;
+	// published by one byte store : the ISR sees the slot complete or not at all
+	pwm_stream_head = Head + 1;
+	return true;
+}
+
+uint16_t PWM_Stream::underruns() const
+{
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t Underruns = pwm_stream_underruns;
+	SREG = sreg;
+	return Underruns;
+}
+
+void PWM_Stream::clearCounters()
+{
+	Overruns = 0;
+	const uint8_t sreg = SREG;
+	cli();
+	pwm_stream_underruns = 0;
+	SREG = sreg;
+}
+
+PWM_Stream pwm_stream;
+
+#endif
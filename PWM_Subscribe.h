@@ -0,0 +1,55 @@
+#ifndef PWM_Subscribe_H
+#define PWM_Subscribe_H
+
+// Vector subscribers
+// attachInterrupt() gives a vector one callback, without argument. subscribe() adds a callback with
+// a context pointer to a table of the vector (PWM_SUBSCRIBERS entries, default 2), so several drivers
+// share a vector, each with its own state :
+//
+//   void onPeriod(void *Context) { static_cast<Motor *>(Context)->update(); }
+//   pwm.subscribe(1, 'o', onPeriod, &LeftMotor);
+//   pwm.subscribe(1, 'o', onPeriod, &RightMotor);     // both every period, in this order
+//   pwm.unsubscribe(1, 'o', onPeriod, &LeftMotor);
+//
+// The table is installed as the callback of the vector (pwm_interruptNx) while it has subscribers.
+// The last unsubscribe() disables the interrupt source : no interrupt at all, not even the empty
+// callback. Each subscriber is one more indirect call after the callback of the vector. By instruction
+// count (not measured), the table adds 18 cycles to the callback vector (saved registers 12, count and
+// loop 6) and 22 per subscriber (entry load 10, icall and ret 8, loop 4) : 40 with one subscriber.
+// Every vector the back-end binds has a table, Timer0 compare A and B included, Timer0 overflow
+// (millis()) excepted. A vector is either subscribed to or attached : attachInterrupt() replaces the
+// table (the subscribers stay in it, the next subscribe() installs it again), and so do the library
+// helpers that take a callback (dither, commit(), PWM_Soft.h ...).
+
+#ifndef PWM_SUBSCRIBERS
+#define PWM_SUBSCRIBERS 2
+#endif
+
+struct PWM_Subscriber
+{
+	void(*Isr)(void *);
+	void *Context;
+};
+
+struct PWM_Subscribers
+{
+	PWM_Subscriber Entry[PWM_SUBSCRIBERS];
+	uint8_t Count;
+};
+
+// 0 : the overflow, 1 + n : compare output n (see pwm_channel)
+constexpr uint8_t pwm_vector_slot(const char ABCD_out)
+{
+	return (pwm_channel(ABCD_out) == 0xFF) ? 0 : pwm_channel(ABCD_out) + 1;
+}
+
+// every subscriber of a vector, in the order they came (interrupts are off)
+inline void pwm_subscribers_run(const PWM_Subscribers &s)
+{
+	for (uint8_t i = 0; i < s.Count; ++i)
+	{
+		s.Entry[i].Isr(s.Entry[i].Context);
+	}
+}
+
+#endif
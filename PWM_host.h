@@ -0,0 +1,1605 @@
+#ifndef PWM_host_H
+#define PWM_host_H
+
+// Host emulation of the AVR timer peripherals used by PWM.h
+//
+// Build the library (and a sketch) with g++ on a desktop machine :
+//   g++ -std=gnu++11 -I<path to PWM> -DPWM_HOST -D__AVR_ATmega328P__ sketch.cpp
+// The chip is selected with -D__AVR_ATmega328P__, -D__AVR_ATmega32U4__ or -D__AVR_ATtiny85__
+// (default ATmega328p). The timer special function registers are replaced by an emulated
+// register file (pwm_host::sfr), pinMode/digitalWrite drive emulated PORT/DDR registers and
+// every ISR() becomes a plain function that is called by the emulator.
+//
+// Nothing runs until the emulator is clocked :
+//   pwm_host::step(cycles);                // advance the CPU clock, timers and interrupts
+//   delay(ms); delayMicroseconds(us);      // same, in real time units
+//   pwm_host::waveform w = pwm_host::channel(1, 'a'); // measured output of OC1A
+//   pwm_host::waveform p = pwm_host::pin(9);          // measured output of a PORT pin (software PWM)
+//   pwm_host::print();                     // dump every active compare output
+//   pwm_host::adc_input = [](uint8_t Mux) -> uint16_t { ... };  // the ADC input, 10 bits
+//
+// Timer model
+// * Normal, CTC, Fast PWM, Phase correct and Phase and frequency correct modes
+// * TOP from MAX, OCRxA, ICRx, OCR1C (ATtinyX5 Timer1) and OCR4C (ATmega32u4 Timer4)
+// * OCRx (and OCRxA as TOP) double buffered in the PWM modes, ICRx is not
+//   (lowering ICRx below TCNTx makes the counter run to MAX, as it does on the chip)
+// * COMx[10] = 01 toggle, complementary (Timer4 / ATtinyX5 Timer1), 10 non-inverting, 11 inverting
+// * Force output compare strobes of Timer1 (FOC1x)
+// * Shared synchronous prescaler with GTCCR TSM/PSRx halting
+// * ATmega32u4 Timer4 10b registers through TC4H (high byte written first, read after the low byte)
+// * ATmega32u4 TCCR4C COM4A/B shadow bits, the same as in TCCR4A
+// * Interrupt flags (write one to clear), TIMSKx masks, SREG I-bit and vector priority
+// * TOVx set at BOTTOM, at TOP in fast PWM (with the TOP compare flag), the ISR dispatched on the flag
+// * ADC conversions started by ADSC or the auto trigger (a rising edge of the ADTS source flag), sample
+//   and hold 2 ADC clocks after the start (13.5 for the first conversion), done 13.5 ADC clocks after it
+//   (25), the input read from adc_input
+// * Interrupt entry : PWM_HOST_ISR_CYCLES (39) CPU cycles run between the flag and the ISR body, the
+//   interrupt response and vector jump (7) and the prologue of a callback vector (r0, r1, SREG and the 12
+//   call-clobbered registers : 32), counted from the instructions. The ISR body itself runs in zero cycles
+//   (it may call step() for its own time), busy-waits in the library clock the emulator (PWM_SPIN)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+#if !defined(__AVR_ATtinyX5__) & !defined(__AVR_ATmega328p__) & !defined(__AVR_ATmega328P__) & !defined(__AVR_ATmega32u4__) & !defined(__AVR_ATmega32U4__)
+#define __AVR_ATmega328P__
+#endif
+
+// CPU cycles from an interrupt flag to the ISR body (see above)
+#ifndef PWM_HOST_ISR_CYCLES
+#define PWM_HOST_ISR_CYCLES 39
+#endif
+
+#ifndef F_CPU
+#if defined(__AVR_ATtinyX5__)
+#define F_CPU 8000000UL
+#else
+#define F_CPU 16000000UL
+#endif
+#endif
+
+//+--------------------------------------------------------------------------+
+//| avr-libc / Arduino core subset                                           |
+//+--------------------------------------------------------------------------+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+#define reti()
+#define PWM_SYNC_LEAD_CYCLES 0 // the stores take no time
+
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+typedef std::string String;
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define LOW 0x0
+#define HIGH 0x1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define NOT_A_PIN 0
+#define NOT_A_PORT 0
+#define PB 2
+#define PC 3
+#define PD 4
+#define PE 5
+#define PF 6
+
+namespace pwm_host
+{
+	// Write-one-to-clear register (TIFRx). The emulator sets flags through .v
+	struct w1c
+	{
+		volatile uint8_t v;
+		operator uint8_t() const { return v; }
+		w1c &operator=(const uint8_t x) { v &= ~x; return *this; }
+		w1c &operator|=(const uint8_t x) { v &= ~(v | x); return *this; } // read-modify-write clears every pending flag, as on the chip
+		w1c &operator&=(const uint8_t x) { v &= ~(v & x); return *this; }
+	};
+
+	// ADC control and status register A : ADIF (bit 4) is cleared by writing it one, the other bits are plain
+	struct adcsra
+	{
+		volatile uint8_t v;
+		operator uint8_t() const { return v; }
+		adcsra &operator=(const uint8_t x) { v = (x & ~0x10) | (v & ~x & 0x10); return *this; }
+		adcsra &operator|=(const uint8_t x) { return *this = v | x; }
+		adcsra &operator&=(const uint8_t x) { return *this = v & x; }
+	};
+
+	// PLL control and status register : the PLL locks as soon as it is enabled (PLOCK follows PLLE)
+	struct pllcsr
+	{
+		volatile uint8_t v;
+		operator uint8_t() const { return (v & ~0x01) | ((v >> 1) & 0x01); }
+		pllcsr &operator=(const uint8_t x) { v = x; return *this; }
+		pllcsr &operator|=(const int x) { v |= x; return *this; }
+		pllcsr &operator&=(const int x) { v &= x; return *this; }
+	};
+
+	// SPI data register. A write is shifted out at once (no transfer time) : SPIF is set and the
+	// byte is passed to spi_hook, the model of whatever hangs on MOSI (e.g. a 74HC595 chain)
+	void (*spi_hook)(const uint8_t Byte) = 0;
+	struct spdr
+	{
+		volatile uint8_t v;
+		operator uint8_t() const { return v; }
+		spdr &operator=(const uint8_t x);
+	};
+
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	// Timer4 10b register (TCNT4, OCR4A..D) : bits 9:8 are taken from TC4H when the low byte is
+	// written, and put into TC4H when it is read
+	struct reg10
+	{
+		volatile uint16_t v;
+		operator uint8_t() const;
+		reg10 &operator=(const uint8_t x);
+	};
+
+	// TCCR4C : COM4A1S..COM4B0S (bits 7:4) are the COM4A and COM4B bits of TCCR4A, read and written
+	// through either register
+	struct tccr4c
+	{
+		volatile uint8_t v; // bits 3:0
+		operator uint8_t() const;
+		tccr4c &operator=(const uint8_t x);
+		tccr4c &operator|=(const uint8_t x) { return *this = uint8_t(*this) | x; }
+		tccr4c &operator&=(const uint8_t x) { return *this = uint8_t(*this) & x; }
+	};
+#endif
+
+	// Emulated register file
+	struct sfr_t
+	{
+		volatile uint8_t SREG;
+		volatile uint8_t GTCCR;
+		volatile uint8_t ADMUX, ADCSRB;
+		adcsra ADCSRA;
+		volatile uint16_t ADC;
+
+		volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B;
+#if defined(__AVR_ATtinyX5__)
+		volatile uint8_t TCCR1, TCNT1, OCR1A, OCR1B, OCR1C;
+		volatile uint8_t TIMSK;
+		w1c TIFR;
+		pllcsr PLLCSR;
+		volatile uint8_t PORTB, DDRB, PINB;
+#else
+		volatile uint8_t TCCR1A, TCCR1B, TCCR1C;
+		volatile uint16_t TCNT1, OCR1A, OCR1B, OCR1C, ICR1;
+		volatile uint8_t TIMSK0, TIMSK1;
+		w1c TIFR0, TIFR1;
+		volatile uint8_t PORTB, DDRB, PINB;
+		volatile uint8_t PORTC, DDRC, PINC;
+		volatile uint8_t PORTD, DDRD, PIND;
+		volatile uint8_t SPCR, SPSR;
+		spdr SPDR;
+#endif
+#if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+		volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, ASSR;
+		volatile uint8_t TIMSK2;
+		w1c TIFR2;
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+		volatile uint8_t TCCR3A, TCCR3B, TCCR3C;
+		volatile uint16_t TCNT3, OCR3A, OCR3B, OCR3C, ICR3;
+		volatile uint8_t TCCR4A, TCCR4B;
+		tccr4c TCCR4C;
+		volatile uint8_t TCCR4D, TCCR4E;
+		reg10 TCNT4, OCR4A, OCR4B, OCR4C, OCR4D;
+		volatile uint8_t TC4H, DT4;
+		volatile uint8_t TIMSK3, TIMSK4;
+		w1c TIFR3, TIFR4;
+		pllcsr PLLCSR;
+		volatile uint8_t PLLFRQ;
+		volatile uint8_t PORTE, DDRE, PINE;
+		volatile uint8_t PORTF, DDRF, PINF;
+#endif
+	};
+	sfr_t sfr;
+
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	reg10::operator uint8_t() const
+	{
+		sfr.TC4H = v >> 8;
+		return v & 0xFF;
+	}
+	reg10 &reg10::operator=(const uint8_t x)
+	{
+		v = ((sfr.TC4H & 0x3) << 8) | x;
+		return *this;
+	}
+	tccr4c::operator uint8_t() const
+	{
+		return (sfr.TCCR4A & 0xF0) | (v & 0x0F);
+	}
+	tccr4c &tccr4c::operator=(const uint8_t x)
+	{
+		v = x & 0x0F;
+		sfr.TCCR4A = (sfr.TCCR4A & 0x0F) | (x & 0xF0);
+		return *this;
+	}
+#endif
+
+#if !defined(__AVR_ATtinyX5__)
+	spdr &spdr::operator=(const uint8_t x)
+	{
+		v = x;
+		sfr.SPSR |= 0x80; // SPIF
+		if (spi_hook) { spi_hook(x); }
+		return *this;
+	}
+#endif
+}
+
+#define SREG (pwm_host::sfr.SREG)
+#define GTCCR (pwm_host::sfr.GTCCR)
+#define TCCR0A (pwm_host::sfr.TCCR0A)
+#define TCCR0B (pwm_host::sfr.TCCR0B)
+#define TCNT0 (pwm_host::sfr.TCNT0)
+#define OCR0A (pwm_host::sfr.OCR0A)
+#define OCR0B (pwm_host::sfr.OCR0B)
+#define PORTB (pwm_host::sfr.PORTB)
+#define DDRB (pwm_host::sfr.DDRB)
+#define PINB (pwm_host::sfr.PINB)
+
+#if defined(__AVR_ATtinyX5__)
+#define TCCR1 (pwm_host::sfr.TCCR1)
+#define TCNT1 (pwm_host::sfr.TCNT1)
+#define OCR1A (pwm_host::sfr.OCR1A)
+#define OCR1B (pwm_host::sfr.OCR1B)
+#define OCR1C (pwm_host::sfr.OCR1C)
+#define TIMSK (pwm_host::sfr.TIMSK)
+#define TIFR (pwm_host::sfr.TIFR)
+#define PLLCSR (pwm_host::sfr.PLLCSR)
+
+//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01 1
+#define WGM00 0
+//TCCR0B = [ FOC0A| FOC0B|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+//TCCR1 =  [  CTC1| PWM1A|COM1A1|COM1A0|  CS13|  CS12|  CS11|  CS10]
+#define CTC1 7
+#define PWM1A 6
+#define COM1A1 5
+#define COM1A0 4
+#define CS13 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+#define TSM 7
+#define PWM1B 6
+#define COM1B1 5
+#define COM1B0 4
+#define FOC1B 3
+#define FOC1A 2
+#define PSR1 1
+#define PSR0 0
+//TIMSK  = [   -  |OCIE1A|OCIE1B|OCIE0A|OCIE0B| TOIE1| TOIE0|   -  ]
+#define OCIE1A 6
+#define OCIE1B 5
+#define OCIE0A 4
+#define OCIE0B 3
+#define TOIE1 2
+#define TOIE0 1
+//TIFR   = [   -  | OCF1A| OCF1B| OCF0A| OCF0B|  TOV1|  TOV0|   -  ]
+#define OCF1A 6
+#define OCF1B 5
+#define OCF0A 4
+#define OCF0B 3
+#define TOV1 2
+#define TOV0 1
+//PLLCSR = [   LSM|   -  |   -  |   -  |   -  |  PCKE|  PLLE| PLOCK]
+#define LSM 7
+#define PCKE 2
+#define PLLE 1
+#define PLOCK 0
+#else
+#define TCCR1A (pwm_host::sfr.TCCR1A)
+#define TCCR1B (pwm_host::sfr.TCCR1B)
+#define TCCR1C (pwm_host::sfr.TCCR1C)
+#define TCNT1 (pwm_host::sfr.TCNT1)
+#define OCR1A (pwm_host::sfr.OCR1A)
+#define OCR1B (pwm_host::sfr.OCR1B)
+#define ICR1 (pwm_host::sfr.ICR1)
+#define TIMSK0 (pwm_host::sfr.TIMSK0)
+#define TIMSK1 (pwm_host::sfr.TIMSK1)
+#define TIFR0 (pwm_host::sfr.TIFR0)
+#define TIFR1 (pwm_host::sfr.TIFR1)
+#define PORTC (pwm_host::sfr.PORTC)
+#define DDRC (pwm_host::sfr.DDRC)
+#define PINC (pwm_host::sfr.PINC)
+#define PORTD (pwm_host::sfr.PORTD)
+#define DDRD (pwm_host::sfr.DDRD)
+#define PIND (pwm_host::sfr.PIND)
+
+//TCCR0A = [COM0A1|COM0A0|COM0B1|COM0B0|   -  |   -  | WGM01| WGM00]
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01 1
+#define WGM00 0
+//TCCR0B = [ FOC0A| FOC0B|   -  |   -  | WGM02|  CS02|  CS01|  CS00]
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+//TCCR1A = [COM1A1|COM1A0|COM1B1|COM1B0|COM1C1|COM1C0| WGM11| WGM10]
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define COM1C1 3
+#define COM1C0 2
+#define WGM11 1
+#define WGM10 0
+//TCCR1B = [ ICNC1| ICES1|   -  | WGM13| WGM12|  CS12|  CS11|  CS10]
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+//TCCR1C = [ FOC1A| FOC1B| FOC1C|   -  |   -  |   -  |   -  |   -  ]
+#define FOC1A 7
+#define FOC1B 6
+#define FOC1C 5
+//TIMSKx = [   -  |   -  | ICIEx|   -  |OCIExC|OCIExB|OCIExA| TOIEx]
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define ICIE1 5
+#define OCIE1C 3
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+//TIFRx  = [   -  |   -  |  ICFx|   -  | OCFxC| OCFxB| OCFxA|  TOVx]
+#define OCF0B 2
+#define OCF0A 1
+#define TOV0 0
+#define ICF1 5
+#define OCF1C 3
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+//GTCCR  = [   TSM|   -  |   -  |   -  |   -  |   -  |PSRASY|PSRSYNC]
+#define TSM 7
+#define PSRSYNC 0
+#define PSR10 0
+#endif
+
+#if !defined(__AVR_ATtinyX5__)
+#define SPCR (pwm_host::sfr.SPCR)
+#define SPSR (pwm_host::sfr.SPSR)
+#define SPDR (pwm_host::sfr.SPDR)
+//SPCR   = [  SPIE|   SPE|  DORD|  MSTR|  CPOL|  CPHA|  SPR1|  SPR0]
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+//SPSR   = [  SPIF|  WCOL|   -  |   -  |   -  |   -  |   -  | SPI2X]
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+#endif
+
+#define ADMUX (pwm_host::sfr.ADMUX)
+#define ADCSRA (pwm_host::sfr.ADCSRA)
+#define ADCSRB (pwm_host::sfr.ADCSRB)
+#define ADC (pwm_host::sfr.ADC)
+#define ADCW (pwm_host::sfr.ADC)
+//ADCSRA = [  ADEN|  ADSC| ADATE|  ADIF|  ADIE| ADPS2| ADPS1| ADPS0]
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define ACME 6
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+#if defined(__AVR_ATtinyX5__)
+//ADMUX  = [ REFS1| REFS0| ADLAR| REFS2|  MUX3|  MUX2|  MUX1|  MUX0]
+//ADCSRB = [   BIN|  ACME|   IPR|   -  |   -  | ADTS2| ADTS1| ADTS0]
+#define REFS2 4
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+//ADMUX  = [ REFS1| REFS0| ADLAR|  MUX4|  MUX3|  MUX2|  MUX1|  MUX0]
+//ADCSRB = [ ADHSM|  ACME|  MUX5|   -  | ADTS3| ADTS2| ADTS1| ADTS0]
+#define ADHSM 7
+#define MUX5 5
+#define ADTS3 3
+#else
+//ADMUX  = [ REFS1| REFS0| ADLAR|   -  |  MUX3|  MUX2|  MUX1|  MUX0]
+//ADCSRB = [   -  |  ACME|   -  |   -  |   -  | ADTS2| ADTS1| ADTS0]
+#endif
+
+#if defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+#define TCCR2A (pwm_host::sfr.TCCR2A)
+#define TCCR2B (pwm_host::sfr.TCCR2B)
+#define TCNT2 (pwm_host::sfr.TCNT2)
+#define OCR2A (pwm_host::sfr.OCR2A)
+#define OCR2B (pwm_host::sfr.OCR2B)
+#define ASSR (pwm_host::sfr.ASSR)
+#define TIMSK2 (pwm_host::sfr.TIMSK2)
+#define TIFR2 (pwm_host::sfr.TIFR2)
+
+//TCCR2A = [COM2A1|COM2A0|COM2B1|COM2B0|   -  |   -  | WGM21| WGM20]
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM21 1
+#define WGM20 0
+//TCCR2B = [ FOC2A| FOC2B|   -  |   -  | WGM22|  CS22|  CS21|  CS20]
+#define FOC2A 7
+#define FOC2B 6
+#define WGM22 3
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2 0
+#define OCF2B 2
+#define OCF2A 1
+#define TOV2 0
+#define PSRASY 1
+#define PSR2 1
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+#define OCR1C (pwm_host::sfr.OCR1C)
+#define TCCR3A (pwm_host::sfr.TCCR3A)
+#define TCCR3B (pwm_host::sfr.TCCR3B)
+#define TCCR3C (pwm_host::sfr.TCCR3C)
+#define TCNT3 (pwm_host::sfr.TCNT3)
+#define OCR3A (pwm_host::sfr.OCR3A)
+#define OCR3B (pwm_host::sfr.OCR3B)
+#define OCR3C (pwm_host::sfr.OCR3C)
+#define ICR3 (pwm_host::sfr.ICR3)
+#define TCCR4A (pwm_host::sfr.TCCR4A)
+#define TCCR4B (pwm_host::sfr.TCCR4B)
+#define TCCR4C (pwm_host::sfr.TCCR4C)
+#define TCCR4D (pwm_host::sfr.TCCR4D)
+#define TCCR4E (pwm_host::sfr.TCCR4E)
+#define TCNT4 (pwm_host::sfr.TCNT4)
+#define TC4H (pwm_host::sfr.TC4H)
+#define OCR4A (pwm_host::sfr.OCR4A)
+#define OCR4B (pwm_host::sfr.OCR4B)
+#define OCR4C (pwm_host::sfr.OCR4C)
+#define OCR4D (pwm_host::sfr.OCR4D)
+#define DT4 (pwm_host::sfr.DT4)
+#define TIMSK3 (pwm_host::sfr.TIMSK3)
+#define TIMSK4 (pwm_host::sfr.TIMSK4)
+#define TIFR3 (pwm_host::sfr.TIFR3)
+#define TIFR4 (pwm_host::sfr.TIFR4)
+#define PLLCSR (pwm_host::sfr.PLLCSR)
+#define PLLFRQ (pwm_host::sfr.PLLFRQ)
+#define PORTE (pwm_host::sfr.PORTE)
+#define DDRE (pwm_host::sfr.DDRE)
+#define PINE (pwm_host::sfr.PINE)
+#define PORTF (pwm_host::sfr.PORTF)
+#define DDRF (pwm_host::sfr.DDRF)
+#define PINF (pwm_host::sfr.PINF)
+
+//TCCR3A = [COM3A1|COM3A0|COM3B1|COM3B0|COM3C1|COM3C0| WGM31| WGM30]
+#define COM3A1 7
+#define COM3A0 6
+#define COM3B1 5
+#define COM3B0 4
+#define COM3C1 3
+#define COM3C0 2
+#define WGM31 1
+#define WGM30 0
+//TCCR3B = [ ICNC3| ICES3|   -  | WGM33| WGM32|  CS32|  CS31|  CS30]
+#define ICNC3 7
+#define ICES3 6
+#define WGM33 4
+#define WGM32 3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+//TCCR3C = [ FOC3A|   -  |   -  |   -  |   -  |   -  |   -  |   -  ]
+#define FOC3A 7
+#define ICIE3 5
+#define OCIE3C 3
+#define OCIE3B 2
+#define OCIE3A 1
+#define TOIE3 0
+#define ICF3 5
+#define OCF3C 3
+#define OCF3B 2
+#define OCF3A 1
+#define TOV3 0
+//TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A| FOC4B| PWM4A| PWM4B]
+#define COM4A1 7
+#define COM4A0 6
+#define COM4B1 5
+#define COM4B0 4
+#define FOC4A 3
+#define FOC4B 2
+#define PWM4A 1
+#define PWM4B 0
+//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
+#define PWM4X 7
+#define PSR4 6
+#define DTPS41 5
+#define DTPS40 4
+#define CS43 3
+#define CS42 2
+#define CS41 1
+#define CS40 0
+//TCCR4C = [COM4A1S|COM4A0S|COM4B1S|COM4B0S|COM4D1|COM4D0| FOC4D| PWM4D]
+#define COM4A1S 7
+#define COM4A0S 6
+#define COM4B1S 5
+#define COM4B0S 4
+#define COM4D1 3
+#define COM4D0 2
+#define FOC4D 1
+#define PWM4D 0
+//TCCR4D = [  FPIE4|  FPEN4|  FPNC4|  FPES4| FPAC4|  FPF4| WGM41| WGM40]
+#define FPIE4 7
+#define FPEN4 6
+#define FPNC4 5
+#define FPES4 4
+#define FPAC4 3
+#define FPF4 2
+#define WGM41 1
+#define WGM40 0
+//TCCR4E = [ TLOCK4|  ENHC4| OC4OE5| OC4OE4| OC4OE3| OC4OE2| OC4OE1| OC4OE0]
+#define TLOCK4 7
+#define ENHC4 6
+//TIMSK4 = [OCIE4D|OCIE4A|OCIE4B|   -  |   -  | TOIE4|   -  |   -  ]
+#define OCIE4D 7
+#define OCIE4A 6
+#define OCIE4B 5
+#define TOIE4 2
+#define OCF4D 7
+#define OCF4A 6
+#define OCF4B 5
+#define TOV4 2
+//PLLCSR = [   -  |   -  |   -  |PINDIV|   -  |   -  |  PLLE| PLOCK]
+#define PINDIV 4
+#define PLLE 1
+#define PLOCK 0
+//PLLFRQ = [PINMUX|PLLUSB|PLLTM1|PLLTM0| PDIV3| PDIV2| PDIV1| PDIV0]
+#define PINMUX 7
+#define PLLUSB 6
+#define PLLTM1 5
+#define PLLTM0 4
+#define PDIV3 3
+#define PDIV2 2
+#define PDIV1 1
+#define PDIV0 0
+#endif
+
+// Interrupt vectors are weak so the emulator can call whichever ones the sketch/library defines
+extern "C"
+{
+#if defined(__AVR_ATtinyX5__)
+	void TIMER1_COMPA_vect(void) __attribute__((weak));
+	void TIMER1_OVF_vect(void) __attribute__((weak));
+	void TIMER0_OVF_vect(void) __attribute__((weak));
+	void TIMER1_COMPB_vect(void) __attribute__((weak));
+	void TIMER0_COMPA_vect(void) __attribute__((weak));
+	void TIMER0_COMPB_vect(void) __attribute__((weak));
+#elif defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+	void TIMER2_COMPA_vect(void) __attribute__((weak));
+	void TIMER2_COMPB_vect(void) __attribute__((weak));
+	void TIMER2_OVF_vect(void) __attribute__((weak));
+	void TIMER1_COMPA_vect(void) __attribute__((weak));
+	void TIMER1_COMPB_vect(void) __attribute__((weak));
+	void TIMER1_OVF_vect(void) __attribute__((weak));
+	void TIMER0_COMPA_vect(void) __attribute__((weak));
+	void TIMER0_COMPB_vect(void) __attribute__((weak));
+	void TIMER0_OVF_vect(void) __attribute__((weak));
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	void TIMER1_COMPA_vect(void) __attribute__((weak));
+	void TIMER1_COMPB_vect(void) __attribute__((weak));
+	void TIMER1_COMPC_vect(void) __attribute__((weak));
+	void TIMER1_OVF_vect(void) __attribute__((weak));
+	void TIMER0_COMPA_vect(void) __attribute__((weak));
+	void TIMER0_COMPB_vect(void) __attribute__((weak));
+	void TIMER0_OVF_vect(void) __attribute__((weak));
+	void TIMER3_COMPA_vect(void) __attribute__((weak));
+	void TIMER3_COMPB_vect(void) __attribute__((weak));
+	void TIMER3_COMPC_vect(void) __attribute__((weak));
+	void TIMER3_OVF_vect(void) __attribute__((weak));
+	void TIMER4_COMPA_vect(void) __attribute__((weak));
+	void TIMER4_COMPB_vect(void) __attribute__((weak));
+	void TIMER4_COMPD_vect(void) __attribute__((weak));
+	void TIMER4_OVF_vect(void) __attribute__((weak));
+#endif
+	void ADC_vect(void) __attribute__((weak));
+}
+
+namespace pwm_host
+{
+	uint64_t now = 0; // CPU cycles since reset
+
+	//+----------------------------------------------------------------------+
+	//| Waveform measurement                                                 |
+	//+----------------------------------------------------------------------+
+	struct trace
+	{
+		uint8_t level;
+		uint32_t rises;
+		uint64_t first_rise, last_rise, last_fall;
+		uint64_t high_sum; // high cycles between first_rise and last_rise
+		uint32_t period, high; // last complete period
+
+		void update(const uint8_t new_level)
+		{
+			if (new_level == level) { return; }
+			level = new_level;
+			if (level)
+			{
+				if (rises == 0)
+				{
+					first_rise = now;
+				}
+				else
+				{
+					period = now - last_rise;
+					high = (last_fall > last_rise) ? last_fall - last_rise : 0;
+					high_sum += high;
+				}
+				last_rise = now;
+				++rises;
+			}
+			else
+			{
+				last_fall = now;
+			}
+		}
+	};
+
+	struct waveform
+	{
+		uint8_t level;     // current output level
+		uint32_t edges;    // rising edges seen
+		uint32_t period;   // last complete period (CPU cycles)
+		uint32_t high;     // high time of the last complete period (CPU cycles)
+		double frequency;  // average over every complete period (Hz)
+		double duty;       // average over every complete period [0,1]
+	};
+
+	waveform measure(const trace &t)
+	{
+		waveform w;
+		w.level = t.level;
+		w.edges = t.rises;
+		w.period = t.period;
+		w.high = t.high;
+		w.frequency = 0.0;
+		w.duty = t.level ? 1.0 : 0.0;
+		if (t.rises > 1)
+		{
+			const double span = double(t.last_rise - t.first_rise);
+			w.frequency = double(t.rises - 1) * double(F_CPU) / span;
+			w.duty = double(t.high_sum) / span;
+		}
+		return w;
+	}
+
+	//+----------------------------------------------------------------------+
+	//| Timer/Counter model                                                  |
+	//+----------------------------------------------------------------------+
+	enum { NORMAL, CTC, FAST, PHASE, PFC };
+
+	// timer events returned by tick() : [ OCFxD| OCFxC| OCFxB| OCFxA|  TOVx]
+	enum { EV_TOV = 0x01, EV_A = 0x02, EV_B = 0x04, EV_C = 0x08, EV_D = 0x10 };
+
+	struct channel_config
+	{
+		uint8_t com;           // COMx[10]
+		uint8_t pwm;           // channel is in a PWM mode
+		uint8_t toggle;        // COMx = 01 toggles OCx on compare match
+		uint8_t complementary; // COMx = 01 drives OCx and !OCx
+		uint16_t ocr;
+	};
+
+	struct timer_config
+	{
+		uint8_t mode;
+		uint16_t prescaler;  // 0 : stopped
+		uint16_t max;
+		uint16_t top;
+		uint8_t top_buffered;
+		uint8_t ocr_buffered;
+		uint8_t nch;
+		channel_config ch[4];
+	};
+
+	struct channel_state
+	{
+		uint16_t ocr;  // active (double buffered) compare value
+		uint8_t latch; // output state for the non-PWM modes
+		uint8_t dt_level;  // complementary pair : compare output before the dead time generator
+		uint64_t dt_since; // and the cycle it last changed
+		trace out, out_n;
+	};
+
+	struct timer_state
+	{
+		int8_t dir;
+		uint16_t top;  // active (double buffered) TOP
+		channel_state ch[4];
+	};
+
+	struct timer
+	{
+		timer_config c;
+		timer_state s;
+	};
+
+	// copy the double buffered registers (while stopped, or at the update point)
+	void load(timer &t)
+	{
+		t.s.top = t.c.top;
+		for (uint8_t i = 0; i < t.c.nch; ++i) { t.s.ch[i].ocr = t.c.ch[i].ocr; }
+	}
+
+	// advance a timer by one clock, tcnt is read and written back by the caller
+	uint8_t tick(timer &t, uint16_t &tcnt)
+	{
+		const timer_config &c = t.c;
+		timer_state &s = t.s;
+		const uint8_t dual = (c.mode == PHASE) | (c.mode == PFC);
+		const uint16_t top = c.top_buffered ? s.top : c.top;
+		uint16_t n = tcnt;
+		uint8_t ev = 0;
+
+		if (!c.ocr_buffered)
+		{
+			for (uint8_t i = 0; i < c.nch; ++i) { s.ch[i].ocr = c.ch[i].ocr; }
+		}
+
+		if (dual)
+		{
+			if (s.dir >= 0)
+			{
+				n = (n + 1) & c.max;
+				if (n >= top) { s.dir = -1; if (c.mode == PHASE) { load(t); } }
+			}
+			else
+			{
+				--n;
+				if (n == 0) { s.dir = 1; ev |= EV_TOV; if (c.mode == PFC) { load(t); } }
+			}
+		}
+		else
+		{
+			const uint16_t prev = n;
+			n = (n == top) ? 0 : ((n + 1) & c.max);
+			s.dir = 1;
+			if (c.mode == FAST)
+			{
+				// TOVx with the TOP compare, the buffered registers are loaded at BOTTOM
+				if ((n == top) & (prev != top)) { ev |= EV_TOV; }
+				if (n == 0) { load(t); }
+			}
+			else if ((n == 0) & (prev == c.max))
+			{
+				ev |= EV_TOV;
+			}
+		}
+		tcnt = n;
+
+		for (uint8_t i = 0; i < c.nch; ++i)
+		{
+			const channel_config &cc = c.ch[i];
+			channel_state &cs = s.ch[i];
+			const uint16_t ocr = cc.pwm ? cs.ocr : cc.ocr;
+			const uint8_t match = (n == ocr);
+			uint8_t level;
+
+			if (match) { ev |= (EV_A << i); }
+			if (cc.com == 0) { continue; }
+
+			if (cc.pwm & !cc.toggle)
+			{
+				if ((cc.com == 1) & !cc.complementary) { continue; }
+				if (dual)
+				{
+					level = (s.dir > 0) ? (n < ocr) : (n <= ocr);
+				}
+				else
+				{
+					level = (n <= ocr);
+				}
+				if (cc.com == 3) { level = !level; }
+			}
+			else
+			{
+				if (match)
+				{
+					switch (cc.com)
+					{
+					case 1: cs.latch = !cs.latch; break;
+					case 2: cs.latch = 0; break;
+					case 3: cs.latch = 1; break;
+					}
+				}
+				level = cs.latch;
+			}
+			if (cc.complementary)
+			{
+				// through the dead time generator (see dead_time)
+				if (level != cs.dt_level) { cs.dt_level = level; cs.dt_since = now; }
+			}
+			else
+			{
+				cs.out.update(level);
+			}
+		}
+		return ev;
+	}
+
+	// force output compare (FOCxn written as one, read as zero) : the compare action of the non-PWM
+	// modes without a match, no interrupt flag. Strobes : bit n for channel n
+	void force(timer &t, const uint8_t strobes)
+	{
+		for (uint8_t i = 0; i < t.c.nch; ++i)
+		{
+			const channel_config &cc = t.c.ch[i];
+			channel_state &cs = t.s.ch[i];
+			if (((strobes & _BV(i)) == 0) | cc.pwm | (cc.com == 0)) { continue; }
+			switch (cc.com)
+			{
+			case 1: cs.latch = !cs.latch; break;
+			case 2: cs.latch = 0; break;
+			case 3: cs.latch = 1; break;
+			}
+			cs.out.update(cs.latch);
+		}
+	}
+
+	// map tick() events onto a TIFRx register, 0xFF : no flag
+	uint8_t flags(const uint8_t ev, const uint8_t tov, const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d)
+	{
+		uint8_t f = 0;
+		if ((ev & EV_TOV) & (tov != 0xFF)) { f |= _BV(tov); }
+		if ((ev & EV_A) && (a != 0xFF)) { f |= _BV(a); }
+		if ((ev & EV_B) && (b != 0xFF)) { f |= _BV(b); }
+		if ((ev & EV_C) && (c != 0xFF)) { f |= _BV(c); }
+		if ((ev & EV_D) && (d != 0xFF)) { f |= _BV(d); }
+		return f;
+	}
+
+	// regular prescalar list, CSx[210] = 6,7 (external clock) is treated as stopped
+	const uint16_t PS_regular[8] = { 0,1,8,64,256,1024,0,0 };
+	// Timer2 (ATmega328p) prescalar list
+	const uint16_t PS_timer2[8] = { 0,1,8,32,64,128,256,1024 };
+	// extended prescalar list (ATtinyX5 Timer1, ATmega32u4 Timer4)
+	const uint16_t PS_extended[16] = { 0,1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384 };
+
+	// 8b timer with OCRxA as TOP : Timer0, Timer2 (ATmega328p)
+	void decode8(timer_config &c, const uint8_t tccra, const uint8_t tccrb, const uint8_t ocra, const uint8_t ocrb, const uint16_t *ps)
+	{
+		//TCCRxA = [COMxA1|COMxA0|COMxB1|COMxB0|   -  |   -  | WGMx1| WGMx0]
+		//TCCRxB = [ FOCxA| FOCxB|   -  |   -  | WGMx2|  CSx2|  CSx1|  CSx0]
+		static const uint8_t mode[8] = { NORMAL, PHASE, CTC, FAST, NORMAL, PHASE, NORMAL, FAST };
+		const uint8_t wgm = ((tccrb >> 1) & 0x4) | (tccra & 0x3);
+
+		c.mode = mode[wgm];
+		c.prescaler = ps[tccrb & 0x7];
+		c.max = 0xFF;
+		c.top = ((wgm == 2) | (wgm == 5) | (wgm == 7)) ? ocra : 0xFF;
+		c.top_buffered = (wgm == 5) | (wgm == 7);
+		c.ocr_buffered = (c.mode >= FAST);
+		c.nch = 2;
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			c.ch[i].com = (tccra >> (6 - 2 * i)) & 0x3;
+			c.ch[i].pwm = (c.mode >= FAST);
+			c.ch[i].toggle = !c.ch[i].pwm;
+			c.ch[i].complementary = 0;
+		}
+		c.ch[0].toggle |= (wgm >> 2); // OCxA toggles when OCRxA is TOP
+		c.ch[0].ocr = ocra;
+		c.ch[1].ocr = ocrb;
+	}
+
+#if !defined(__AVR_ATtinyX5__)
+	// 16b timer : Timer1, Timer3 (ATmega32u4)
+	void decode16(timer_config &c, const uint8_t tccra, const uint8_t tccrb, const uint16_t icr, const uint16_t ocra, const uint16_t ocrb, const uint16_t ocrc, const uint8_t nch)
+	{
+		//TCCRxA = [COMxA1|COMxA0|COMxB1|COMxB0|COMxC1|COMxC0| WGMx1| WGMx0]
+		//TCCRxB = [ ICNCx| ICESx|   -  | WGMx3| WGMx2|  CSx2|  CSx1|  CSx0]
+		static const uint8_t mode[16] = { NORMAL, PHASE, PHASE, PHASE, CTC, FAST, FAST, FAST, PFC, PFC, PHASE, PHASE, CTC, NORMAL, FAST, FAST };
+		static const uint16_t fixed_top[16] = { 0xFFFF, 0xFF, 0x1FF, 0x3FF, 0, 0xFF, 0x1FF, 0x3FF, 0, 0, 0, 0, 0, 0xFFFF, 0, 0 };
+		const uint8_t wgm = ((tccrb >> 1) & 0xC) | (tccra & 0x3);
+		const uint8_t ocra_top = (wgm == 4) | (wgm == 9) | (wgm == 11) | (wgm == 15);
+		const uint8_t icr_top = (wgm == 8) | (wgm == 10) | (wgm == 12) | (wgm == 14);
+
+		c.mode = mode[wgm];
+		c.prescaler = PS_regular[tccrb & 0x7];
+		c.max = 0xFFFF;
+		c.top = ocra_top ? ocra : (icr_top ? icr : fixed_top[wgm]);
+		c.top_buffered = ocra_top & (c.mode >= FAST);
+		c.ocr_buffered = (c.mode >= FAST);
+		c.nch = nch;
+		for (uint8_t i = 0; i < nch; ++i)
+		{
+			c.ch[i].com = (tccra >> (6 - 2 * i)) & 0x3;
+			c.ch[i].pwm = (c.mode >= FAST);
+			c.ch[i].toggle = !c.ch[i].pwm;
+			c.ch[i].complementary = 0;
+		}
+		c.ch[0].toggle |= (wgm == 9) | (wgm == 11) | (wgm == 15);
+		c.ch[0].ocr = ocra;
+		c.ch[1].ocr = ocrb;
+		c.ch[2].ocr = ocrc;
+	}
+#endif
+
+	//+----------------------------------------------------------------------+
+	//| Per chip peripherals                                                 |
+	//+----------------------------------------------------------------------+
+	struct vector
+	{
+		volatile uint8_t *flag;
+		uint8_t flag_bit;
+		volatile uint8_t *mask;
+		uint8_t mask_bit;
+		void(*isr)(void);
+	};
+
+	uint16_t psc_sync = 0; // shared prescaler
+	uint16_t psc_async = 0; // Timer2 (ATmega328p) / Timer1 (ATtinyX5) / Timer4 (ATmega32u4) prescaler
+	uint32_t async_phase = 0; // Timer1 (ATtinyX5) / Timer4 (ATmega32u4) source clock, in Hz past the last CPU cycle
+
+	// source clock edges of a fast peripheral clock (the PLL) in this CPU cycle, whole clocks on average
+	uint8_t async_clocks(const uint32_t ClockHz)
+	{
+		async_phase += ClockHz;
+		uint8_t n = 0;
+		while (async_phase >= F_CPU)
+		{
+			async_phase -= F_CPU;
+			++n;
+		}
+		return n;
+	}
+
+	// clock a timer from its prescaler, and set its interrupt flags
+	// dead time generator of the complementary pairs, every CPU cycle : the rising edge of OCxn is
+	// delayed by DT[7:4], the one of !OCxn by DT[3:0] counts of 2^DTPS cycles of the timer source clock (ClockHz)
+	void dead_time(timer &t, const uint8_t DT, const uint8_t DTPS, const uint32_t ClockHz)
+	{
+		const uint64_t rise = (uint64_t)(DT >> 4) << DTPS;
+		const uint64_t fall = (uint64_t)(DT & 0xF) << DTPS;
+		for (uint8_t i = 0; i < t.c.nch; ++i)
+		{
+			if (!t.c.ch[i].complementary) { continue; }
+			channel_state &cs = t.s.ch[i];
+			const uint64_t held = (now - cs.dt_since) * ClockHz / F_CPU;
+			cs.out.update(cs.dt_level & (held >= rise));
+			cs.out_n.update(!cs.dt_level & (held >= fall));
+		}
+	}
+
+	template <typename T>
+	uint8_t clock(timer &t, const uint16_t psc, volatile T &tcnt)
+	{
+		if (t.c.prescaler == 0)
+		{
+			load(t);
+			t.s.dir = 1;
+			return 0;
+		}
+		if (psc & (t.c.prescaler - 1)) { return 0; }
+		uint16_t n = tcnt;
+		const uint8_t ev = tick(t, n);
+		tcnt = n;
+		return ev;
+	}
+
+	// halts (TSM) or resets a prescaler, returns false while halted. Held : TSM keeps the reset
+	// asserted (not PSR1 of the ATtinyX5, which clears itself)
+	bool prescaler_reset(uint16_t &psc, const uint8_t psr, const bool Held = true)
+	{
+		if (GTCCR & _BV(psr))
+		{
+			psc = 0;
+			if (Held & ((GTCCR & _BV(7)) != 0)) { return false; } // TSM : keep the prescaler reset asserted
+			GTCCR &= ~_BV(psr);
+		}
+		++psc;
+		return true;
+	}
+
+#if defined(__AVR_ATtinyX5__)
+	timer timers[2];
+	const uint8_t timer_id[2] = { 0,1 };
+
+	const vector vectors[] = {
+		{ &TIFR.v, OCF1A, &TIMSK, OCIE1A, &TIMER1_COMPA_vect },
+		{ &TIFR.v, TOV1,  &TIMSK, TOIE1,  &TIMER1_OVF_vect },
+		{ &TIFR.v, TOV0,  &TIMSK, TOIE0,  &TIMER0_OVF_vect },
+		{ &TIFR.v, OCF1B, &TIMSK, OCIE1B, &TIMER1_COMPB_vect },
+		{ &TIFR.v, OCF0A, &TIMSK, OCIE0A, &TIMER0_COMPA_vect },
+		{ &TIFR.v, OCF0B, &TIMSK, OCIE0B, &TIMER0_COMPB_vect },
+		{ &ADCSRA.v, ADIF, &ADCSRA.v, ADIE, &ADC_vect },
+	};
+
+	volatile uint8_t *const ports[1] = { &PORTB };
+	volatile uint8_t *const ddrs[1] = { &DDRB };
+	// Arduino pin -> [port index (PB=2), bit]
+	const uint8_t pin_port[6] = { PB,PB,PB,PB,PB,PB };
+	const uint8_t pin_bit[6] = { 0,1,2,3,4,5 };
+
+	void clock_timers()
+	{
+		const uint8_t run0 = prescaler_reset(psc_sync, PSR0);
+		uint8_t ev;
+
+		decode8(timers[0].c, TCCR0A, TCCR0B, OCR0A, OCR0B, PS_regular);
+		if (run0)
+		{
+			ev = clock(timers[0], psc_sync, TCNT0);
+			TIFR.v |= flags(ev, TOV0, OCF0A, OCF0B, 0xFF, 0xFF);
+		}
+
+		//TCCR1 =  [  CTC1| PWM1A|COM1A1|COM1A0|  CS13|  CS12|  CS11|  CS10]
+		//GTCCR =  [   TSM| PWM1B|COM1B1|COM1B0| FOC1B| FOC1A|  PSR1|  PSR0]
+		timer_config &c = timers[1].c;
+		const uint8_t pwm_a = (TCCR1 >> PWM1A) & 1;
+		const uint8_t pwm_b = (GTCCR >> PWM1B) & 1;
+		c.mode = (pwm_a | pwm_b) ? FAST : ((TCCR1 & _BV(CTC1)) ? CTC : NORMAL);
+		c.prescaler = PS_extended[TCCR1 & 0xF];
+		c.max = 0xFF;
+		c.top = (c.mode == NORMAL) ? 0xFF : OCR1C;
+		c.top_buffered = 0;
+		c.ocr_buffered = 0;
+		c.nch = 2;
+		c.ch[0].com = (TCCR1 >> COM1A0) & 0x3;
+		c.ch[0].pwm = pwm_a;
+		c.ch[0].ocr = OCR1A;
+		c.ch[1].com = (GTCCR >> COM1B0) & 0x3;
+		c.ch[1].pwm = pwm_b;
+		c.ch[1].ocr = OCR1B;
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			c.ch[i].toggle = !c.ch[i].pwm;
+			c.ch[i].complementary = c.ch[i].pwm & (c.ch[i].com == 1);
+		}
+		if (GTCCR & (_BV(FOC1B) | _BV(FOC1A)))
+		{
+			force(timers[1], ((GTCCR >> FOC1A) & 1) | (((GTCCR >> FOC1B) & 1) << 1));
+			GTCCR &= ~_BV(FOC1B) & ~_BV(FOC1A);
+		}
+		// PCK : 64MHz PLL, 32MHz in low speed mode
+		const uint32_t clock1 = (PLLCSR & _BV(PCKE)) ? ((PLLCSR & _BV(LSM)) ? 32000000UL : 64000000UL) : F_CPU;
+		for (uint8_t n = async_clocks(clock1); n > 0; --n)
+		{
+			if (prescaler_reset(psc_async, PSR1, false))
+			{
+				ev = clock(timers[1], psc_async, TCNT1);
+				TIFR.v |= flags(ev, TOV1, OCF1A, OCF1B, 0xFF, 0xFF);
+			}
+		}
+		dead_time(timers[1], 0, 0, clock1);
+	}
+#elif defined(__AVR_ATmega328p__) | defined(__AVR_ATmega328P__)
+	timer timers[3];
+	const uint8_t timer_id[3] = { 0,1,2 };
+
+	const vector vectors[] = {
+		{ &TIFR2.v, OCF2A, &TIMSK2, OCIE2A, &TIMER2_COMPA_vect },
+		{ &TIFR2.v, OCF2B, &TIMSK2, OCIE2B, &TIMER2_COMPB_vect },
+		{ &TIFR2.v, TOV2,  &TIMSK2, TOIE2,  &TIMER2_OVF_vect },
+		{ &TIFR1.v, OCF1A, &TIMSK1, OCIE1A, &TIMER1_COMPA_vect },
+		{ &TIFR1.v, OCF1B, &TIMSK1, OCIE1B, &TIMER1_COMPB_vect },
+		{ &TIFR1.v, TOV1,  &TIMSK1, TOIE1,  &TIMER1_OVF_vect },
+		{ &TIFR0.v, OCF0A, &TIMSK0, OCIE0A, &TIMER0_COMPA_vect },
+		{ &TIFR0.v, OCF0B, &TIMSK0, OCIE0B, &TIMER0_COMPB_vect },
+		{ &TIFR0.v, TOV0,  &TIMSK0, TOIE0,  &TIMER0_OVF_vect },
+		{ &ADCSRA.v, ADIF, &ADCSRA.v, ADIE,  &ADC_vect },
+	};
+
+	volatile uint8_t *const ports[3] = { &PORTB, &PORTC, &PORTD };
+	volatile uint8_t *const ddrs[3] = { &DDRB, &DDRC, &DDRD };
+	const uint8_t pin_port[20] = { PD,PD,PD,PD,PD,PD,PD,PD, PB,PB,PB,PB,PB,PB, PC,PC,PC,PC,PC,PC };
+	const uint8_t pin_bit[20] = { 0,1,2,3,4,5,6,7, 0,1,2,3,4,5, 0,1,2,3,4,5 };
+
+	void clock_timers()
+	{
+		const uint8_t run = prescaler_reset(psc_sync, PSRSYNC);
+		const uint8_t run2 = prescaler_reset(psc_async, PSRASY);
+		uint8_t ev;
+
+		decode8(timers[0].c, TCCR0A, TCCR0B, OCR0A, OCR0B, PS_regular);
+		decode16(timers[1].c, TCCR1A, TCCR1B, ICR1, OCR1A, OCR1B, 0, 2);
+		decode8(timers[2].c, TCCR2A, TCCR2B, OCR2A, OCR2B, PS_timer2);
+		//TCCR1C = [ FOC1A| FOC1B|   -  |   -  |   -  |   -  |   -  |   -  ]
+		if (TCCR1C) { force(timers[1], ((TCCR1C >> FOC1A) & 1) | (((TCCR1C >> FOC1B) & 1) << 1)); TCCR1C = 0; }
+		if (run)
+		{
+			ev = clock(timers[0], psc_sync, TCNT0);
+			TIFR0.v |= flags(ev, TOV0, OCF0A, OCF0B, 0xFF, 0xFF);
+			ev = clock(timers[1], psc_sync, TCNT1);
+			TIFR1.v |= flags(ev, TOV1, OCF1A, OCF1B, 0xFF, 0xFF);
+		}
+		if (run2)
+		{
+			ev = clock(timers[2], psc_async, TCNT2);
+			TIFR2.v |= flags(ev, TOV2, OCF2A, OCF2B, 0xFF, 0xFF);
+		}
+	}
+#elif defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+	timer timers[4];
+	const uint8_t timer_id[4] = { 0,1,3,4 };
+
+	const vector vectors[] = {
+		{ &TIFR1.v, OCF1A, &TIMSK1, OCIE1A, &TIMER1_COMPA_vect },
+		{ &TIFR1.v, OCF1B, &TIMSK1, OCIE1B, &TIMER1_COMPB_vect },
+		{ &TIFR1.v, OCF1C, &TIMSK1, OCIE1C, &TIMER1_COMPC_vect },
+		{ &TIFR1.v, TOV1,  &TIMSK1, TOIE1,  &TIMER1_OVF_vect },
+		{ &TIFR0.v, OCF0A, &TIMSK0, OCIE0A, &TIMER0_COMPA_vect },
+		{ &TIFR0.v, OCF0B, &TIMSK0, OCIE0B, &TIMER0_COMPB_vect },
+		{ &TIFR0.v, TOV0,  &TIMSK0, TOIE0,  &TIMER0_OVF_vect },
+		{ &TIFR3.v, OCF3A, &TIMSK3, OCIE3A, &TIMER3_COMPA_vect },
+		{ &TIFR3.v, OCF3B, &TIMSK3, OCIE3B, &TIMER3_COMPB_vect },
+		{ &TIFR3.v, OCF3C, &TIMSK3, OCIE3C, &TIMER3_COMPC_vect },
+		{ &TIFR3.v, TOV3,  &TIMSK3, TOIE3,  &TIMER3_OVF_vect },
+		{ &TIFR4.v, OCF4A, &TIMSK4, OCIE4A, &TIMER4_COMPA_vect },
+		{ &TIFR4.v, OCF4B, &TIMSK4, OCIE4B, &TIMER4_COMPB_vect },
+		{ &TIFR4.v, OCF4D, &TIMSK4, OCIE4D, &TIMER4_COMPD_vect },
+		{ &TIFR4.v, TOV4,  &TIMSK4, TOIE4,  &TIMER4_OVF_vect },
+		{ &ADCSRA.v, ADIF, &ADCSRA.v, ADIE,  &ADC_vect },
+	};
+
+	volatile uint8_t *const ports[5] = { &PORTB, &PORTC, &PORTD, &PORTE, &PORTF };
+	volatile uint8_t *const ddrs[5] = { &DDRB, &DDRC, &DDRD, &DDRE, &DDRF };
+	// Arduino Leonardo / Micro / Pro Micro pin mapping
+	const uint8_t pin_port[31] = { PD,PD,PD,PD,PD,PC,PD,PE, PB,PB,PB,PB,PD,PC, PB,PB,PB,PB, PF,PF,PF,PF,PF,PF, PD,PD,PB,PB,PB,PD,PD };
+	const uint8_t pin_bit[31] = { 2,3,1,0,4,6,7,6, 4,5,6,7,6,7, 3,1,2,0, 7,6,5,4,1,0, 4,7,4,5,6,6,5 };
+
+	// Timer4 source clock : clkI/O, or the PLL output (PDIV) through the postscaler (PLLTM : / 1, 1.5 or 2)
+	uint32_t timer4_clock()
+	{
+		//                                    -  -  -  40  48  56  -  72  80  88  96 MHz
+		static const uint8_t pll_mhz[16] = { 0, 0, 0, 40, 48, 56, 0, 72, 80, 88, 96, 0, 0, 0, 0, 0 };
+		const uint8_t tm = (PLLFRQ >> PLLTM0) & 0x3;
+		if ((tm == 0) | !(PLLCSR & _BV(PLOCK))) { return F_CPU; }
+		return pll_mhz[PLLFRQ & 0xF] * 2000000UL / (tm + 1);
+	}
+
+	void clock_timers()
+	{
+		const uint8_t run = prescaler_reset(psc_sync, PSRSYNC);
+		uint8_t ev;
+
+		decode8(timers[0].c, TCCR0A, TCCR0B, OCR0A, OCR0B, PS_regular);
+		decode16(timers[1].c, TCCR1A, TCCR1B, ICR1, OCR1A, OCR1B, OCR1C, 3);
+		decode16(timers[2].c, TCCR3A, TCCR3B, ICR3, OCR3A, OCR3B, OCR3C, 3);
+		//TCCR1C = [ FOC1A| FOC1B| FOC1C|   -  |   -  |   -  |   -  |   -  ]
+		if (TCCR1C) { force(timers[1], ((TCCR1C >> FOC1A) & 1) | (((TCCR1C >> FOC1B) & 1) << 1) | (((TCCR1C >> FOC1C) & 1) << 2)); TCCR1C = 0; }
+		if (run)
+		{
+			ev = clock(timers[0], psc_sync, TCNT0);
+			TIFR0.v |= flags(ev, TOV0, OCF0A, OCF0B, 0xFF, 0xFF);
+			ev = clock(timers[1], psc_sync, TCNT1);
+			TIFR1.v |= flags(ev, TOV1, OCF1A, OCF1B, OCF1C, 0xFF);
+			ev = clock(timers[2], psc_sync, TCNT3);
+			TIFR3.v |= flags(ev, TOV3, OCF3A, OCF3B, OCF3C, 0xFF);
+		}
+
+		//TCCR4A = [ COM4A1| COM4A0| COM4B1| COM4B0| FOC4A| FOC4B| PWM4A| PWM4B]
+		//TCCR4B = [  PWM4X|   PSR4| DTPS41| DTPS40|  CS43|  CS42|  CS41|  CS40]
+		//TCCR4C = [COM4A1S|COM4A0S|COM4B1S|COM4B0S|COM4D1|COM4D0| FOC4D| PWM4D]
+		//TCCR4D = [  FPIE4|  FPEN4|  FPNC4|  FPES4| FPAC4|  FPF4| WGM41| WGM40]
+		timer_config &c = timers[3].c;
+		const uint8_t pwm[4] = { uint8_t((TCCR4A >> PWM4A) & 1), uint8_t((TCCR4A >> PWM4B) & 1), 0, uint8_t((TCCR4C >> PWM4D) & 1) };
+		c.mode = (pwm[0] | pwm[1] | pwm[3]) ? ((TCCR4D & _BV(WGM40)) ? PFC : FAST) : CTC;
+		c.prescaler = PS_extended[TCCR4B & 0xF];
+		c.max = 0x3FF;
+		c.top = OCR4C.v;
+		c.top_buffered = (c.mode != CTC);
+		c.ocr_buffered = (c.mode != CTC);
+		c.nch = 4;
+		c.ch[0].com = (TCCR4A >> COM4A0) & 0x3;
+		c.ch[0].ocr = OCR4A.v;
+		c.ch[1].com = (TCCR4A >> COM4B0) & 0x3;
+		c.ch[1].ocr = OCR4B.v;
+		c.ch[2].com = 0;
+		c.ch[2].ocr = OCR4C.v;
+		c.ch[3].com = (TCCR4C >> COM4D0) & 0x3;
+		c.ch[3].ocr = OCR4D.v;
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			c.ch[i].pwm = pwm[i];
+			c.ch[i].toggle = !pwm[i];
+			c.ch[i].complementary = pwm[i] & (c.ch[i].com == 1);
+		}
+		const uint32_t clock4 = timer4_clock();
+		for (uint8_t n = async_clocks(clock4); n > 0; --n)
+		{
+			if (TCCR4B & _BV(PSR4))
+			{
+				psc_async = 0;
+				TCCR4B &= ~_BV(PSR4);
+			}
+			++psc_async;
+			ev = clock(timers[3], psc_async, TCNT4.v);
+			TIFR4.v |= flags(ev, TOV4, OCF4A, OCF4B, 0xFF, OCF4D);
+		}
+		//DT4    = [ DT4H3| DT4H2| DT4H1| DT4H0| DT4L3| DT4L2| DT4L1| DT4L0]
+		dead_time(timers[3], DT4, (TCCR4B >> DTPS40) & 0x3, clock4);
+	}
+#endif
+
+	//+----------------------------------------------------------------------+
+	//| ADC                                                                  |
+	//+----------------------------------------------------------------------+
+	// the input selected by MUX (ADMUX MUX bits, and MUX5 on the ATmega32u4), a 10 bit result
+	uint16_t (*adc_input)(const uint8_t Mux) = 0;
+
+	struct adc_state
+	{
+		uint8_t enabled;   // ADEN seen, the next conversion is the first one
+		uint8_t trigger;   // level of the auto trigger source last cycle
+		uint8_t busy, held;
+		uint64_t hold, done;
+		uint16_t sample;
+	};
+	adc_state adc;
+
+	// level of the auto trigger source ADTS (ADCSRB)
+	uint8_t adc_trigger(const uint8_t ADTS)
+	{
+		switch (ADTS)
+		{
+		case 0: return (ADCSRA >> ADIF) & 1; // free running
+#if defined(__AVR_ATtinyX5__)
+		case 3: return (TIFR.v >> OCF0A) & 1;
+		case 4: return (TIFR.v >> TOV0) & 1;
+		case 5: return (TIFR.v >> OCF0B) & 1;
+#else
+		case 3: return (TIFR0.v >> OCF0A) & 1;
+		case 4: return (TIFR0.v >> TOV0) & 1;
+		case 5: return (TIFR1.v >> OCF1B) & 1;
+		case 6: return (TIFR1.v >> TOV1) & 1;
+#endif
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+		case 8: return (TIFR4.v >> TOV4) & 1;
+		case 9: return (TIFR4.v >> OCF4A) & 1;
+		case 10: return (TIFR4.v >> OCF4B) & 1;
+		case 11: return (TIFR4.v >> OCF4D) & 1;
+#endif
+		}
+		return 0;
+	}
+
+	void clock_adc()
+	{
+		if (!(ADCSRA & _BV(ADEN)))
+		{
+			adc.enabled = 0;
+			adc.busy = 0;
+			return;
+		}
+#if defined(__AVR_ATmega32u4__) | defined(__AVR_ATmega32U4__)
+		const uint8_t ADTS = ADCSRB & 0x0F;
+		const uint8_t Mux = (ADMUX & 0x1F) | ((ADCSRB & _BV(MUX5)) ? 0x20 : 0);
+#else
+		const uint8_t ADTS = ADCSRB & 0x07;
+		const uint8_t Mux = ADMUX & 0x0F;
+#endif
+		const uint8_t level = adc_trigger(ADTS);
+		const uint8_t edge = level & !adc.trigger;
+		adc.trigger = level;
+
+		const uint32_t div = (ADCSRA & 0x7) ? (1 << (ADCSRA & 0x7)) : 2;
+		if (!adc.busy)
+		{
+			if ((ADCSRA & _BV(ADSC)) | ((ADCSRA >> ADATE) & edge))
+			{
+				const uint8_t first = !adc.enabled;
+				adc.enabled = 1;
+				adc.busy = 1;
+				adc.held = 0;
+				adc.hold = now + (first ? 27 * div / 2 : 2 * div);
+				adc.done = now + (first ? 25 * div : 27 * div / 2);
+				ADCSRA.v |= _BV(ADSC);
+			}
+			return;
+		}
+		if (!adc.held & (now >= adc.hold))
+		{
+			adc.sample = adc_input ? (adc_input(Mux) & 0x3FF) : 0;
+			adc.held = 1;
+		}
+		if (now >= adc.done)
+		{
+			ADC = (ADMUX & _BV(ADLAR)) ? (adc.sample << 6) : adc.sample;
+			ADCSRA.v = (ADCSRA.v & ~_BV(ADSC)) | _BV(ADIF);
+			adc.busy = 0;
+		}
+	}
+
+	const uint8_t n_timers = sizeof(timers) / sizeof(timers[0]);
+	const uint8_t n_ports = sizeof(ports) / sizeof(ports[0]);
+	const uint8_t n_pins = sizeof(pin_port);
+
+	uint8_t port_last[n_ports];
+	trace port_trace[n_ports][8];
+
+	void sample_ports()
+	{
+		for (uint8_t p = 0; p < n_ports; ++p)
+		{
+			const uint8_t v = *ports[p];
+			const uint8_t changed = v ^ port_last[p];
+			if (changed == 0) { continue; }
+			for (uint8_t b = 0; b < 8; ++b)
+			{
+				if (changed & _BV(b)) { port_trace[p][b].update((v >> b) & 1); }
+			}
+			port_last[p] = v;
+		}
+	}
+
+	void(*entering)(void) = 0; // ISR taken, its body runs once entry_wait reaches 0
+	uint8_t entry_wait = 0;
+
+	void run_isr()
+	{
+		void(*isr)(void) = entering;
+		entering = 0;
+		if (isr) { isr(); }
+		SREG |= 0x80;
+	}
+
+	// service the highest priority pending interrupt : its flag is cleared and the I-bit held off
+	// at once, the ISR body runs PWM_HOST_ISR_CYCLES later
+	void dispatch()
+	{
+		if (entry_wait)
+		{
+			if (!--entry_wait) { run_isr(); }
+			return;
+		}
+		if (!(SREG & 0x80)) { return; }
+		for (uint8_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i)
+		{
+			const vector &v = vectors[i];
+			if ((*v.flag & _BV(v.flag_bit)) && (*v.mask & _BV(v.mask_bit)))
+			{
+				*v.flag &= ~_BV(v.flag_bit);
+				SREG &= ~0x80;
+				entering = v.isr;
+				entry_wait = PWM_HOST_ISR_CYCLES;
+				if (!entry_wait) { run_isr(); }
+				return;
+			}
+		}
+	}
+
+	//+----------------------------------------------------------------------+
+	//| Emulator control                                                     |
+	//+----------------------------------------------------------------------+
+	void step(uint64_t cycles)
+	{
+		while (cycles--)
+		{
+			++now;
+			clock_timers();
+			clock_adc();
+			sample_ports();
+			dispatch();
+		}
+	}
+
+	// power-on reset, with interrupts enabled as they are after the Arduino init()
+	void reset()
+	{
+		memset((void *)&sfr, 0, sizeof(sfr));
+		memset((void *)timers, 0, sizeof(timers));
+		memset((void *)port_last, 0, sizeof(port_last));
+		memset((void *)port_trace, 0, sizeof(port_trace));
+		now = 0;
+		entering = 0;
+		entry_wait = 0;
+		psc_sync = 0;
+		psc_async = 0;
+		async_phase = 0;
+		memset((void *)&adc, 0, sizeof(adc));
+		SREG = 0x80;
+	}
+
+	timer *find(const uint8_t Timer)
+	{
+		for (uint8_t i = 0; i < n_timers; ++i)
+		{
+			if (timer_id[i] == Timer) { return &timers[i]; }
+		}
+		return 0;
+	}
+
+	uint8_t channel_index(const char ABCD_out)
+	{
+		switch (ABCD_out)
+		{
+		case 'b':
+		case 'B':
+			return 1;
+		case 'c':
+		case 'C':
+			return 2;
+		case 'd':
+		case 'D':
+			return 3;
+		default:
+			return 0;
+		}
+	}
+
+	// measured waveform of OCxn (or !OCxn for the complementary outputs)
+	waveform channel(const uint8_t Timer, const char ABCD_out, const bool complementary = false)
+	{
+		timer *t = find(Timer);
+		if (t == 0) { return measure(trace()); }
+		const channel_state &cs = t->s.ch[channel_index(ABCD_out)];
+		return measure(complementary ? cs.out_n : cs.out);
+	}
+
+	// measured waveform of an Arduino pin driven through PORTx
+	waveform pin(const uint8_t pin)
+	{
+		if (pin >= n_pins) { return measure(trace()); }
+		return measure(port_trace[pin_port[pin] - PB][pin_bit[pin]]);
+	}
+
+	void print_waveform(const char *name, const waveform &w)
+	{
+		printf("%-8s : %10.3f Hz, %7.3f %% duty, %6u edges, last period %u cycles (%u high)\n",
+			name, w.frequency, 100.0 * w.duty, (unsigned)w.edges, (unsigned)w.period, (unsigned)w.high);
+	}
+
+	// print every compare output that has toggled
+	void print()
+	{
+		char name[16];
+		for (uint8_t i = 0; i < n_timers; ++i)
+		{
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				const channel_state &cs = timers[i].s.ch[j];
+				if (cs.out.rises)
+				{
+					snprintf(name, sizeof(name), "OC%u%c", timer_id[i], 'A' + j);
+					print_waveform(name, measure(cs.out));
+				}
+				if (cs.out_n.rises)
+				{
+					snprintf(name, sizeof(name), "!OC%u%c", timer_id[i], 'A' + j);
+					print_waveform(name, measure(cs.out_n));
+				}
+			}
+		}
+	}
+
+	struct serial
+	{
+		void begin(const unsigned long) {}
+		explicit operator bool() const { return true; }
+
+		void print(const char *s) { fputs(s, stdout); }
+		void print(const std::string &s) { fputs(s.c_str(), stdout); }
+		void print(const char c) { putchar(c); }
+		void print(const double d, const int digits = 2) { printf("%.*f", digits, d); }
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value>::type print(const T v, const int base = DEC)
+		{
+			char buf[8 * sizeof(long long) + 1];
+			char *p = buf + sizeof(buf) - 1;
+			unsigned long long u = (v < 0) ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+			*p = '\0';
+			do { *--p = "0123456789ABCDEF"[u % base]; u /= base; } while (u);
+			if ((v < 0) & (base == DEC)) { *--p = '-'; }
+			fputs(p, stdout);
+		}
+		template <typename T>
+		void println(const T v) { print(v); putchar('\n'); }
+		template <typename T>
+		void println(const T v, const int base) { print(v, base); putchar('\n'); }
+		void println() { putchar('\n'); }
+	};
+}
+
+pwm_host::serial Serial;
+
+inline void sei() { SREG |= 0x80; }
+inline void cli() { SREG &= ~0x80; }
+
+#define ATOMIC_RESTORESTATE 1
+#define ATOMIC_FORCEON 0
+#define NONATOMIC_RESTORESTATE 1
+namespace pwm_host
+{
+	struct atomic
+	{
+		uint8_t sreg, once;
+		atomic(const uint8_t restore) : sreg(restore ? uint8_t(SREG) : uint8_t(0x80)), once(1) { cli(); }
+		~atomic() { SREG = sreg; }
+	};
+}
+#define ATOMIC_BLOCK(type) for (pwm_host::atomic _pwm_atomic(type); _pwm_atomic.once; _pwm_atomic.once = 0)
+
+#define digitalPinToPort(P) (((P) < pwm_host::n_pins) ? pwm_host::pin_port[P] : NOT_A_PIN)
+#define digitalPinToBitMask(P) (((P) < pwm_host::n_pins) ? _BV(pwm_host::pin_bit[P]) : 0)
+#define portOutputRegister(P) (pwm_host::ports[(P) - PB])
+#define portModeRegister(P) (pwm_host::ddrs[(P) - PB])
+
+void pinMode(const uint8_t pin, const uint8_t mode)
+{
+	if (pin >= pwm_host::n_pins) { return; }
+	volatile uint8_t *ddr = portModeRegister(digitalPinToPort(pin));
+	volatile uint8_t *port = portOutputRegister(digitalPinToPort(pin));
+	const uint8_t mask = digitalPinToBitMask(pin);
+	if (mode == OUTPUT) { *ddr |= mask; }
+	else { *ddr &= ~mask; if (mode == INPUT_PULLUP) { *port |= mask; } else { *port &= ~mask; } }
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t val)
+{
+	if (pin >= pwm_host::n_pins) { return; }
+	volatile uint8_t *port = portOutputRegister(digitalPinToPort(pin));
+	const uint8_t mask = digitalPinToBitMask(pin);
+	if (val == LOW) { *port &= ~mask; }
+	else { *port |= mask; }
+}
+
+int digitalRead(const uint8_t pin)
+{
+	if (pin >= pwm_host::n_pins) { return LOW; }
+	return (*portOutputRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+unsigned long millis() { return (unsigned long)(pwm_host::now / (F_CPU / 1000UL)); }
+unsigned long micros() { return (unsigned long)(pwm_host::now / (F_CPU / 1000000UL)); }
+void delay(const unsigned long ms) { pwm_host::step((uint64_t)ms * (F_CPU / 1000UL)); }
+void delayMicroseconds(const unsigned int us) { pwm_host::step((uint64_t)us * (F_CPU / 1000000UL)); }
+
+#endif
@@ -0,0 +1,1218 @@
+// Host regression : the library against the emulated timers of PWM_host.h
+// make -C test builds and runs it for the ATmega328p, the ATmega32u4 and the ATtiny85, or :
+//   g++ -std=gnu++11 -I.. -DPWM_HOST -D__AVR_ATmega328P__ host.cpp && ./a.out
+// One test per feature, a failed CHECK prints its line, the exit status is the number of failures.
+// make also builds it with PWM_ISR_STATIC : every test then runs through the vectors bound below, with
+// PWM_DECIMATE, and with PWM_PROFILE (not on the ATtinyX5, which has no 16b timer for the clock).
+
+#include <PWM.h>
+#include <PWM_Soft.h>
+#include <PWM_DDS.h>
+#include <PWM_Stream.h>
+#include <PWM_Long.h>
+#include <PWM_Fade.h>
+#include <PWM_Scheduler.h>
+#include <PWM_ADC.h>
+#if !defined(__AVR_ATtinyX5__)
+#include <PWM_BAM.h>
+#endif
+#include <math.h>
+
+#if defined(PWM_ISR_STATIC)
+// the vectors of the back-end, the software PWM handlers inlined where their timer is not shared
+#if defined(__AVR_ATtinyX5__)
+PWM_ISR_CALLBACK(TIMER1_OVF_vect, pwm_interrupt1)
+PWM_ISR_CALLBACK(TIMER0_COMPA_vect, pwm_interrupt0a)
+PWM_ISR_CALLBACK(TIMER0_COMPB_vect, pwm_interrupt0b)
+PWM_ISR_CALLBACK(TIMER1_COMPA_vect, pwm_interrupt1a)
+PWM_ISR_CALLBACK(TIMER1_COMPB_vect, pwm_interrupt1b)
+#elif defined(__AVR_ATmega32U4__)
+PWM_ISR_CALLBACK(TIMER1_OVF_vect, pwm_interrupt1)
+PWM_ISR_CALLBACK(TIMER3_OVF_vect, pwm_interrupt3)
+PWM_ISR_CALLBACK(TIMER4_OVF_vect, pwm_interrupt4)
+PWM_ISR_CALLBACK(TIMER0_COMPA_vect, pwm_interrupt0a)
+PWM_ISR_CALLBACK(TIMER0_COMPB_vect, pwm_interrupt0b)
+PWM_ISR_CALLBACK(TIMER1_COMPA_vect, pwm_interrupt1a)
+PWM_ISR_CALLBACK(TIMER1_COMPB_vect, pwm_interrupt1b)
+PWM_ISR_CALLBACK(TIMER1_COMPC_vect, pwm_interrupt1c)
+PWM_ISR_CALLBACK(TIMER3_COMPA_vect, pwm_interrupt3a)
+PWM_ISR_CALLBACK(TIMER3_COMPB_vect, pwm_interrupt3b)
+PWM_ISR_CALLBACK(TIMER3_COMPC_vect, pwm_interrupt3c)
+PWM_ISR_CALLBACK(TIMER4_COMPA_vect, pwm_interrupt4a)
+PWM_ISR_CALLBACK(TIMER4_COMPB_vect, pwm_interrupt4b)
+PWM_ISR_CALLBACK(TIMER4_COMPD_vect, pwm_interrupt4d)
+#else
+PWM_ISR_CALLBACK(TIMER1_OVF_vect, pwm_interrupt1)
+PWM_ISR_CALLBACK(TIMER2_OVF_vect, pwm_interrupt2)
+PWM_ISR_CALLBACK(TIMER0_COMPA_vect, pwm_interrupt0a)
+PWM_ISR_CALLBACK(TIMER0_COMPB_vect, pwm_interrupt0b)
+PWM_ISR_CALLBACK(TIMER1_COMPA_vect, pwm_interrupt1a)
+PWM_ISR_CALLBACK(TIMER1_COMPB_vect, pwm_interrupt1b)
+PWM_ISR(TIMER2_COMPA_vect, pwm_soft_period)
+PWM_ISR(TIMER2_COMPB_vect, pwm_soft_edge)
+#endif
+
+// a handler of its own on a vector the back-end leaves alone (millis() on the target)
+volatile uint32_t overflows0 = 0;
+inline void count_overflow0() { overflows0 = overflows0 + 1; }
+PWM_ISR(TIMER0_OVF_vect, count_overflow0)
+#endif
+
+static int failures = 0;
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #condition); ++failures; } } while (0)
+
+// |Value - Expected| <= Tolerance * |Expected|
+static bool near(const double Value, const double Expected, const double Tolerance)
+{
+	const double Error = (Value > Expected) ? Value - Expected : Expected - Value;
+	return Error <= Tolerance * ((Expected < 0) ? -Expected : Expected);
+}
+
+struct Output
+{
+	uint8_t Timer;
+	char Out;
+};
+
+// outputs with their own compare unit (not the TOP register), one per timer at least
+#if defined(__AVR_ATtinyX5__)
+static const Output outputs[] = { { 0, 'b' }, { 1, 'a' }, { 1, 'b' } };
+#elif defined(__AVR_ATmega32U4__)
+static const Output outputs[] = { { 0, 'b' }, { 1, 'a' }, { 1, 'b' }, { 3, 'a' }, { 4, 'a' }, { 4, 'd' } };
+#else
+static const Output outputs[] = { { 0, 'b' }, { 1, 'a' }, { 1, 'b' }, { 2, 'b' } };
+#endif
+
+// set() : the output runs at the frequency the solver reports, close to the one asked, at 1 / Divisor
+// of the period to a count
+static void test_set()
+{
+	static const uint32_t FrequencyHz[] = { 1000, 5000, 20000 };
+	static const uint16_t Divisor[] = { 2, 4, 10 };
+	for (const Output &o : outputs)
+	{
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			pwm_host::reset();
+			const PWM_Result r = pwm.set(o.Timer, o.Out, FrequencyHz[i], Divisor[i]);
+			pwm.start();
+			delay(20);
+			const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+			CHECK(w.edges > 10);
+			// the last period to a CPU cycle, the average (from the first edge after start()) close to it
+			const double Reported = (double)r.FrequencyNumerator / r.FrequencyDenominator;
+			CHECK(near(w.period, F_CPU / Reported, 1.0 / w.period));
+			CHECK(near(w.frequency, Reported, 1e-3));
+			CHECK(near(w.frequency, FrequencyHz[i], 0.01));
+			const double Duty = 1.0 / Divisor[i];
+			CHECK(near(w.duty, Duty, 1.0 / (Duty * (r.PeriodRegister + 1))));
+		}
+	}
+}
+
+static bool same(const PWM_Result &a, const PWM_Result &b)
+{
+	return (a.CSx3210 == b.CSx3210) & (a.Prescalar == b.Prescalar) & (a.PeriodRegister == b.PeriodRegister) &
+		(a.FrequencyNumerator == b.FrequencyNumerator) & (a.FrequencyDenominator == b.FrequencyDenominator) &
+		(a.Error_ppm == b.Error_ppm) & (a.DutyBits == b.DutyBits);
+}
+
+// set<>() : the compiler resolves the prescalar, TOP and compare set() does, the same waveform
+template <uint8_t Timer, char Out, uint32_t FrequencyHz, uint16_t Divisor>
+static void check_set_template()
+{
+	pwm_host::reset();
+	const PWM_Result r = pwm.set(Timer, Out, FrequencyHz, Divisor);
+	pwm.start();
+	delay(20);
+	const pwm_host::waveform w = pwm_host::channel(Timer, Out);
+
+	pwm_host::reset();
+	CHECK(same(pwm.set<Timer, Out, FrequencyHz, Divisor>(), r));
+	pwm.start();
+	delay(20);
+	const pwm_host::waveform t = pwm_host::channel(Timer, Out);
+	CHECK(w.edges > 10);
+	CHECK((t.edges == w.edges) & (t.period == w.period) & (t.high == w.high));
+}
+
+static void test_set_template()
+{
+#if defined(__AVR_ATtinyX5__)
+	check_set_template<0, 'b', 3000, 2>();
+	check_set_template<1, 'b', 10000, 4>();
+	check_set_template<1, 'a', 900, 3>();
+#elif defined(__AVR_ATmega32U4__)
+	check_set_template<1, 'b', 777, 2>();
+	check_set_template<3, 'a', 20000, 4>();
+	check_set_template<4, 'd', 25000, 2>();
+	check_set_template<4, 'a', 1000, 5>();
+#else
+	check_set_template<0, 'b', 3000, 2>();
+	check_set_template<1, 'a', 20001, 4>();
+	check_set_template<2, 'b', 15000, 2>();
+	check_set_template<2, 'b', 4000, 3>();
+#endif
+}
+
+// solve() : the period closest to the one asked over every prescalar and TOP, Error_ppm that of the
+// frequency reported
+static void test_solve()
+{
+	static const uint32_t FrequencyHz[] = { 7, 61, 777, 3100, 20001, 123457 };
+	for (const Output &o : outputs)
+	{
+		for (const uint32_t Hz : FrequencyHz)
+		{
+			pwm_host::reset();
+			const PWM_Result r = pwm.solve(o.Timer, Hz);
+			const double Period = (double)F_CPU / Hz; // CPU cycles
+			CHECK(r.Prescalar == pwm_prescaler(o.Timer, r.CSx3210));
+			CHECK(r.FrequencyDenominator == (uint32_t)r.Prescalar * (r.PeriodRegister + 1));
+			double Nearest = Period;
+			for (uint8_t CSx3210 = 1; CSx3210 <= pwm_cs_max(o.Timer); ++CSx3210)
+			{
+				const uint32_t Prescalar = pwm_prescaler(o.Timer, CSx3210);
+				for (uint32_t Count = 2; Count <= pwm_count_max(o.Timer, false); ++Count)
+				{
+					Nearest = fmin(Nearest, fabs((double)Prescalar * Count - Period));
+				}
+			}
+			CHECK(fabs((double)r.FrequencyDenominator * F_CPU / r.FrequencyNumerator - Period) <= Nearest + 1e-6);
+			const double Reported = (double)r.FrequencyNumerator / r.FrequencyDenominator;
+			const double Error_ppm = (Reported - Hz) * 1e6 / Hz;
+			CHECK(fabs(r.Error_ppm - Error_ppm) <= 2 + fabs(Error_ppm) * 1e-3);
+		}
+	}
+}
+
+// set(..., dither) : the average period is the fractional one asked, each period is TOP + 1 or TOP + 2 counts
+static void test_dither()
+{
+	static const uint32_t FrequencyHz[] = { 3100, 7919, 123457 };
+	for (const Output &o : outputs)
+	{
+		if (!pwm_dither_timer(o.Timer))
+		{
+			continue;
+		}
+		for (const uint32_t Hz : FrequencyHz)
+		{
+			pwm_host::reset();
+			const PWM_Result r = pwm.set(o.Timer, o.Out, Hz, 2, false, true);
+			pwm.start();
+			delay(100);
+			const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+			CHECK(r.PeriodFraction != 0);
+			CHECK(w.edges > 100);
+			CHECK((w.period == (uint32_t)r.Prescalar * (r.PeriodRegister + 1)) | (w.period == (uint32_t)r.Prescalar * (r.PeriodRegister + 2)));
+			CHECK(near(w.frequency, Hz, 1e-4));
+			CHECK(near(w.frequency, (double)r.FrequencyNumerator / r.FrequencyDenominator, 1e-4));
+		}
+
+		// 21Hz, a timer count above 32 cycles : an unbuffered TOP is not dithered (its ISR writes it at TOP),
+		// every period whole, none lost to a TOP below the counter
+		pwm_host::reset();
+		const PWM_Result r = pwm.set(o.Timer, o.Out, 21, 2, false, true);
+		pwm.start();
+		delay(300);
+		const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+		CHECK(r.Prescalar > 32);
+		CHECK((r.PeriodFraction != 0) == pwm_top_buffered(o.Timer));
+		CHECK(w.edges >= 5);
+		CHECK((w.period == (uint32_t)r.Prescalar * (r.PeriodRegister + 1)) | ((r.PeriodFraction != 0) & (w.period == (uint32_t)r.Prescalar * (r.PeriodRegister + 2))));
+		CHECK(near(w.frequency, (double)r.FrequencyNumerator / r.FrequencyDenominator, 1e-3));
+	}
+}
+
+// set(..., Mode) : in the dual slope modes the period is 2 * Prescalar * TOP, the duty cycle that of PWM_FAST
+static void test_modes()
+{
+	static const PWM_Mode Modes[] = { PWM_PHASE_CORRECT, PWM_PHASE_FREQUENCY_CORRECT };
+	for (const Output &o : outputs)
+	{
+		for (const PWM_Mode Mode : Modes)
+		{
+			pwm_host::reset();
+			const PWM_Result r = pwm.set(o.Timer, o.Out, 5000, 4, false, false, Mode);
+			pwm.start();
+			delay(20);
+			const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+			CHECK(w.edges > 50);
+			const bool DualSlope = (pwm_mode(o.Timer, Mode) != PWM_FAST);
+			CHECK(r.FrequencyDenominator == ((uint32_t)r.Prescalar * (r.PeriodRegister + !DualSlope) << DualSlope));
+			CHECK(w.period == r.FrequencyDenominator);
+			CHECK(near(w.high, 0.25 * w.period, 1.0 / (0.25 * r.PeriodRegister)));
+			CHECK(near(w.frequency, 5000, 0.01));
+			CHECK(near(w.duty, 0.25, 0.01));
+		}
+	}
+}
+
+// |Value - Expected| <= Tolerance
+static bool within(const uint32_t Value, const uint32_t Expected, const uint32_t Tolerance)
+{
+	return ((Value > Expected) ? Value - Expected : Expected - Value) <= Tolerance;
+}
+
+// setDuty() : the compare register only, the next period has the new pulse and the same period
+static void test_set_duty()
+{
+	for (const Output &o : outputs)
+	{
+		pwm_host::reset();
+		const PWM_Result r = pwm.set(o.Timer, o.Out, 2000, 2);
+		pwm.start();
+		delay(5);
+		const uint16_t Compare = r.PeriodRegister / 4;
+		pwm.setDuty(o.Timer, o.Out, Compare);
+		delay(5);
+		const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+		CHECK(w.period == r.FrequencyDenominator);
+		// fast PWM : high from BOTTOM to the compare match, Compare + 1 counts
+		CHECK(within(w.high, (uint32_t)r.Prescalar * (Compare + 1), r.Prescalar));
+	}
+
+	// PWM_Channel : the same store, the output bound at compile time
+	pwm_host::reset();
+	const PWM_Result r = pwm.set(1, 'b', 2000, 2);
+	pwm.start();
+	delay(5);
+	PWM_Channel<1, 'b'> Channel;
+	Channel = (uint16_t)(r.PeriodRegister / 8);
+	delay(5);
+	const pwm_host::waveform w = pwm_host::channel(1, 'b');
+	CHECK(w.period == r.FrequencyDenominator);
+	CHECK(within(w.high, (uint32_t)r.Prescalar * (r.PeriodRegister / 8 + 1), r.Prescalar));
+}
+
+// pwm_q16() : the fraction of the period to a count, in set() and setDuty(), single and dual slope
+static void test_q16()
+{
+	static const PWM_Mode Modes[] = { PWM_FAST, PWM_PHASE_CORRECT };
+	for (const Output &o : outputs)
+	{
+		for (const PWM_Mode Mode : Modes)
+		{
+			pwm_host::reset();
+			const PWM_Result r = pwm.set(o.Timer, o.Out, 5000, pwm_q16(0x6000), false, false, Mode);
+			pwm.start();
+			delay(5);
+			pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+			const uint32_t Count = (pwm_mode(o.Timer, Mode) == PWM_FAST) ? r.Prescalar : 2 * r.Prescalar;
+			CHECK(w.period == r.FrequencyDenominator);
+			CHECK(within(w.high, w.period * 0x6000UL / 0x10000, Count));
+			pwm.setDuty(o.Timer, o.Out, pwm_q16(0xC000));
+			delay(5);
+			w = pwm_host::channel(o.Timer, o.Out);
+			CHECK(within(w.high, w.period * 0xC000UL / 0x10000, Count));
+		}
+	}
+}
+
+// commit() : the period and the duty cycle change together, each period is the old one or the new one
+static void test_commit()
+{
+	for (const Output &o : outputs)
+	{
+		pwm_host::reset();
+		pwm.set(o.Timer, o.Out, 2000, 2);
+		pwm.start();
+		delay(3);
+		const pwm_host::waveform Before = pwm_host::channel(o.Timer, o.Out);
+		const PWM_Result r = pwm.stageFrequency(o.Timer, 3000);
+		pwm.stageDuty(o.Timer, o.Out, pwm_q16(0x4000));
+		CHECK(pwm.commit(o.Timer));
+		// every period that ends in the next 3ms
+		uint32_t Edges = Before.edges;
+		for (uint32_t Cycle = 0; Cycle < 3 * (F_CPU / 1000); ++Cycle)
+		{
+			pwm_host::step(1);
+			const pwm_host::waveform w = pwm_host::channel(o.Timer, o.Out);
+			if (w.edges != Edges)
+			{
+				Edges = w.edges;
+				CHECK(((w.period == Before.period) & (w.high == Before.high)) |
+					((w.period == r.FrequencyDenominator) & within(w.high, w.period / 4, r.Prescalar)));
+			}
+		}
+		CHECK(pwm.committed(o.Timer));
+		CHECK(pwm_host::channel(o.Timer, o.Out).period == r.FrequencyDenominator);
+	}
+
+	// the unbuffered TOP of Timer1 with a count longer than the interrupt entry : the ISR waits for the
+	// counter to leave TOP, the new period from the next one
+	pwm_host::reset();
+	pwm.set(1, 'a', 21, 2);
+	pwm.start();
+	delay(100);
+	const PWM_Result r = pwm.stageFrequency(1, 25);
+	CHECK(r.Prescalar > PWM_HOST_ISR_CYCLES);
+	CHECK(pwm.commit(1));
+	delay(200);
+	CHECK(pwm.committed(1));
+	CHECK(pwm_host::channel(1, 'a').period == r.FrequencyDenominator);
+
+	// stopped at TOP while the ISR is entered : it does not wait, the new period from the restart
+	const PWM_Result Next = pwm.stageFrequency(1, 21);
+	CHECK(pwm.commit(1));
+	while (TCNT1 != r.PeriodRegister) { pwm_host::step(1); }
+	pwm.stop(1);
+	pwm_host::step(2 * PWM_HOST_ISR_CYCLES);
+	CHECK((TCNT1 == r.PeriodRegister) & pwm.committed(1));
+	pwm.start(1);
+	delay(300);
+	CHECK(pwm_host::channel(1, 'a').period == Next.FrequencyDenominator);
+}
+
+// startSync() : the timers count from the same clock edge, Phase[Timer] ticks ahead
+static void test_start_sync()
+{
+	static const uint16_t Phase[5] = { 10, 20, 30, 40, 50 };
+	uint8_t Timers = 0;
+	uint16_t Prescalar[5];
+	pwm_host::reset();
+	for (const Output &o : outputs)
+	{
+		if (Timers & _BV(o.Timer))
+		{
+			continue;
+		}
+		Timers |= _BV(o.Timer);
+		const PWM_Result r = pwm.set(o.Timer, o.Out, 1000, 2);
+		CHECK(r.FrequencyDenominator == F_CPU / 1000);
+		Prescalar[o.Timer] = r.Prescalar;
+	}
+	// stopped, the timers load the double buffered TOP registers (OCRxA) : a preload is below TOP
+	delay(1);
+	pwm.startSync(Phase);
+	// fast PWM : a rising edge at each BOTTOM, the second one (TOP + 1) * Prescalar cycles after the
+	// first, (2 * (TOP + 1) - Phase) * Prescalar cycles after the release
+	uint32_t Edges[5];
+	for (const Output &o : outputs)
+	{
+		Edges[o.Timer] = pwm_host::channel(o.Timer, o.Out).edges + 2;
+	}
+	uint32_t Bottom[5] = { 0, 0, 0, 0, 0 };
+	uint8_t Waiting = Timers;
+	for (uint32_t Cycle = 1; Waiting && (Cycle < 3 * (F_CPU / 1000)); ++Cycle)
+	{
+		pwm_host::step(1);
+		for (const Output &o : outputs)
+		{
+			if ((Waiting & _BV(o.Timer)) && (pwm_host::channel(o.Timer, o.Out).edges == Edges[o.Timer]))
+			{
+				Waiting &= ~_BV(o.Timer);
+				Bottom[o.Timer] = Cycle + (uint32_t)Phase[o.Timer] * Prescalar[o.Timer];
+			}
+		}
+	}
+	CHECK(Waiting == 0);
+	for (const Output &o : outputs)
+	{
+		CHECK(Bottom[o.Timer] == Bottom[outputs[0].Timer]);
+	}
+}
+
+// PWM_Soft : any pins at the period of begin(), each high for its duty cycle to a tick, 0 and TOP + 1
+// ticks steady low and high
+static void test_soft()
+{
+#if defined(__AVR_ATtinyX5__)
+	static const uint8_t Pins[] = { 0, 2, 3, 4 };
+#elif defined(__AVR_ATmega32U4__)
+	static const uint8_t Pins[] = { 4, 8, 5, 12 };
+#else
+	static const uint8_t Pins[] = { 7, 8, 4, 14 };
+#endif
+	pwm_host::reset();
+	const PWM_Result r = pwm_soft.begin(500);
+	CHECK(r.FrequencyDenominator == F_CPU / 500);
+	int8_t Channel[4];
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		Channel[i] = pwm_soft.attach(Pins[i]);
+		CHECK(Channel[i] >= 0);
+	}
+	pwm_soft.set(Channel[0], pwm_q16(0x4000));
+	pwm_soft.set(Channel[1], pwm_q16(0x8000));
+	pwm_soft.set(Channel[2], (uint16_t)1);
+	pwm_soft.set(Channel[3], (uint16_t)(pwm_soft.top() + 1));
+	delay(20);
+	pwm_host::waveform w = pwm_host::pin(Pins[0]);
+	CHECK(w.period == F_CPU / 500);
+	CHECK(within(w.high, w.period / 4, r.Prescalar));
+	w = pwm_host::pin(Pins[1]);
+	CHECK(w.period == F_CPU / 500);
+	CHECK(within(w.high, w.period / 2, r.Prescalar));
+	w = pwm_host::pin(Pins[2]);
+	if (r.Prescalar > PWM_HOST_ISR_CYCLES)
+	{
+		CHECK((w.period == F_CPU / 500) & (w.high == r.Prescalar));
+	}
+	else
+	{
+		// the edge passed by the time the period ISR runs : cleared by it, a pulse as long as the ISR
+		CHECK((w.level == 0) & (w.edges == 0));
+	}
+	CHECK((pwm_host::pin(Pins[3]).level == 1) & (pwm_host::pin(Pins[3]).edges == 1));
+
+	// from the next period
+	pwm_soft.set(Channel[0], pwm_q16(0xC000));
+	pwm_soft.set(Channel[3], (uint16_t)0);
+	delay(5);
+	CHECK(within(pwm_host::pin(Pins[0]).high, 3 * (F_CPU / 500) / 4, r.Prescalar));
+	CHECK(pwm_host::pin(Pins[3]).level == 0);
+	const uint32_t Edges = pwm_host::pin(Pins[3]).edges;
+	delay(5);
+	CHECK(pwm_host::pin(Pins[3]).edges == Edges);
+
+	pwm_soft.end();
+	delay(5);
+	for (const uint8_t Pin : Pins)
+	{
+		CHECK(pwm_host::pin(Pin).level == 0);
+	}
+}
+
+#if defined(PWM_BAM_TIMER)
+// the planes shifted out (pwm_host::spi_hook), with the cycle of their first byte
+static uint8_t bam_plane[1024][PWM_BAM_BYTES];
+static uint64_t bam_start[1024];
+static uint16_t bam_planes = 0;
+static uint8_t bam_bytes = 0;
+
+static void bam_shift(const uint8_t Byte)
+{
+	if (bam_planes == 1024)
+	{
+		return;
+	}
+	if (bam_bytes == 0)
+	{
+		bam_start[bam_planes] = pwm_host::now;
+	}
+	// the byte of the last 74HC595 first
+	bam_plane[bam_planes][PWM_BAM_BYTES - 1 - bam_bytes] = Byte;
+	if (++bam_bytes == PWM_BAM_BYTES)
+	{
+		bam_bytes = 0;
+		++bam_planes;
+	}
+}
+
+// high time of Channel over the last Frames whole frames : plane i is latched while plane i + 1 is
+// shifted, it is on the outputs from the start of plane i + 1 to the start of plane i + 2
+static double bam_duty(const uint8_t Channel, const uint8_t Frames)
+{
+	const uint16_t End = bam_planes - 2;
+	uint64_t High = 0, Total = 0;
+	for (uint16_t i = End - Frames * PWM_BAM_BITS; i < End; ++i)
+	{
+		const uint64_t Slot = bam_start[i + 2] - bam_start[i + 1];
+		Total += Slot;
+		if (bam_plane[i][Channel >> 3] & _BV(Channel & 7)) { High += Slot; }
+	}
+	return (double)High / Total;
+}
+
+// PWM_BAM : each channel of the chain high for Level / (2^PWM_BAM_BITS - 1) of the frame, new levels
+// from the show()
+static void test_bam()
+{
+	static uint8_t Level[PWM_BAM_CHANNELS];
+	pwm_host::reset();
+	pwm_host::spi_hook = bam_shift;
+	for (uint8_t c = 0; c < PWM_BAM_CHANNELS; ++c)
+	{
+		Level[c] = (c * 37) & 255;
+		pwm_bam.set(c, Level[c]);
+	}
+	Level[1] = 1;
+	Level[2] = 255;
+	pwm_bam.set(1, Level[1]);
+	pwm_bam.set(2, Level[2]);
+	pwm_bam.show();
+	bam_planes = 0;
+	const PWM_Result r = pwm_bam.begin(200, 8);
+	CHECK(r.DutyBits == PWM_BAM_BITS);
+	delay(100);
+	CHECK(bam_planes > 16 * PWM_BAM_BITS);
+	for (uint8_t c = 0; c < PWM_BAM_CHANNELS; ++c)
+	{
+		CHECK(near(bam_duty(c, 8), Level[c] / 255.0, 0.002));
+	}
+
+	Level[12] = 64;
+	pwm_bam.set(12, Level[12]);
+	pwm_bam.show();
+	bam_planes = 0;
+	delay(100);
+	CHECK(near(bam_duty(12, 8), Level[12] / 255.0, 0.002));
+	pwm_bam.end();
+	pwm_host::spi_hook = 0;
+}
+#endif
+
+// setClock : the PLL timer counts faster, the same carrier with more counts per period
+static void test_pll()
+{
+#if defined(__AVR_ATtinyX5__)
+	const uint8_t Timer = 1;
+	static const PWM_Clock Sources[] = { PWM_CLOCK_PLL, PWM_CLOCK_PLL_LOW };
+	static const uint32_t Clocks[] = { 64000000UL, 32000000UL };
+	CHECK(pwm.setClock(0, PWM_CLOCK_PLL) == 0);
+	CHECK(pwm.setClock(1, PWM_CLOCK_PLL_HIGH) == 0);
+#elif defined(__AVR_ATmega32U4__)
+	const uint8_t Timer = 4;
+	static const PWM_Clock Sources[] = { PWM_CLOCK_PLL_LOW, PWM_CLOCK_PLL, PWM_CLOCK_PLL_HIGH };
+	static const uint32_t Clocks[] = { 48000000UL, 64000000UL, 96000000UL };
+	CHECK(pwm.setClock(1, PWM_CLOCK_PLL) == 0);
+#endif
+#if defined(__AVR_ATtinyX5__) | defined(__AVR_ATmega32U4__)
+	for (uint8_t i = 0; i < sizeof(Clocks) / sizeof(Clocks[0]); ++i)
+	{
+		pwm_host::reset();
+		CHECK(pwm.setClock(Timer, Sources[i]) == Clocks[i]);
+		CHECK(pwm.getClock(Timer) == Clocks[i]);
+		const PWM_Result r = pwm.set(Timer, 'a', 250000, pwm_q16(0x4000));
+		CHECK((r.Prescalar == 1) & (r.PeriodRegister == Clocks[i] / 250000 - 1));
+		pwm.start();
+		delay(2);
+		const pwm_host::waveform w = pwm_host::channel(Timer, 'a');
+		CHECK((w.period == F_CPU / 250000) & (w.high == w.period / 4));
+	}
+	CHECK(pwm.setClock(Timer, PWM_CLOCK_CPU) == F_CPU);
+#else
+	CHECK(pwm.setClock(1, PWM_CLOCK_PLL) == 0);
+	CHECK(pwm.getClock(1) == F_CPU);
+#endif
+}
+
+#if defined(__AVR_ATmega32U4__)
+// Timer4 10 bit : TOP up to 1023, the high bits of every store through TC4H
+static void test_timer4_10bit()
+{
+	pwm_host::reset();
+	const PWM_Result r = pwm.set(4, 'a', 15625, 2);
+	CHECK((r.Prescalar == 1) & (r.PeriodRegister == 1023) & (r.DutyBits == 10));
+	CHECK(pwm_read10(OCR4C) == 1023);
+	pwm.start();
+	delay(1);
+	pwm.setDuty(4, 'a', 700);
+	CHECK(pwm_read10(OCR4A) == 700);
+	delay(1);
+	pwm_host::waveform w = pwm_host::channel(4, 'a');
+	CHECK((w.period == 1024) & (w.high == 701));
+	pwm_write10(OCR4A, 0x2FF);
+	CHECK(pwm_read10(OCR4A) == 0x2FF);
+	delay(1);
+	w = pwm_host::channel(4, 'a');
+	CHECK(w.high == 0x300);
+}
+
+// setComplementary : OC4x high Rising late, !OC4x high while OC4x is low but Falling late, in CPU cycles
+static void check_complementary(const char Out, const uint32_t High, const uint32_t Period, const uint32_t Rising, const uint32_t Falling)
+{
+	const pwm_host::waveform w = pwm_host::channel(4, Out), n = pwm_host::channel(4, Out, true);
+	CHECK((w.edges > 10) & (n.edges > 10));
+	CHECK((w.period == Period) & (n.period == Period));
+	CHECK(w.high == High - Rising);
+	CHECK(n.high == Period - High - Falling);
+}
+
+static void test_complementary()
+{
+	pwm_host::reset();
+	// 250ns and 500ns : 4 and 8 cycles at 16MHz
+	pwm.setComplementary<250, 500>('a', 62500, pwm_q16(0x8000));
+	pwm.start();
+	delay(2);
+	check_complementary('a', 128, 256, 4, 8);
+
+	// 3us and 6us, CK/8 : the shared DT4 of both pairs (OCR4A is left as it was)
+	pwm.setComplementary('d', 20000, pwm_q16(0x4000), 3000, 6000);
+	pwm.start();
+	delay(2);
+	check_complementary('d', 200, 800, 48, 96);
+	check_complementary('a', 128, 800, 48, 96);
+	CHECK(DDRC & _BV(6)); // !OC4A, D5
+}
+#endif
+
+// PWM_DDS : one sample per carrier period, the table entry at the phase, Step * carrier / 2^32 Hz,
+// the phase carries on through a frequency change
+static void test_dds()
+{
+	pwm_host::reset();
+	const uint32_t CarrierHz = F_CPU / 256;
+	const PWM_Result r = pwm_dds.begin('a', CarrierHz);
+	CHECK(pwm_dds.running());
+	CHECK((r.PeriodRegister == 255) & (r.FrequencyDenominator == 256));
+	const uint32_t Step = pwm_dds.setFrequency(1000);
+	CHECK(near(Step * (double)CarrierHz / 4294967296.0, 1000, 1e-6));
+
+	// 0.1s : 100 periods of the sine, each sample the one at the phase
+	pwm_host::step(3 * r.FrequencyDenominator + 5);
+	uint32_t Phase = pwm_dds_phase;
+	uint16_t Sample = pwm.get_register(1, 'a');
+	uint16_t Crossings = 0;
+	for (uint32_t i = 0; i < CarrierHz / 10; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		CHECK(pwm_dds_phase - Phase == Step);
+		Phase = pwm_dds_phase;
+		const uint16_t Next = pwm.get_register(1, 'a');
+		CHECK(Next == pwm_scale_duty(255, true, pwm_q16((uint16_t)pgm_read_byte(pwm_dds_sine + (Phase >> 24)) << 8)));
+		Crossings += (Sample < 128) & (Next >= 128);
+		Sample = Next;
+	}
+	CHECK(within(Crossings, 100, 1));
+
+	// the next sample one 2kHz step on : no larger than the slope of the sine over the table entries of a step
+	const uint32_t Step2k = pwm_dds.setFrequency(2000);
+	uint16_t Jump = 0;
+	for (uint16_t i = 0; i < 500; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		const uint16_t Next = pwm.get_register(1, 'a');
+		const uint16_t Difference = (Next > Sample) ? Next - Sample : Sample - Next;
+		Jump = (Difference > Jump) ? Difference : Jump;
+		Sample = Next;
+	}
+	CHECK(Jump <= 2 * M_PI * 127.5 * ((Step2k >> 24) + 2) / 256);
+	CHECK(pwm_dds.setFrequency(CarrierHz) == 0x80000000UL);
+	pwm_dds.end();
+	CHECK(!pwm_dds.running());
+}
+
+// PWM_Stream : one value per period in the order written, the idle value when the ring is empty,
+// the writes to a full ring dropped
+static void test_stream()
+{
+	pwm_host::reset();
+	const PWM_Result r = pwm.set(1, 'a', 8000, pwm_q16(0x8000));
+	pwm.start();
+	pwm_host::step(r.FrequencyDenominator / 2); // the overflow ISRs (TOP, then their entry) mid-step below
+	CHECK(pwm_stream.begin(1, 'a', PWM_STREAM_IDLE, 7));
+	for (uint16_t i = 0; i < PWM_STREAM_SIZE; ++i)
+	{
+		CHECK(pwm_stream.write((uint16_t)(20 + i)));
+	}
+	CHECK(!pwm_stream.write((uint16_t)1));
+	CHECK((pwm_stream.space() == 0) & (pwm_stream.overruns() == 1));
+	for (uint16_t i = 0; i < PWM_STREAM_SIZE; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		CHECK(pwm.get_register(1, 'a') == 20 + i);
+	}
+	CHECK((pwm_stream.available() == 0) & (pwm_stream.underruns() == 0));
+	pwm_host::step(r.FrequencyDenominator);
+	CHECK((pwm.get_register(1, 'a') == 7) & (pwm_stream.underruns() == 1));
+	CHECK(pwm_stream.write(pwm_q16(0x4000)));
+	pwm_host::step(r.FrequencyDenominator);
+	CHECK(pwm.get_register(1, 'a') == pwm_pulse_width(1, pwm_q16(0x4000)));
+	pwm_stream.end();
+	CHECK(pwm_stream.write((uint16_t)30));
+	pwm_host::step(2 * r.FrequencyDenominator);
+	CHECK(pwm.get_register(1, 'a') == pwm_pulse_width(1, pwm_q16(0x4000)));
+}
+
+// PWM_Config::compute then apply() : the registers set() and start() leave, computed by the compiler
+// as well, e.g. two outputs of a timer
+#if defined(__AVR_ATmega32U4__)
+constexpr PWM_Config Drive = PWM_Config::compute(4, 'a', 20000, pwm_q16(0x4000)).output('b', pwm_q16(0xC000), true);
+#elif defined(__AVR_ATtinyX5__)
+// OC1B shares the COM1A bits (errata) : an inverted OC1B inverts OC1A as well
+constexpr PWM_Config Drive = PWM_Config::compute(1, 'a', F_CPU / 256, pwm_q16(0x4000)).output('b', pwm_q16(0x4000));
+#else
+constexpr PWM_Config Drive = PWM_Config::compute(1, 'a', F_CPU / 256, pwm_q16(0x4000)).output('b', pwm_q16(0xC000), true);
+#endif
+static_assert(Drive.Outputs == 3, "PWM_Config::output");
+static_assert(Drive != PWM_Config::compute(Drive.Timer, 'a', 20000, pwm_q16(0x4000)), "PWM_Config::operator!=");
+
+// TC4H : the high byte of the last 10 bit store, not part of the image
+static void clear_scratch()
+{
+#if defined(__AVR_ATmega32U4__)
+	TC4H = 0;
+#endif
+}
+
+static void test_config()
+{
+	static const PWM_Mode Modes[] = { PWM_FAST, PWM_PHASE_CORRECT, PWM_PHASE_FREQUENCY_CORRECT };
+	static const uint32_t FrequencyHz[] = { 5, 100, 1000, 20000, 62500 };
+	for (const Output &o : outputs)
+	{
+		for (const PWM_Mode Mode : Modes)
+		{
+			for (const uint32_t Hz : FrequencyHz)
+			{
+				for (uint8_t Invert = 0; Invert < 2; ++Invert)
+				{
+					pwm_host::reset();
+					pwm = PWM();
+					const PWM_Result r = pwm.set(o.Timer, o.Out, Hz, pwm_q16(0x6000), Invert, false, Mode);
+					pwm.start(o.Timer);
+					pwm.disableInterrupt(o.Timer);
+					clear_scratch();
+					const pwm_host::sfr_t Set = pwm_host::sfr;
+
+					pwm_host::reset();
+					pwm = PWM();
+					const PWM_Config c = PWM_Config::compute(o.Timer, o.Out, Hz, pwm_q16(0x6000), Invert, Mode);
+					CHECK((c.Top == r.PeriodRegister) & (c.CSx3210 == r.CSx3210));
+					pwm.apply(c);
+					clear_scratch();
+					CHECK(memcmp(&Set, &pwm_host::sfr, sizeof Set) == 0);
+				}
+			}
+		}
+	}
+
+	pwm_host::reset();
+	pwm = PWM();
+	pwm.apply(Drive);
+	delay(5);
+	const pwm_host::waveform a = pwm_host::channel(Drive.Timer, 'a'), b = pwm_host::channel(Drive.Timer, 'b');
+	CHECK((a.period == b.period) & (a.edges > 10));
+	CHECK(within(a.high, a.period / 4, a.period / (Drive.Top + 1)));
+	// inverted : low for 3/4 of the period (ATtinyX5 : not inverted, 1/4)
+	CHECK(within(b.high, b.period / 4, b.period / (Drive.Top + 1)));
+	CHECK(pwm_pulse_width(Drive.Timer, pwm_q16(0x8000)) == pwm_scale_duty(Drive.Top, !Drive.DualSlope, pwm_q16(0x8000)));
+}
+
+// PWM_Long : hardware fast PWM while a prescalar counts the period, else overflow counting, each edge
+// still made by the compare output, at its tick
+static void test_long()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	CHECK(pwm_long.set('a', 200, pwm_q16(0x4000)));
+	CHECK(!pwm_long.extended());
+	delay(450);
+	const uint32_t Tick = pwm_long.prescalar();
+	const pwm_host::waveform a = pwm_host::channel(PWM_LONG_TIMER, 'a');
+	CHECK(a.period == pwm_long.period() * Tick);
+	CHECK(near(a.period, F_CPU / 5, 1.0 / pwm_long.period()));
+	CHECK(within(a.high, a.period / 4, Tick));
+	pwm_long.end();
+
+	// past the 16b (8b on the ATtinyX5) counter at the largest prescalar
+	pwm_host::reset();
+	pwm = PWM();
+	const uint32_t PeriodMs = (PWM_LONG_BITS == 8) ? 1000 : 4500;
+	CHECK(pwm_long.set('b', PeriodMs, pwm_ticks(300)));
+	const uint32_t Ticks = pwm_long.period(), Prescalar = pwm_long.prescalar();
+	CHECK(pwm_long.extended() & (Ticks > PWM_LONG_WRAP));
+	CHECK(near((double)Ticks * Prescalar, PeriodMs * (F_CPU / 1000.0), 1.0 / Ticks));
+	// the guard, then the first pulse
+	pwm_host::step((pwm_long_guard + 150) * Prescalar);
+	pwm_host::waveform b = pwm_host::channel(PWM_LONG_TIMER, 'b');
+	CHECK((b.level == 1) & (b.edges == 1));
+	pwm_host::step(300 * Prescalar);
+	b = pwm_host::channel(PWM_LONG_TIMER, 'b');
+	CHECK((b.level == 0) & (b.edges == 1));
+#if PWM_LONG_BITS == 8
+	// whole periods (72 million cycles each on the 16b timers : the ATtinyX5 only), the next duty cycle after a wrap at the latest
+	pwm_long.setDuty('b', pwm_ticks(100));
+	pwm_host::step(3 * (uint64_t)Ticks * Prescalar);
+	b = pwm_host::channel(PWM_LONG_TIMER, 'b');
+	CHECK((b.period == Ticks * Prescalar) & (b.high == 100 * Prescalar) & (b.edges == 4));
+#endif
+	pwm_long.end();
+}
+// PWM_Fade : one step per period from the overflow subscriber, the target exactly at the last one,
+// then Done() ; a curve scales its table entry to the period
+static uint8_t fade_done = 0;
+static void fade_finished() { ++fade_done; }
+
+static void test_fade()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	const PWM_Result r = pwm.set(1, 'a', 8000, pwm_q16(0));
+	pwm.set(1, 'b', 8000, pwm_q16(0));
+	pwm.start();
+	pwm_host::step(r.FrequencyDenominator / 2); // the overflow ISRs (TOP, then their entry) mid-step below
+	CHECK(pwm_fade.begin(1, 'a'));
+	fade_done = 0;
+	const uint16_t Target = pwm_pulse_width(1, pwm_q16(0x8000));
+	pwm_fade.to(1, 'a', pwm_q16(0x8000), 100, fade_finished);
+	uint16_t Last = pwm.get_register(1, 'a');
+	for (uint16_t i = 0; i < 100; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		const uint16_t Next = pwm.get_register(1, 'a');
+		CHECK((Next >= Last) & (Next - Last <= Target / 100 + 1));
+		Last = Next;
+	}
+	CHECK((Last == Target) & (fade_done == 1) & (pwm_fade.remaining(1, 'a') == 0));
+	pwm_host::step(2 * r.FrequencyDenominator);
+	CHECK((pwm.get_register(1, 'a') == Target) & (fade_done == 1));
+
+	// down, held half way
+	pwm_fade.to(1, 'a', pwm_q16(0), 40);
+	pwm_host::step(20 * r.FrequencyDenominator);
+	pwm_fade.stop(1, 'a');
+	const uint16_t Held = pwm.get_register(1, 'a');
+	CHECK(within(Held, Target / 2, 2));
+	pwm_host::step(5 * r.FrequencyDenominator);
+	CHECK(pwm.get_register(1, 'a') == Held);
+
+	// pwm_q16(0x8000) through the gamma curve : its entry 128 (22%), the last entry the whole period
+	CHECK(pwm_fade.begin(1, 'b', PWM_FADE_GAMMA, pwm_q16(0x8000)));
+	const uint16_t Half = pwm_scale_duty(r.PeriodRegister, true, pwm_q16(pgm_read_word(pwm_fade_gamma + 128)));
+	CHECK((pwm.get_register(1, 'b') == Half) & within(Half, 22 * (r.PeriodRegister + 1) / 100, 2));
+	pwm_fade.to(1, 'b', pwm_q16(0xFFFF), 127);
+	Last = Half;
+	for (uint16_t i = 0; i < 127; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		const uint16_t Next = pwm.get_register(1, 'b');
+		CHECK(Next >= Last);
+		Last = Next;
+	}
+	CHECK(Last == pwm_pulse_width(1, pwm_q16(0xFFFF)));
+
+	// freed : no more steps
+	pwm_fade.end(1, 'a');
+	pwm_fade.end(1, 'b');
+	pwm_fade.to(1, 'a', pwm_q16(0xFFFF), 1);
+	pwm_host::step(3 * r.FrequencyDenominator);
+	CHECK(pwm.get_register(1, 'a') == Held);
+}
+
+// subscribe() : every subscriber of a vector once per interrupt, in the order they came, each with its
+// context ; the last unsubscribe() disables the interrupt
+struct Subscription
+{
+	uint8_t Order;
+	uint16_t Calls;
+};
+static uint8_t subscription_order = 0;
+static void subscription_isr(void *Context)
+{
+	Subscription &s = *static_cast<Subscription *>(Context);
+	s.Order = ++subscription_order;
+	++s.Calls;
+}
+static void subscription_other(void *Context) { subscription_isr(Context); }
+static uint16_t attached_calls = 0;
+static void attached_isr() { ++attached_calls; }
+
+static void test_subscribe()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	const PWM_Result r = pwm.set(1, 'a', 8000, pwm_q16(0x4000));
+	pwm.start();
+	Subscription First = { 0, 0 }, Second = { 0, 0 }, Third = { 0, 0 };
+	CHECK(pwm.subscribe(1, 'o', subscription_isr, &First));
+	CHECK(pwm.subscribe(1, 'o', subscription_isr, &Second));
+	CHECK(!pwm.subscribe(1, 'o', subscription_isr, &Third));
+	CHECK(pwm.subscribe(1, 'a', subscription_other, &Third));
+	subscription_order = 0;
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK(within(First.Calls, 10, 1) & (Second.Calls == First.Calls) & within(Third.Calls, First.Calls, 1));
+	CHECK(First.Order + 1 == Second.Order);
+
+	// the same function, the context tells them apart
+	CHECK(!pwm.unsubscribe(1, 'o', subscription_other, &First));
+	CHECK(!pwm.unsubscribe(1, 'o', subscription_isr, &Third));
+	CHECK(pwm.unsubscribe(1, 'o', subscription_isr, &First));
+	const uint16_t Calls = First.Calls;
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK((First.Calls == Calls) & within(Second.Calls, Calls + 10, 1));
+	CHECK(pwm.subscribe(1, 'o', subscription_isr, &First));
+	CHECK(!pwm.subscribe(1, 'o', subscription_isr, &Third));
+
+	// attachInterrupt() takes the vector, the next subscribe() installs the table again
+	CHECK(pwm.unsubscribe(1, 'o', subscription_isr, &First));
+	const uint16_t Before = Second.Calls;
+	pwm.attachInterrupt(1, 'o', attached_isr);
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK((Second.Calls == Before) & within(attached_calls, 10, 1));
+	CHECK(pwm.subscribe(1, 'o', subscription_isr, &First));
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK(within(Second.Calls, Before + 10, 1) & (First.Order == Second.Order + 1));
+
+	CHECK(pwm.unsubscribe(1, 'o', subscription_isr, &Second));
+	CHECK(pwm.unsubscribe(1, 'o', subscription_isr, &First));
+	CHECK(pwm.unsubscribe(1, 'a', subscription_other, &Third));
+	CHECK(!pwm.unsubscribe(1, 'o', subscription_isr, &First));
+	const uint16_t Last = First.Calls + Third.Calls;
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK(First.Calls + Third.Calls == Last);
+}
+
+#if defined(PWM_DECIMATE)
+// pwm_decimate() : the attached overflow callback every Nth period, first at the (Phase + 1)th ; commit()
+// and the subscribers still every period
+static uint16_t decimated_calls = 0;
+static void decimated_isr() { ++decimated_calls; }
+
+static void test_decimate()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	const PWM_Result r = pwm.set(1, 'a', 8000, pwm_q16(0x4000));
+	pwm.start();
+	// half a period in : the overflows come at the end of each step
+	pwm_host::step(r.FrequencyDenominator / 2);
+	decimated_calls = 0;
+	pwm.attachInterrupt(1, 'o', decimated_isr);
+	pwm_decimate(1, 5, 2);
+	for (uint8_t i = 1; i <= 13; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		CHECK(decimated_calls == ((i >= 3) ? (i - 3) / 5 + 1 : 0));
+	}
+
+	// a commit takes the overflow for a period, the count goes on
+	pwm.stageDuty(1, 'a', pwm_q16(0x8000));
+	pwm.commit(1);
+	pwm_host::step(2 * r.FrequencyDenominator);
+	CHECK(pwm.committed(1) & (pwm.get_register(1, 'a') == pwm_pulse_width(1, pwm_q16(0x8000))));
+	pwm_host::step(35 * r.FrequencyDenominator);
+	CHECK(decimated_calls == 10);
+
+	Subscription Every = { 0, 0 };
+	CHECK(pwm.subscribe(1, 'o', subscription_isr, &Every));
+	pwm_host::step(10 * r.FrequencyDenominator);
+	CHECK((Every.Calls == 10) & (decimated_calls == 10));
+	CHECK(pwm.unsubscribe(1, 'o', subscription_isr, &Every));
+	pwm_decimate(1, 1);
+	pwm.detachInterrupt(1, 'o');
+}
+#endif
+
+// PWM_Scheduler : the tasks released every so many periods of the tick timer, the highest priority first,
+// the duty cycle of a task committed for the next period ; a task still running at the next period overruns
+struct SchedulerTask
+{
+	uint16_t Runs;
+	uint8_t Order;
+	uint32_t Busy; // cycles the task takes
+	uint16_t Duty; // compare register returned, 0 : none
+};
+static uint8_t scheduler_order = 0;
+static bool scheduler_task(void *Context, PWM_Duty &Duty)
+{
+	SchedulerTask &t = *static_cast<SchedulerTask *>(Context);
+	++t.Runs;
+	t.Order = ++scheduler_order;
+	pwm_host::step(t.Busy);
+	Duty = pwm_ticks(t.Duty);
+	return t.Duty != 0;
+}
+
+static void test_scheduler()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	const PWM_Result r = pwm.set(1, 'a', 8000, pwm_q16(0));
+	pwm.start();
+	SchedulerTask Control = { 0, 0, 0, 50 }, Observer = { 0, 0, 0, 0 };
+	const uint8_t Low = pwm_scheduler.add(scheduler_task, &Observer, 3, 0);
+	const uint8_t High = pwm_scheduler.add(scheduler_task, &Control, 4, 2, 1, 'a', 1);
+	CHECK((Low != High) & (High < PWM_SCHEDULER_TASKS));
+	CHECK(!pwm_scheduler.begin(0));
+	// half a period in : the ticks come at the end of each step
+	pwm_host::step(r.FrequencyDenominator / 2);
+	CHECK(pwm_scheduler.begin(1));
+	CHECK(!pwm_scheduler.begin(1));
+
+	// released at ticks 1, 4, 7, 10 (Observer) and 2, 6, 10 (Control) : both at the 10th, Control first
+	for (uint8_t i = 1; i <= 12; ++i)
+	{
+		pwm_host::step(r.FrequencyDenominator);
+		if (i == 10) { CHECK(Control.Order + 1 == Observer.Order); }
+	}
+	CHECK((pwm_scheduler.ticks() == 12) & (Control.Runs == 3) & (Observer.Runs == 4));
+	CHECK(pwm.get_register(1, 'a') == 50);
+	CHECK((pwm_scheduler.overruns(Low) == 0) & (pwm_scheduler.overruns(High) == 0));
+
+	// both at the 22nd : Control runs past the next tick and overruns, Observer waits for the 23rd, its
+	// release overruns
+	pwm_host::step(9 * r.FrequencyDenominator);
+	CHECK((Control.Runs == 5) & (Observer.Runs == 7));
+	Control.Busy = r.FrequencyDenominator + 100;
+	Control.Duty = 80;
+	pwm_host::step(r.FrequencyDenominator);
+	CHECK((Control.Runs == 6) & (Observer.Runs == 8) & (pwm_scheduler.ticks() == 23));
+	CHECK((pwm_scheduler.overruns(High) == 1) & (pwm_scheduler.overruns(Low) == 1));
+	CHECK(pwm.get_register(1, 'a') == 80);
+
+	pwm_scheduler.remove(High);
+	pwm_scheduler.end();
+	const uint16_t Runs = Observer.Runs;
+	pwm_host::step(6 * r.FrequencyDenominator);
+	CHECK(Observer.Runs == Runs);
+	pwm_scheduler.remove(Low);
+}
+
+// PWM_ADC : a conversion per period, started by the compare of the trigger and sampled at the fraction
+// of the period asked (the input is the counter position, 0 .. 1023 over the period), in the ring in order
+#if defined(__AVR_ATtinyX5__)
+#define ADC_TIMER 0
+#define ADC_TCNT TCNT0
+#else
+#define ADC_TIMER 1
+#define ADC_TCNT TCNT1
+#endif
+static uint16_t adc_conversions = 0;
+static uint16_t adc_position(const uint8_t)
+{
+	++adc_conversions;
+	return (uint16_t)((uint32_t)ADC_TCNT * 1023 / pwm_period_register[ADC_TIMER]);
+}
+
+static void test_adc()
+{
+	pwm_host::reset();
+	pwm = PWM();
+	pwm_host::adc_input = adc_position;
+	const PWM_Result r = pwm.set(ADC_TIMER, 'a', 4000, pwm_q16(0x8000));
+	pwm.start();
+	CHECK(!pwm_adc.begin(ADC_TIMER, 'a', 3));
+	CHECK(pwm_adc.begin(ADC_TIMER, 'b', 3, pwm_q16(0x2000)));
+	pwm_host::step(10 * (uint32_t)r.FrequencyDenominator);
+	CHECK(within(pwm_adc.available(), 10, 1) & (pwm_adc.overruns() == 0));
+	// the first conversion after ADEN holds 13.5 ADC clocks in, the next ones 2 : an eighth of the
+	// period, the lead taken
+	uint16_t Sample, Samples = 1;
+	CHECK(pwm_adc.read(Sample));
+	while (pwm_adc.read(Sample))
+	{
+		CHECK(within(Sample, 1023 / 8, 4));
+		++Samples;
+	}
+	CHECK(within(Samples, 10, 1) & (pwm_adc.available() == 0));
+
+	// later in the period ; the ring full, the oldest overwritten
+	pwm_adc.place(pwm_q16(0xC000));
+	pwm_host::step(r.FrequencyDenominator);
+	pwm_adc.read(Sample);
+	pwm_host::step((PWM_ADC_SAMPLES + 4) * (uint32_t)r.FrequencyDenominator);
+	CHECK((pwm_adc.available() == PWM_ADC_SAMPLES) & within(pwm_adc.overruns(), 4, 1));
+	CHECK(within(pwm_adc.latest(), 3 * 1023 / 4, 4));
+
+	pwm_adc.end();
+	const uint16_t Conversions = adc_conversions;
+	pwm_host::step(5 * (uint32_t)r.FrequencyDenominator);
+	CHECK(adc_conversions == Conversions);
+	pwm_host::adc_input = 0;
+}
+
+#if defined(PWM_PROFILE)
+// the ISRs take the cycles they step, nothing else on the host
+static void profile_overflow() { pwm_host::step(37); }
+static uint8_t profile_matches = 0;
+static void profile_compare() { pwm_host::step((++profile_matches & 1) ? 10 : 20); }
+
+// PWM_PROFILE : the handler cycles of each vector, the latency from its event in timer counts
+static void test_profile()
+{
+	// the profiler clock is Timer1 on the ATmega328p, Timer3 on the ATmega32u4
+#if defined(__AVR_ATmega32U4__)
+	const uint8_t Timer = 1;
+	const uint8_t Overflow = PWM_PROFILE_T1, Compare = PWM_PROFILE_T1B;
+#else
+	const uint8_t Timer = 2;
+	const uint8_t Overflow = PWM_PROFILE_T2, Compare = PWM_PROFILE_T2B;
+#endif
+	pwm_host::reset();
+	pwm.set(Timer, 'b', 10000, 2);
+	pwm.attachInterrupt(Timer, 'o', profile_overflow);
+	pwm.attachInterrupt(Timer, 'b', profile_compare);
+	pwm.enableInterrupt(Timer, 'o');
+	pwm.enableInterrupt(Timer, 'b');
+	pwm.start();
+	pwm_profile_start();
+	delay(10);
+	// the latency of an idle CPU : the interrupt entry of the emulator, in timer counts
+	const uint16_t Prescalar = pwm_prescaler(Timer, pwm.getClockSelect(Timer));
+	const uint16_t Entry = PWM_HOST_ISR_CYCLES / Prescalar;
+	PWM_ProfileStats s = pwm_profile_snapshot(Overflow);
+	CHECK(within(s.Count, 100, 3));
+	CHECK((s.Min == 37) & (s.Max == 37) & (s.Sum == 37UL * s.Count));
+	// fast PWM : the overflow flag at TOP, the latency counted from it
+	CHECK((s.LatencyMin == Entry) & (s.LatencyMax == Entry));
+	s = pwm_profile_snapshot(Compare);
+	CHECK(within(s.Count, 100, 3));
+	CHECK((s.Min == 10) & (s.Max == 20) & (s.LatencyMin == Entry) & (s.LatencyMax == Entry));
+	CHECK(pwm_profile_snapshot(Compare).Count == 0);
+
+	// the interrupts held off for 300 cycles at a time : the latency grows, the handler cycles do not
+	for (uint8_t i = 0; i < 50; ++i)
+	{
+		cli();
+		pwm_host::step(300);
+		sei();
+		pwm_host::step(1000);
+	}
+	s = pwm_profile_snapshot(Compare);
+	CHECK((s.Min == 10) & (s.Max == 20));
+	CHECK((s.LatencyMax > Entry) & ((uint32_t)s.LatencyMax * Prescalar <= 300 + PWM_HOST_ISR_CYCLES));
+	pwm.detachInterrupt(Timer, 'o');
+	pwm.detachInterrupt(Timer, 'b');
+}
+#endif
+
+#if defined(PWM_ISR_STATIC)
+// PWM_ISR : the handler bound at compile time runs once per period, with no callback attached
+static void test_isr_static()
+{
+	pwm_host::reset();
+	pwm.set(0, 'b', 1000, 2);
+	pwm.start();
+	pwm.enableInterrupt(0, 'o');
+	overflows0 = 0;
+	delay(10);
+	CHECK(within(overflows0, 10, 1));
+	pwm.disableInterrupt(0, 'o');
+}
+#endif
+
+int main()
+{
+	test_set();
+	test_set_template();
+	test_solve();
+	test_dither();
+	test_modes();
+	test_set_duty();
+	test_q16();
+	test_commit();
+	test_start_sync();
+	test_soft();
+#if defined(PWM_BAM_TIMER)
+	test_bam();
+#endif
+	test_dds();
+	test_stream();
+	test_config();
+	test_long();
+	test_fade();
+	test_subscribe();
+#if defined(PWM_DECIMATE)
+	test_decimate();
+#endif
+	test_scheduler();
+	test_adc();
+	test_pll();
+#if defined(__AVR_ATmega32U4__)
+	test_timer4_10bit();
+	test_complementary();
+#endif
+#if defined(PWM_ISR_STATIC)
+	test_isr_static();
+#endif
+#if defined(PWM_PROFILE)
+	test_profile();
+#endif
+	printf("%s\n", failures ? "FAILED" : "passed");
+	return failures;
+}